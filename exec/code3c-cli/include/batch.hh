@@ -0,0 +1,53 @@
+/*
+ * 3C-CODE CLI -- Command Line Interface (software)
+ * Copyright (C) 2023 - Rin "madeshiro" Baudelet
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with this
+ * program. If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef HH_CLI_BATCH
+#define HH_CLI_BATCH
+#include <cstdio>
+#include "options.hh"
+
+#define CODE3C_BATCH_CHUNK    1024                // Records read while the previous ones are saved
+#define CODE3C_BATCH_TEMPLATE "code3c-{n}.png"    // Default output file name template
+
+/**
+ * Build the output file name of a record, replacing in the template every
+ * "{n}" by the record number (from 1) and every "{id}" by the record id
+ * (or its number if it has none).
+ *
+ * @param error the reason of the failure
+ * @return false if the id isn't a plain file name ([A-Za-z0-9._-], not
+ * starting with a dot)
+ */
+bool batch_filename(const char* pattern, size_t number, const std::string& id,
+                    std::string& fname, std::string& error);
+
+/**
+ * Generate and save one code per non-empty line of the input (see
+ * code3c_record), on <code>jobs</code> threads. The Huffman tables and the
+ * decoded assets are shared by every thread. A record which can't be read,
+ * generated or saved is reported on stderr without stopping the batch, as is
+ * a record given the file name of a previous one (same id). A throughput
+ * summary is printed at the end.
+ *
+ * @param in the records stream (file or stdin)
+ * @param pattern the output file name template (see batch_filename())
+ * @param jobs the number of threads generating the codes
+ * @param defaults the options of the records which don't override them
+ * @return EXIT_SUCCESS if every record was saved
+ */
+int run_batch(FILE* in, const char* pattern, unsigned jobs, const code3c_options& defaults);
+
+#endif //HH_CLI_BATCH
@@ -0,0 +1,84 @@
+/*
+ * 3C-CODE CLI -- Command Line Interface (software)
+ * Copyright (C) 2023 - Rin "madeshiro" Baudelet
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with this
+ * program. If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef HH_CLI_INPUT
+#define HH_CLI_INPUT
+#include <cstddef>
+#include <cstdio>
+#include <span>
+#include <string>
+#include <vector>
+
+#define CODE3C_INPUT_BLOCK (1 << 16) // Bytes read at once from a stream
+
+/**
+ * Payload of a code, binary data included: borrowed text, mapped file or
+ * stream read until its end. Regular files (and stdin redirected from a
+ * file) are mapped in memory rather than copied on POSIX systems; pipes
+ * and terminals are read in blocks.
+ */
+class code3c_input
+{
+    const std::byte* m_data = nullptr;
+    size_t m_size = 0;
+    std::vector<std::byte> m_buffer; /*< streamed bytes */
+    bool m_mapped = false;
+
+    void release();
+    bool map(FILE* file);
+public:
+    code3c_input() = default;
+    code3c_input(const code3c_input&) = delete;
+    ~code3c_input();
+
+    /**
+     * Read the whole file, replacing the previous payload.
+     *
+     * @param fname the input file, "-" for stdin
+     * @param error the reason of the failure
+     * @return false if the file can't be read
+     */
+    bool open(const char* fname, std::string& error);
+
+    /**
+     * Read the stream until its end, replacing the previous payload.
+     *
+     * @param error the reason of the failure
+     * @return false on a read error
+     */
+    bool read(FILE* in, std::string& error);
+
+    /**
+     * Use a text without copying it, replacing the previous payload.
+     *
+     * @param text the payload, which must outlive this input
+     * @param len the payload's length (byte)
+     */
+    void borrow(const char* text, size_t len);
+
+    inline std::span<const std::byte> bytes() const
+    { return {m_data, m_size}; }
+
+    inline bool empty() const
+    { return m_size == 0; }
+};
+
+/**
+ * @return true if stdin is a pipe or a file rather than a terminal
+ */
+bool stdin_redirected();
+
+#endif //HH_CLI_INPUT
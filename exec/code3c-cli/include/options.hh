@@ -0,0 +1,91 @@
+/*
+ * 3C-CODE CLI -- Command Line Interface (software)
+ * Copyright (C) 2023 - Rin "madeshiro" Baudelet
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with this
+ * program. If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef HH_CLI_OPTIONS
+#define HH_CLI_OPTIONS
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include "code3c/3ccode.hh"
+
+/**
+ * Generation options of a code, set from the command line and overridden
+ * per record.
+ */
+struct code3c_options
+{
+    uint8_t model     = CODE3C_MODEL_WB2C;
+    uint8_t errmodel  = CODE3C_ERRLVL_A;
+    uint8_t huffmodel = CODE3C_HUFFMAN_NO;
+
+    char* logo = nullptr;
+    bool antialias = false;
+    int unit = CODE3C_PIXEL_UNIT;
+    int margin = CODE3C_MARGIN;
+};
+
+/**
+ * A payload to encode, read from a line of input: either the raw line, or
+ * a JSON object (NDJSON) when the line starts with '{':
+ * <pre>{"id": "A-42", "data": "payload", "model": "WB6C", "err": "Hamming313",
+ * "huffman": "ASCII", "format": "svg"}</pre>
+ * Only "data" is required, other members being optional; unknown members
+ * are ignored.
+ */
+struct code3c_record
+{
+    std::string id;     /*< empty if not specified */
+    std::string format; /*< output format name, empty if not specified */
+    std::string data;
+    code3c_options options;
+};
+
+/**
+ * @param name "WB", "WB2C" or "WB6C"
+ * @return false if the name is unknown, <code>model</code> being unchanged
+ */
+bool model_of(const char* name, uint8_t& model);
+
+/**
+ * @param name "Hamming743" or "Hamming313"
+ * @return false if the name is unknown, <code>errmodel</code> being unchanged
+ */
+bool errmodel_of(const char* name, uint8_t& errmodel);
+
+/**
+ * @param name "NO", "ASCII" or "LATIN1"
+ * @return false if the name is unknown, <code>huffmodel</code> being unchanged
+ */
+bool huffmodel_of(const char* name, uint8_t& huffmodel);
+
+/**
+ * Set up a code (model, error model, Huffman table, logo, anti-aliasing,
+ * pixel unit and margin) before its generation.
+ */
+void setup_code(code3c::Code3C& code, const code3c_options& options);
+
+/**
+ * Read a record from a line of input (without its line feed). The record
+ * options must be initialised with the default ones.
+ *
+ * @param line the raw payload or JSON object
+ * @param record the record read
+ * @param error the reason of the failure
+ * @return false if the line is an invalid JSON record
+ */
+bool parse_record(std::string_view line, code3c_record& record, std::string& error);
+
+#endif //HH_CLI_OPTIONS
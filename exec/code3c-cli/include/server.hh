@@ -0,0 +1,149 @@
+/*
+ * 3C-CODE CLI -- Command Line Interface (software)
+ * Copyright (C) 2023 - Rin "madeshiro" Baudelet
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with this
+ * program. If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef HH_CLI_SERVER
+#define HH_CLI_SERVER
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "options.hh"
+
+#define CODE3C_SERVE_CODE     'C'         // Request: generate a code, the body being a record
+#define CODE3C_SERVE_STATS    'S'         // Request: statistics, empty body
+#define CODE3C_SERVE_OK       'K'         // Response: image file or statistics (JSON)
+#define CODE3C_SERVE_ERROR    'E'         // Response: error message
+#define CODE3C_SERVE_MAX_SIZE (16u << 20) // Largest request (bytes)
+#define CODE3C_SERVE_BACKLOG  64          // Unanswered requests of a connection before pausing it
+#define CODE3C_SERVE_MAX_OUT  (16u << 20) // Unsent bytes of a connection before pausing it
+#define CODE3C_SERVE_SAMPLES  65536       // Latest latencies kept for the percentiles
+
+/**
+ * Long-lived 3C-Code generator listening on a Unix socket. The Huffman
+ * tables, models and decoded assets stay loaded between requests.
+ *
+ * Requests and responses are frames: a 32-bit big-endian length, then as
+ * many bytes, starting with the frame kind. A CODE3C_SERVE_CODE request
+ * holds a record (see code3c_record), which may choose the output with a
+ * "format" member ("png" per default, "svg", "ppm", "pam" or "qoi"); the
+ * CODE3C_SERVE_OK response holds the image file. A CODE3C_SERVE_STATS
+ * request is answered with the request count, the error count and the
+ * latency percentiles, as a JSON object:
+ * <pre>{"requests": 120, "errors": 1, "pending": 0, "uptime": 12.5,
+ * "latency": {"p50": 3.1, "p90": 4.0, "p99": 6.2, "max": 9.8}}</pre>
+ * Latencies are in milliseconds, from the reception of the request to its
+ * response. Each connection may send requests without waiting for the
+ * responses, which come back in the same order. Its requests stop being
+ * read while CODE3C_SERVE_BACKLOG of them are unanswered or while
+ * CODE3C_SERVE_MAX_OUT bytes of responses are unsent, until the client
+ * reads them.
+ *
+ * Connections are served by an epoll event loop, codes being generated on
+ * a pool of worker threads.
+ */
+class code3c_server
+{
+    typedef std::chrono::steady_clock clock;
+
+    struct connection
+    {
+        uint64_t id;
+        int fd;
+        std::string in, out;   /*< received and unsent bytes     */
+        size_t inpos = 0, outpos = 0;
+        uint64_t next = 0;     /*< sequence of the next request  */
+        uint64_t sent = 0;     /*< sequence of the next response */
+        std::map<uint64_t, std::string> ready; /*< responses, out of order */
+        uint32_t events = 0;   /*< epoll events watched          */
+        bool eof = false;      /*< no more request               */
+    };
+
+    struct completion
+    {
+        uint64_t connection, sequence;
+        std::string frame;
+    };
+
+    std::string m_path;
+    code3c_options m_defaults;
+    int m_listen, m_epoll, m_wake;
+    std::atomic<bool> m_stop;
+
+    std::unordered_map<uint64_t, connection> m_connections; /*< by id */
+    uint64_t m_ids;
+
+    std::mutex m_mutex;
+    std::vector<completion> m_completed;
+
+    std::mutex m_statsMutex;
+    std::vector<float> m_latencies; /*< ring of CODE3C_SERVE_SAMPLES */
+    size_t m_requests, m_errors;
+    std::atomic<size_t> m_pending;
+    clock::time_point m_start;
+
+    std::unique_ptr<code3c::WorkPool> m_pool; // stopped first
+
+    void accept_all();
+    void receive(uint64_t id, connection& conn);
+    void serve(uint64_t id, connection& conn);
+    void queue(uint64_t id, connection& conn);
+    static bool framed(const connection& conn);
+    static bool throttled(const connection& conn);
+    bool send_all(connection& conn);
+    void deliver(connection& conn);
+    void close(uint64_t id);
+    void complete();
+
+    std::string generate(const std::string& body, bool& failed) const;
+    std::string statistics();
+    void record(double latency, bool failed);
+public:
+    /**
+     * Bind the socket, replacing a stale socket file (refusing connections).
+     *
+     * @param path the socket file
+     * @param jobs the number of worker threads
+     * @param defaults the options of the requests which don't override them
+     * @throw std::runtime_error if the socket can't be created, or if a
+     * server is already listening on it
+     */
+    code3c_server(const char* path, unsigned jobs, const code3c_options& defaults);
+    code3c_server(const code3c_server&) = delete;
+    ~code3c_server();
+
+    /**
+     * Serve the connections until stop() is called.
+     */
+    void run();
+
+    /**
+     * Make run() return. Async-signal-safe.
+     */
+    void stop();
+};
+
+/**
+ * Build a request or response frame.
+ */
+std::string serve_frame(char kind, std::string_view body);
+
+#endif //HH_CLI_SERVER
@@ -0,0 +1,221 @@
+/*
+ * 3C-CODE CLI -- Command Line Interface (software)
+ * Copyright (C) 2023 - Rin "madeshiro" Baudelet
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with this
+ * program. If not, see <https://www.gnu.org/licenses/>.
+ */
+#include "batch.hh"
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <span>
+#include <stdexcept>
+#include <unordered_map>
+#include <vector>
+
+using namespace code3c;
+
+namespace
+{
+    struct batch_line
+    {
+        size_t number; /*< record number, from 1 */
+        size_t line;   /*< line number in the input */
+        std::string text;
+        code3c_record record;
+        std::string fname, error; /*< output file, or why it can't be saved */
+    };
+
+    // Buffered reader of the input lines, embedded NULs included
+    class line_reader
+    {
+        FILE* m_in;
+        char m_buf[1 << 16];
+        size_t m_pos = 0, m_end = 0;
+    public:
+        explicit line_reader(FILE* in): m_in(in) {}
+
+        bool next(std::string& line)
+        {
+            line.clear();
+            while (true)
+            {
+                if (m_pos == m_end)
+                {
+                    m_pos = 0;
+                    m_end = fread(m_buf, 1, sizeof(m_buf), m_in);
+                    if (m_end == 0)
+                        return !line.empty();
+                }
+                auto* lf = (char*) memchr(&m_buf[m_pos], '\n', m_end - m_pos);
+                size_t stop(lf ? lf - m_buf : m_end);
+                line.append(&m_buf[m_pos], stop - m_pos);
+                m_pos = lf ? stop + 1 : stop;
+                if (lf)
+                    return true;
+            }
+        }
+    };
+
+    /**
+     * Read up to CODE3C_BATCH_CHUNK non-empty lines.
+     * @return false once the input is exhausted
+     */
+    bool read_chunk(line_reader& in, std::vector<batch_line>& chunk, size_t& records,
+                    size_t& lines)
+    {
+        std::string text;
+        chunk.clear();
+        while (chunk.size() < CODE3C_BATCH_CHUNK && in.next(text))
+        {
+            lines++;
+            if (!text.empty() && text.back() == '\r')
+                text.pop_back();
+            if (!text.empty())
+                chunk.push_back({++records, lines, std::move(text), {}, {}, {}});
+        }
+        return !chunk.empty();
+    }
+}
+
+bool batch_filename(const char* pattern, size_t number, const std::string& id,
+                    std::string& fname, std::string& error)
+{
+    std::string nstr(std::to_string(number));
+    if (!id.empty())
+    {
+        bool valid(id[0] != '.');
+        for (char c : id)
+            valid &= isalnum((unsigned char) c) || c == '.' || c == '_' || c == '-';
+        if (!valid)
+        {
+            error = "id \"" + id + "\" isn't a plain file name";
+            return false;
+        }
+    }
+
+    fname.clear();
+    for (const char* c(pattern); *c;)
+    {
+        if (strncmp(c, "{n}", 3) == 0)
+        {
+            fname += nstr;
+            c += 3;
+        }
+        else if (strncmp(c, "{id}", 4) == 0)
+        {
+            fname += id.empty() ? nstr : id;
+            c += 4;
+        }
+        else
+            fname += *c++;
+    }
+    return true;
+}
+
+int run_batch(FILE* in, const char* pattern, unsigned jobs, const code3c_options& defaults)
+{
+    if (!strstr(pattern, "{n}") && !strstr(pattern, "{id}"))
+    {
+        printf("Batch output \"%s\" must contain {n} or {id}\n", pattern);
+        return EXIT_FAILURE;
+    }
+
+    // Records are named in input order: with ids, two records could be given
+    // the same file, the first one keeps it
+    bool named(strstr(pattern, "{id}"));
+    std::unordered_map<std::string, size_t> owners;
+    auto prepare = [&](batch_line& record) {
+        record.record.options = defaults;
+        if (!parse_record(record.text, record.record, record.error) ||
+            !batch_filename(pattern, record.number, record.record.id, record.fname,
+                            record.error))
+            return;
+        std::string().swap(record.text);
+        if (named)
+        {
+            auto owner(owners.emplace(record.fname, record.number));
+            if (!owner.second)
+                record.error = record.fname + ": already saved by record " +
+                               std::to_string(owner.first->second);
+        }
+    };
+
+    std::atomic<size_t> saved(0), failed(0);
+    auto generate = [&](const batch_line& record) {
+        // Parallelism is per record: each one is rendered on this thread
+        thread_local WorkPool serial(0);
+
+        std::string error(record.error);
+        const code3c_record& rec(record.record);
+        if (error.empty())
+        {
+            try
+            {
+                Code3C code(std::as_bytes(std::span(rec.data))); // borrows rec.data
+                setup_code(code, rec.options);
+                if (code.generate())
+                {
+                    code.save(record.fname.c_str(), serial);
+                    saved++;
+                    return;
+                }
+                error = "input too large for the model";
+            }
+            catch (const std::exception& e)
+            {
+                error = record.fname + ": " + e.what();
+            }
+        }
+        fprintf(stderr, "record %zu (line %zu): %s\n", record.number, record.line,
+                error.c_str());
+        failed++;
+    };
+
+    // The next chunk is read while the current one is generated
+    auto start(std::chrono::steady_clock::now());
+    WorkPool pool(jobs - 1);
+    auto reader(std::make_unique<line_reader>(in));
+    std::vector<batch_line> chunks[2];
+    WorkPool::Batch pending;
+    size_t records(0), lines(0);
+    for (int current(0); read_chunk(*reader, chunks[current], records, lines); current ^= 1)
+    {
+        for (batch_line& record : chunks[current])
+            prepare(record);
+        if (pending)
+            pool.wait(pending);
+        const std::vector<batch_line>& chunk(chunks[current]);
+        pending = pool.submit((int) chunk.size(), [&chunk, &generate](int i) {
+            generate(chunk[i]);
+        });
+    }
+    if (pending)
+        pool.wait(pending);
+    double elapsed(std::chrono::duration<double>(std::chrono::steady_clock::now() - start)
+                           .count());
+
+    printf("=== code3c batch ===\n"
+           "-- records: %zu\n"
+           "-- saved: %zu\n"
+           "-- failed: %zu\n"
+           "-- jobs: %u\n"
+           "-- elapsed: %.3f s\n"
+           "-- throughput: %.1f codes/s\n",
+           records, saved.load(), failed.load(), jobs, elapsed,
+           elapsed > 0 ? saved.load() / elapsed : 0.0);
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,124 @@
+/*
+ * 3C-CODE CLI -- Command Line Interface (software)
+ * Copyright (C) 2023 - Rin "madeshiro" Baudelet
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with this
+ * program. If not, see <https://www.gnu.org/licenses/>.
+ */
+#include "input.hh"
+#include <cerrno>
+#include <cstring>
+#ifdef CODE3C_UNIX
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#else
+#include <io.h>
+#endif
+
+code3c_input::~code3c_input()
+{
+    release();
+}
+
+void code3c_input::release()
+{
+#ifdef CODE3C_UNIX
+    if (m_mapped)
+        munmap((void*) m_data, m_size);
+#endif
+    m_buffer = {};
+    m_data = nullptr;
+    m_size = 0;
+    m_mapped = false;
+}
+
+// @return false if the file must be streamed instead
+bool code3c_input::map(FILE* file)
+{
+#ifdef CODE3C_UNIX
+    // Pipes, terminals, special files (e.g. /proc) and partially read
+    // files are streamed
+    struct stat st{};
+    int fd(fileno(file));
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size == 0 ||
+        lseek(fd, 0, SEEK_CUR) != 0)
+        return false;
+
+    void* addr = mmap(nullptr, (size_t) st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (addr == MAP_FAILED)
+        return false;
+    madvise(addr, (size_t) st.st_size, MADV_SEQUENTIAL);
+    m_data = (const std::byte*) addr;
+    m_size = (size_t) st.st_size;
+    m_mapped = true;
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool code3c_input::open(const char* fname, std::string& error)
+{
+    release();
+    bool piped(strcmp(fname, "-") == 0);
+    FILE* file = piped ? stdin : fopen(fname, "rb");
+    if (!file)
+    {
+        error = strerror(errno);
+        return false;
+    }
+
+    bool status(map(file) || read(file, error));
+    if (!piped)
+        fclose(file);
+    return status;
+}
+
+bool code3c_input::read(FILE* in, std::string& error)
+{
+    release();
+    size_t count;
+    do
+    {
+        m_buffer.resize(m_size + CODE3C_INPUT_BLOCK);
+        count = fread(&m_buffer[m_size], 1, CODE3C_INPUT_BLOCK, in);
+        m_size += count;
+    }
+    while (count == CODE3C_INPUT_BLOCK);
+
+    if (ferror(in))
+    {
+        error = strerror(errno);
+        release();
+        return false;
+    }
+    m_buffer.resize(m_size);
+    m_data = m_buffer.data();
+    return true;
+}
+
+void code3c_input::borrow(const char* text, size_t len)
+{
+    release();
+    m_data = (const std::byte*) text;
+    m_size = len;
+}
+
+bool stdin_redirected()
+{
+#ifdef CODE3C_UNIX
+    return !isatty(fileno(stdin));
+#else
+    return !_isatty(_fileno(stdin));
+#endif
+}
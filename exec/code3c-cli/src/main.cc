@@ -14,8 +14,20 @@
  * You should have received a copy of the GNU General Public License along with this
  * program. If not, see <https://www.gnu.org/licenses/>.
  */
+#include <cctype>
 #include <iostream>
+#include <span>
+#include <stdexcept>
+#include <string>
 #include "code3c/3ccode.hh"
+#include "code3c/sheet.hh"
+#include "batch.hh"
+#include "input.hh"
+#include "options.hh"
+#ifdef CODE3C_UNIX
+#include <csignal>
+#include "server.hh"
+#endif
 
 #define CODE3C_CLI 202305100L
 #define CODE3C_CLI_VERSION "2023/05 v1.0.0-snapshot-22w14a"
@@ -27,48 +39,77 @@ using std::cout, std::endl;
 using namespace code3c;
 
 char infile[256],
-    intext[1024],
     outfile[256],
     inlogo[256];
 char model[20],
     errmodel[20],
-    huffmodel[20];
-
-char * inbuf = nullptr;
-size_t inlen = 0;
-
-typedef int(*parsing)(char**argv, int avail, char*);
+    huffmodel[20],
+    unit[20],
+    margin[20],
+    sheet[20],
+    batchfile[256],
+    jobs[20],
+    serve[256];
+
+const char* intext = nullptr; // borrowed from argv (or the prompt)
+code3c_input input;
+
+typedef int(*parsing)(char**argv, int avail, std::span<char>);
 typedef bool(*checking)(const char*, const char*);
 typedef bool(*action)();
 
-struct {
-    uint8_t model     = CODE3C_MODEL_WB2C;
-    uint8_t errmodel  = CODE3C_ERRLVL_A;
-    uint8_t huffmodel = CODE3C_HUFFMAN_NO;
-
-    char * logo = nullptr;
+struct : code3c_options {
     char* outfile = nullptr;
+    int sheet = 0;
+    bool display = true;
+    char* batch = nullptr;
+    unsigned jobs = 0;
+    char* serve = nullptr;
 } code3c_args = {};
 
-int parse_null(char**, int avail, char*)
+int parse_null(char**, int avail, std::span<char>)
 {
     return avail >= 1;
 }
 
-int parse_equal(char** argv, int avail, char* out)
+/**
+ * Copy an argument value to its container.
+ * @return false (with a message) if the value doesn't fit in the container
+ */
+bool copy_value(const char* value, std::span<char> out)
+{
+    size_t length(strlen(value));
+    if (length >= out.size())
+    {
+        printf("Invalid argument. Value longer than %zu characters\n", out.size() - 1);
+        return false;
+    }
+    memcpy(out.data(), value, length + 1);
+    return true;
+}
+
+int parse_equal(char** argv, int avail, std::span<char> out)
 {
     if (avail < 1)
         return 0;
 
-    return sscanf(argv[0], "%*[^=]=%[^\n]", out) == 1;
+    const char* value = strchr(argv[0], '=');
+    return value && value[1] != '\0' && copy_value(value + 1, out);
 }
 
-int parse_composed(char** argv, int avail, char* out)
+int parse_composed(char** argv, int avail, std::span<char> out)
+{
+    if (avail < 2 || !copy_value(argv[1], out))
+        return 0;
+    return 2;
+}
+
+int parse_text(char** argv, int avail, std::span<char>)
 {
     if (avail < 2)
         return 0;
 
-    strcpy(out, argv[1]);
+    intext = argv[1];
     return 2;
 }
 
@@ -86,7 +127,7 @@ bool check_composed(const char* str, const char* id)
 struct support_argument {
     const char* identifier[2];
     const char* args, *help;
-    char* container;
+    std::span<char> container;
 
     parsing parse;
     checking check;
@@ -115,13 +156,13 @@ struct support_argument {
             else printf("\n");
         }
     }
-} registeredArguments[8] = {
+} registeredArguments[16] = {
         {
 #define CODE3C_CLI_ARG_HELP 0
                 {"-h", "--help"},
                 "",
                 "Display this information",
-                nullptr,
+                {},
                 parse_null,
                 check_composed,
                 []() -> bool
@@ -145,9 +186,10 @@ struct support_argument {
         {
 #define CODE3C_CLI_ARG_OUTPUT 1
                 {"-o", "--output"},
-                " <file.png>",
-                "Specify the output file. If null, no file will be saved or default"
-                " name will be \"code3c.png\"",
+                " <file.png|file.svg|file.qoi|file.pam|file.ppm>",
+                "Specify the output file (format chosen from the extension: SVG, QOI,"
+                " PAM, PPM, PNG otherwise). If null,"
+                " no file will be saved or default name will be \"code3c.png\"",
                 outfile,
                 parse_composed,
                 check_composed,
@@ -155,7 +197,7 @@ struct support_argument {
                 {
                     if (strlen(outfile) > 1)
                     {
-                        code3c_args.outfile = strcpy(new char[strlen(outfile+1)],
+                        code3c_args.outfile = strcpy(new char[strlen(outfile)+1],
                                                      outfile);
                     }
                     return true;
@@ -172,13 +214,7 @@ struct support_argument {
                 check_equal,
                 []() -> bool
                 {
-                    if (strcmp(huffmodel, "NO") == 0)
-                        code3c_args.huffmodel = CODE3C_HUFFMAN_NO;
-                    else if (strcmp(huffmodel, "ASCII") == 0)
-                        code3c_args.huffmodel = CODE3C_HUFFMAN_ASCII;
-                    else if (strcmp(huffmodel, "LATIN1") == 0)
-                        code3c_args.huffmodel = CODE3C_HUFFMAN_LATIN;
-                    else
+                    if (!huffmodel_of(huffmodel, code3c_args.huffmodel))
                     {
                         printf("Invalid argument. Expected 'NO', 'ASCII' or 'LATIN1'\n");
                         return false;
@@ -190,35 +226,28 @@ struct support_argument {
         {
 #define CODE3C_CLI_ARG_INFILE 3
                 {"-f", "--file"},
-                " <file>",
-                "Specify an input file to generate 3C-Code",
+                " <file|->",
+                "Specify an input file to generate 3C-Code (stdin for '-'). Per "
+                "default, a piped stdin is read",
                 infile,
                 parse_composed,
                 check_composed,
                 []() -> bool
                 {
-                    FILE* file = fopen(infile, "rb");
-                    if (file)
+                    std::string error;
+                    if (!input.open(infile, error))
                     {
-                        fseek(file, 0, SEEK_END);
-                        inlen = (size_t) ftell(file);
-                        fseek(file, 0, SEEK_SET);
-                        if (inlen < 0) {
-                            printf("File empty, cannot generate 3C-Code\n");
-                            return false;
-                        }
-
-                        inbuf = new char[inlen+1];
-                        inbuf[inlen] = '\0';
-                        fread(inbuf, sizeof(char), inlen, file);
-
-                        return true;
+                        printf("Unable to read input file \"%s\": %s\n", infile,
+                               error.c_str());
+                        return false;
                     }
-                    else
+                    if (input.empty())
                     {
-                        printf("Unable to find input file \"%s\"\n", infile);
+                        printf("File empty, cannot generate 3C-Code\n");
                         return false;
                     }
+
+                    return true;
                 }
         },
         {
@@ -231,13 +260,7 @@ struct support_argument {
                 check_equal,
                 []() -> bool
                 {
-                    if (strcmp(model, "WB") == 0)
-                        code3c_args.model = CODE3C_MODEL_WB;
-                    else if (strcmp(model, "WB2C") == 0)
-                        code3c_args.model = CODE3C_MODEL_WB2C;
-                    else if (strcmp(model, "WB6C") == 0)
-                        code3c_args.model = CODE3C_MODEL_WB6C;
-                    else
+                    if (!model_of(model, code3c_args.model))
                     {
                         printf("Invalid argument. Expected 'WB', 'WB2C' or 'WB6C'\n");
                         return false;
@@ -257,11 +280,7 @@ struct support_argument {
                 check_equal,
                 []() -> bool
                 {
-                    if (strcmp(errmodel, "Hamming743") == 0)
-                        code3c_args.errmodel = CODE3C_ERRLVL_A;
-                    else if (strcmp(errmodel, "Hamming313") == 0)
-                        code3c_args.errmodel = CODE3C_ERRLVL_B;
-                    else
+                    if (!errmodel_of(errmodel, code3c_args.errmodel))
                     {
                         printf("Invalid argument. Expected 'Hamming743' or "
                                "'Hamming313'\n");
@@ -276,16 +295,16 @@ struct support_argument {
                 {"-t", "--text"},
                 " \"input text\"",
                 "Specify an input text to generate 3C-Code",
-                intext,
-                parse_composed,
+                {},
+                parse_text,
                 check_composed,
                 []() -> bool
                 {
-                    inlen = strlen(intext);
-                    if (inlen > 0)
+                    size_t len(strlen(intext));
+                    if (len > 0)
                     {
-                        inbuf = strcpy(new char[inlen+1], intext);
-                        return inbuf != nullptr;
+                        input.borrow(intext, len);
+                        return true;
                     }
 
                     printf("Input text cannot be empty\n");
@@ -310,6 +329,162 @@ struct support_argument {
                     }
                     return true;
                 }
+        },
+        {
+#define CODE3C_CLI_ARG_ANTIALIAS 8
+                {"-aa", "--antialias"},
+                "",
+                "Anti-alias the slice edges of the saved image (smoother codes at"
+                " small sizes, more colours in the file)",
+                {},
+                parse_null,
+                check_composed,
+                []() -> bool
+                {
+                    code3c_args.antialias = true;
+                    return true;
+                }
+        },
+        {
+#define CODE3C_CLI_ARG_UNIT 9
+                {"-u", "--unit"},
+                "=<pixels>",
+                "Set the amount of pixels for each data unit of the saved image. Per"
+                " default, 3 (any size can be saved, large images are written band by"
+                " band)",
+                unit,
+                parse_equal,
+                check_equal,
+                []() -> bool
+                {
+                    char* end;
+                    long value = strtol(unit, &end, 10);
+                    if (*end != '\0' || value < 1 || value > 10000)
+                    {
+                        printf("Invalid argument. Expected a pixel unit from 1 to 10000\n");
+                        return false;
+                    }
+                    code3c_args.unit = (int) value;
+                    return true;
+                }
+        },
+        {
+#define CODE3C_CLI_ARG_MARGIN 10
+                {"", "--margin"},
+                "=<pixels>",
+                "Set the blank border around the code. Per default, 20 pixels",
+                margin,
+                parse_equal,
+                check_equal,
+                []() -> bool
+                {
+                    char* end;
+                    long value = strtol(margin, &end, 10);
+                    if (*end != '\0' || value < 0 || value > 100000)
+                    {
+                        printf("Invalid argument. Expected a margin from 0 to 100000\n");
+                        return false;
+                    }
+                    code3c_args.margin = (int) value;
+                    return true;
+                }
+        },
+        {
+#define CODE3C_CLI_ARG_SHEET 11
+                {"", "--sheet"},
+                "=<columns>",
+                "Generate one code per input line and save them all on a single"
+                " sheet of the given amount of columns (requires an output file)",
+                sheet,
+                parse_equal,
+                check_equal,
+                []() -> bool
+                {
+                    char* end;
+                    long value = strtol(sheet, &end, 10);
+                    if (*end != '\0' || value < 1 || value > 1000)
+                    {
+                        printf("Invalid argument. Expected 1 to 1000 columns\n");
+                        return false;
+                    }
+                    code3c_args.sheet = (int) value;
+                    return true;
+                }
+        },
+        {
+#define CODE3C_CLI_ARG_RENDER 12
+                {"--render", "--no-display"},
+                "",
+                "Render the 3C-Code to the output file and exit without opening a"
+                " window (no display server needed). The exit status tells whether"
+                " the file was saved",
+                {},
+                parse_null,
+                check_composed,
+                []() -> bool
+                {
+                    code3c_args.display = false;
+                    return true;
+                }
+        },
+        {
+#define CODE3C_CLI_ARG_BATCH 13
+                {"-b", "--batch"},
+                " <file|->",
+                "Generate one 3C-Code per line of the file (or stdin for '-'), either"
+                " the raw payload or a JSON object with its options, saved to the"
+                " output file template (\"{n}\": record number, \"{id}\": record id)."
+                " Per default, the template is \"" CODE3C_BATCH_TEMPLATE "\"",
+                batchfile,
+                parse_composed,
+                check_composed,
+                []() -> bool
+                {
+                    code3c_args.batch = strcpy(new char[strlen(batchfile)+1], batchfile);
+                    return true;
+                }
+        },
+        {
+#define CODE3C_CLI_ARG_JOBS 14
+                {"-j", "--jobs"},
+                "=<threads>",
+                "Set the amount of threads generating the batch codes. Per default,"
+                " the amount of hardware threads",
+                jobs,
+                parse_equal,
+                check_equal,
+                []() -> bool
+                {
+                    char* end;
+                    long value = strtol(jobs, &end, 10);
+                    if (*end != '\0' || value < 1 || value > 1024)
+                    {
+                        printf("Invalid argument. Expected 1 to 1024 threads\n");
+                        return false;
+                    }
+                    code3c_args.jobs = (unsigned) value;
+                    return true;
+                }
+        },
+        {
+#define CODE3C_CLI_ARG_SERVE 15
+                {"", "--serve"},
+                " <socket>",
+                "Serve 3C-Code requests on a Unix socket until interrupted, generating"
+                " the codes on the threads set by -j (see README for the protocol)",
+                serve,
+                parse_composed,
+                check_composed,
+                []() -> bool
+                {
+#ifdef CODE3C_UNIX
+                    code3c_args.serve = strcpy(new char[strlen(serve)+1], serve);
+                    return true;
+#else
+                    printf("Serving requests is only available on Unix systems\n");
+                    return false;
+#endif
+                }
         }
 };
 
@@ -348,10 +523,14 @@ bool parse_args(int argc, char** argv)
 
 void setup_userprompt()
 {
-    auto input = [](char* rvar, int arg) {
+    auto input = [](int arg) {
+        // A word that fits in the container of the argument
+        std::span<char> rvar(registeredArguments[arg].container);
+        char format[16];
+        snprintf(format, sizeof(format), "%%%zus", rvar.size() - 1);
         do
         {
-            scanf("%s", rvar);
+            scanf(format, rvar.data());
         }
         while (!registeredArguments[arg].exec());
     };
@@ -360,44 +539,204 @@ void setup_userprompt()
 
     // Ask model
     printf("-- setup model\n(WB, WB2C, WB6C)? ");
-    input(model, CODE3C_CLI_ARG_MODEL);
+    input(CODE3C_CLI_ARG_MODEL);
 
     // Ask error model
     printf("-- setup err model\n(Hamming743, Hamming313)? ");
-    input(errmodel, CODE3C_CLI_ARG_ERRMODEL);
+    input(CODE3C_CLI_ARG_ERRMODEL);
 
     // Ask huffman model
     printf("-- setup compression algorithm\n (NO, ASCII, LATIN1)? ");
-    input(huffmodel, CODE3C_CLI_ARG_HUFFMODEL);
-
-    // Ask input text
-    printf("-- input text\n(up to 1024B)? ");
-    scanf(" %[^\n]", intext);
+    input(CODE3C_CLI_ARG_HUFFMODEL);
+
+    // Ask input text (a line, kept for the whole run)
+    static std::string line;
+    printf("-- input text\n? ");
+    int c;
+    while ((c = getchar()) != EOF && isspace(c));
+    for (; c != EOF && c != '\n'; c = getchar())
+        line += (char) c;
+    intext = line.c_str();
     registeredArguments[CODE3C_CLI_ARG_INTEXT].exec();
 }
 
+int generate_sheet()
+{
+    if (!code3c_args.outfile)
+    {
+        printf("A sheet requires an output file (-o)\n");
+        return EXIT_FAILURE;
+    }
+
+    // One code per non-empty line
+    Code3CSheet codes(code3c_args.sheet);
+    codes.setAntialiased(code3c_args.antialias);
+    auto* text = (const char*) input.bytes().data();
+    size_t length(input.bytes().size());
+    for (size_t begin(0), end; begin < length; begin = end + 1)
+    {
+        end = begin;
+        while (end < length && text[end] != '\n')
+            end++;
+        size_t len(end - begin);
+        if (len > 0 && text[end - 1] == '\r')
+            len--;
+        if (len > 0)
+            setup_code(codes.add(&text[begin], len), code3c_args);
+    }
+
+    if (codes.size() == 0)
+    {
+        printf("Input is empty, cannot generate 3C-Code sheet\n");
+        return EXIT_FAILURE;
+    }
+    if (!codes.generate())
+    {
+        printf("Unable to generate every code of the sheet\n");
+        return EXIT_FAILURE;
+    }
+
+    try
+    {
+        codes.save(code3c_args.outfile);
+    }
+    catch (const std::runtime_error& e)
+    {
+        printf("Unable to save \"%s\": %s\n", code3c_args.outfile, e.what());
+        return EXIT_FAILURE;
+    }
+
+    printf("=== code3c sheet ===\n"
+           "-- codes: %zu\n"
+           "-- grid: %d x %d\n"
+           "-- dimension: %d x %d px\n",
+           codes.size(), codes.columns(), codes.rows(),
+           codes.displayList()->width(), codes.displayList()->height());
+    return EXIT_SUCCESS;
+}
+
+#ifdef CODE3C_UNIX
+code3c_server* server = nullptr;
+
+int run_server()
+{
+    try
+    {
+        code3c_server service(code3c_args.serve,
+                              code3c_args.jobs ? code3c_args.jobs : parallel_workers(),
+                              code3c_args);
+        server = &service;
+        auto interrupt = [](int) { server->stop(); };
+        signal(SIGINT, interrupt);
+        signal(SIGTERM, interrupt);
+
+        printf("=== code3c service ===\n"
+               "-- socket: %s\n", code3c_args.serve);
+        fflush(stdout);
+        service.run();
+        signal(SIGINT, SIG_DFL);
+        signal(SIGTERM, SIG_DFL);
+        server = nullptr;
+    }
+    catch (const std::runtime_error& e)
+    {
+        printf("Unable to serve requests: %s\n", e.what());
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+#endif
+
 int main(int argc, char** argv)
 {
-    // Full user prompt
-    if (argc <= 1)
+    // Full user prompt, unless the input is piped
+    if (argc <= 1 && !stdin_redirected())
     {
         setup_userprompt();
     }
     else if (!parse_args(argc, argv))
         return EXIT_FAILURE;
 
-    // Set-up using CLI
-    Code3C code3C(inbuf, inlen);
-    code3C.setModel(code3c_args.model);
-    code3C.setErrorModel(code3c_args.errmodel);
-    code3C.setHuffmanTable(code3c_args.huffmodel);
-    if (code3c_args.logo)
-        code3C.setLogo(code3c_args.logo);
+#ifdef CODE3C_UNIX
+    // Long-lived service
+    if (code3c_args.serve)
+    {
+        int status(run_server());
+        delete[] code3c_args.serve;
+        delete[] code3c_args.logo;
+        return status;
+    }
+#endif
+
+    // Batch of codes, generated in parallel
+    if (code3c_args.batch)
+    {
+        FILE* in = strcmp(code3c_args.batch, "-") == 0 ? stdin : fopen(code3c_args.batch, "rb");
+        int status(EXIT_FAILURE);
+        if (in)
+        {
+            status = run_batch(in, code3c_args.outfile ? code3c_args.outfile
+                                                       : CODE3C_BATCH_TEMPLATE,
+                               code3c_args.jobs ? code3c_args.jobs : parallel_workers(),
+                               code3c_args);
+            if (in != stdin)
+                fclose(in);
+        }
+        else
+            printf("Unable to find batch file \"%s\"\n", code3c_args.batch);
+        delete[] code3c_args.batch;
+        delete[] code3c_args.logo;
+        delete[] code3c_args.outfile;
+        return status;
+    }
+
+    if (!code3c_args.display && !code3c_args.outfile)
+    {
+        printf("Rendering without display requires an output file (-o)\n");
+        return EXIT_FAILURE;
+    }
+
+    // Without -t nor -f, the payload is streamed from stdin
+    if (input.empty())
+    {
+        std::string error;
+        if (!stdin_redirected())
+        {
+            printf("No input: specify -t, -f or pipe the payload to stdin\n");
+            return EXIT_FAILURE;
+        }
+        if (!input.open("-", error))
+        {
+            printf("Unable to read stdin: %s\n", error.c_str());
+            return EXIT_FAILURE;
+        }
+        if (input.empty())
+        {
+            printf("Input is empty, cannot generate 3C-Code\n");
+            return EXIT_FAILURE;
+        }
+    }
+
+    // Sheet of codes, saved without display
+    if (code3c_args.sheet)
+    {
+        int status(generate_sheet());
+        delete[] code3c_args.logo;
+        delete[] code3c_args.outfile;
+        return status;
+    }
+
+    // Set-up using CLI (the input is borrowed, not copied)
+    Code3C code3C(input.bytes());
+    setup_code(code3C, code3c_args);
     if (code3c_args.outfile)
         code3C.set_output(code3c_args.outfile);
 
     if (!code3C.generate())
+    {
+        printf("Unable to generate 3C-Code: input too large for the model\n");
         return EXIT_FAILURE;
+    }
 
     printf("=== code3c specs ===\n"
            "-- dataSegSize: %zu\n"
@@ -412,12 +751,37 @@ int main(int argc, char** argv)
            code3C.model().bitl
            );
 
+    // Save result
+    if (code3c_args.outfile)
+    {
+        try
+        {
+            code3C.save(code3c_args.outfile);
+        }
+        catch (const std::runtime_error& e)
+        {
+            printf("Unable to save \"%s\": %s\n", code3c_args.outfile, e.what());
+            return EXIT_FAILURE;
+        }
+    }
+
     // Display result
-    code3C.display();
+    if (code3c_args.display)
+    {
+        try
+        {
+            code3C.display();
+        }
+        catch (const std::runtime_error& e)
+        {
+            printf("Unable to display 3C-Code: %s\n", e.what());
+            return EXIT_FAILURE;
+        }
+    }
 
     // Free memory
-    delete[] inbuf;
     delete[] code3c_args.logo;
+    delete[] code3c_args.outfile;
 
     return EXIT_SUCCESS;
 }
\ No newline at end of file
@@ -0,0 +1,288 @@
+/*
+ * 3C-CODE CLI -- Command Line Interface (software)
+ * Copyright (C) 2023 - Rin "madeshiro" Baudelet
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with this
+ * program. If not, see <https://www.gnu.org/licenses/>.
+ */
+#include "options.hh"
+#include <cctype>
+#include <cstring>
+
+using namespace code3c;
+
+namespace
+{
+    void skip_spaces(std::string_view text, size_t& pos)
+    {
+        while (pos < text.size() && (text[pos] == ' ' || text[pos] == '\t' ||
+                                     text[pos] == '\r' || text[pos] == '\n'))
+            pos++;
+    }
+
+    void append_utf8(std::string& out, uint32_t cp)
+    {
+        if (cp < 0x80)
+            out += (char) cp;
+        else if (cp < 0x800)
+        {
+            out += (char) (0xc0 | (cp >> 6));
+            out += (char) (0x80 | (cp & 0x3f));
+        }
+        else if (cp < 0x10000)
+        {
+            out += (char) (0xe0 | (cp >> 12));
+            out += (char) (0x80 | ((cp >> 6) & 0x3f));
+            out += (char) (0x80 | (cp & 0x3f));
+        }
+        else
+        {
+            out += (char) (0xf0 | (cp >> 18));
+            out += (char) (0x80 | ((cp >> 12) & 0x3f));
+            out += (char) (0x80 | ((cp >> 6) & 0x3f));
+            out += (char) (0x80 | (cp & 0x3f));
+        }
+    }
+
+    bool parse_hex4(std::string_view text, size_t& pos, uint32_t& value)
+    {
+        if (pos + 4 > text.size())
+            return false;
+        value = 0;
+        for (size_t end(pos + 4); pos < end; pos++)
+        {
+            char c(text[pos]);
+            value <<= 4;
+            if (c >= '0' && c <= '9')
+                value |= c - '0';
+            else if (c >= 'a' && c <= 'f')
+                value |= c - 'a' + 10;
+            else if (c >= 'A' && c <= 'F')
+                value |= c - 'A' + 10;
+            else
+                return false;
+        }
+        return true;
+    }
+
+    // JSON string at text[pos] == '"', escapes decoded (\u0000 included)
+    bool parse_string(std::string_view text, size_t& pos, std::string& out)
+    {
+        out.clear();
+        for (pos++; pos < text.size();)
+        {
+            char c(text[pos++]);
+            if (c == '"')
+                return true;
+            if ((unsigned char) c < 0x20)
+                return false;
+            if (c != '\\')
+            {
+                out += c;
+                continue;
+            }
+            if (pos >= text.size())
+                return false;
+            switch (text[pos++])
+            {
+                case '"':  out += '"';  break;
+                case '\\': out += '\\'; break;
+                case '/':  out += '/';  break;
+                case 'b':  out += '\b'; break;
+                case 'f':  out += '\f'; break;
+                case 'n':  out += '\n'; break;
+                case 'r':  out += '\r'; break;
+                case 't':  out += '\t'; break;
+                case 'u':
+                {
+                    uint32_t cp, low;
+                    if (!parse_hex4(text, pos, cp))
+                        return false;
+                    if (cp >= 0xd800 && cp < 0xdc00) // surrogate pair
+                    {
+                        if (text.substr(pos, 2) != "\\u")
+                            return false;
+                        pos += 2;
+                        if (!parse_hex4(text, pos, low) || low < 0xdc00 || low >= 0xe000)
+                            return false;
+                        cp = 0x10000 + ((cp - 0xd800) << 10) + (low - 0xdc00);
+                    }
+                    else if (cp >= 0xdc00 && cp < 0xe000)
+                        return false;
+                    append_utf8(out, cp);
+                    break;
+                }
+                default:
+                    return false;
+            }
+        }
+        return false;
+    }
+
+    // Number or literal (true, false, null), kept as written
+    bool parse_scalar(std::string_view text, size_t& pos, std::string& out)
+    {
+        size_t begin(pos);
+        while (pos < text.size() && (isalnum((unsigned char) text[pos]) || text[pos] == '+' ||
+                                     text[pos] == '-' || text[pos] == '.'))
+            pos++;
+        out = text.substr(begin, pos - begin);
+        return pos > begin;
+    }
+}
+
+bool model_of(const char* name, uint8_t& model)
+{
+    if (strcmp(name, "WB") == 0)
+        model = CODE3C_MODEL_WB;
+    else if (strcmp(name, "WB2C") == 0)
+        model = CODE3C_MODEL_WB2C;
+    else if (strcmp(name, "WB6C") == 0)
+        model = CODE3C_MODEL_WB6C;
+    else
+        return false;
+    return true;
+}
+
+bool errmodel_of(const char* name, uint8_t& errmodel)
+{
+    if (strcmp(name, "Hamming743") == 0)
+        errmodel = CODE3C_ERRLVL_A;
+    else if (strcmp(name, "Hamming313") == 0)
+        errmodel = CODE3C_ERRLVL_B;
+    else
+        return false;
+    return true;
+}
+
+bool huffmodel_of(const char* name, uint8_t& huffmodel)
+{
+    if (strcmp(name, "NO") == 0)
+        huffmodel = CODE3C_HUFFMAN_NO;
+    else if (strcmp(name, "ASCII") == 0)
+        huffmodel = CODE3C_HUFFMAN_ASCII;
+    else if (strcmp(name, "LATIN1") == 0)
+        huffmodel = CODE3C_HUFFMAN_LATIN;
+    else
+        return false;
+    return true;
+}
+
+void setup_code(Code3C& code, const code3c_options& options)
+{
+    code.setModel(options.model);
+    code.setErrorModel(options.errmodel);
+    code.setHuffmanTable(options.huffmodel);
+    if (options.logo)
+        code.setLogo(options.logo);
+    code.setAntialiased(options.antialias);
+    code.setPixelUnit(options.unit, options.margin);
+}
+
+bool parse_record(std::string_view line, code3c_record& record, std::string& error)
+{
+    record.id.clear();
+    record.format.clear();
+    if (line.empty() || line[0] != '{')
+    {
+        record.data = line;
+        return true;
+    }
+
+    // Flat JSON object of strings, numbers and literals
+    bool has_data(false);
+    std::string key, value;
+    size_t pos(1);
+    skip_spaces(line, pos);
+    if (pos < line.size() && line[pos] == '}')
+    {
+        error = "missing \"data\" member";
+        return false;
+    }
+    while (true)
+    {
+        skip_spaces(line, pos);
+        if (pos >= line.size() || line[pos] != '"' || !parse_string(line, pos, key))
+        {
+            error = "invalid JSON member name";
+            return false;
+        }
+        skip_spaces(line, pos);
+        if (pos >= line.size() || line[pos++] != ':')
+        {
+            error = "expected ':' after \"" + key + "\"";
+            return false;
+        }
+        skip_spaces(line, pos);
+        bool is_string(pos < line.size() && line[pos] == '"');
+        if (!(is_string ? parse_string(line, pos, value) : parse_scalar(line, pos, value)))
+        {
+            error = "invalid JSON value of \"" + key + "\"";
+            return false;
+        }
+
+        if (key == "data" && is_string)
+        {
+            record.data = value;
+            has_data = true;
+        }
+        else if (key == "data")
+        {
+            error = "\"data\" must be a string";
+            return false;
+        }
+        else if (key == "id")
+            record.id = value;
+        else if (key == "format")
+            record.format = value;
+        else if (key == "model" && !model_of(value.c_str(), record.options.model))
+        {
+            error = "invalid model \"" + value + "\"";
+            return false;
+        }
+        else if (key == "err" && !errmodel_of(value.c_str(), record.options.errmodel))
+        {
+            error = "invalid error model \"" + value + "\"";
+            return false;
+        }
+        else if (key == "huffman" && !huffmodel_of(value.c_str(), record.options.huffmodel))
+        {
+            error = "invalid Huffman table \"" + value + "\"";
+            return false;
+        }
+
+        skip_spaces(line, pos);
+        if (pos < line.size() && line[pos] == ',')
+        {
+            pos++;
+            continue;
+        }
+        if (pos < line.size() && line[pos] == '}')
+            break;
+        error = "expected ',' or '}' in JSON object";
+        return false;
+    }
+
+    pos++;
+    skip_spaces(line, pos);
+    if (pos != line.size())
+    {
+        error = "trailing characters after JSON object";
+        return false;
+    }
+    if (!has_data)
+    {
+        error = "missing \"data\" member";
+        return false;
+    }
+    return true;
+}
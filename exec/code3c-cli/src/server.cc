@@ -0,0 +1,467 @@
+/*
+ * 3C-CODE CLI -- Command Line Interface (software)
+ * Copyright (C) 2023 - Rin "madeshiro" Baudelet
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with this
+ * program. If not, see <https://www.gnu.org/licenses/>.
+ */
+#include "server.hh"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <memory>
+#include <span>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+using namespace code3c;
+
+namespace
+{
+    // epoll ids of the listening socket and the wake-up event
+    const uint64_t LISTEN_ID = 0;
+    const uint64_t WAKE_ID   = 1;
+
+    uint32_t read_be32(const char* buf)
+    {
+        auto* b = (const unsigned char*) buf;
+        return ((uint32_t) b[0] << 24) | ((uint32_t) b[1] << 16) | ((uint32_t) b[2] << 8) | b[3];
+    }
+
+    // @return false if the format name is unknown
+    bool format_of(const std::string& name, PixelMap::Format& format, bool& svg)
+    {
+        svg = false;
+        format = PixelMap::FORMAT_PNG;
+        if (name == "svg")
+            svg = true;
+        else if (name == "ppm")
+            format = PixelMap::FORMAT_PPM;
+        else if (name == "pam")
+            format = PixelMap::FORMAT_PAM;
+        else if (name == "qoi")
+            format = PixelMap::FORMAT_QOI;
+        else if (!name.empty() && name != "png")
+            return false;
+        return true;
+    }
+}
+
+std::string serve_frame(char kind, std::string_view body)
+{
+    auto len((uint32_t) (body.size() + 1));
+    std::string frame;
+    frame.reserve(body.size() + 5);
+    frame += (char) (len >> 24);
+    frame += (char) (len >> 16);
+    frame += (char) (len >> 8);
+    frame += (char) len;
+    frame += kind;
+    frame += body;
+    return frame;
+}
+
+code3c_server::code3c_server(const char *path, unsigned jobs, const code3c_options &defaults):
+        m_path(path), m_defaults(defaults), m_listen(-1), m_epoll(-1), m_wake(-1),
+        m_stop(false), m_ids(WAKE_ID + 1), m_latencies(), m_requests(0), m_errors(0),
+        m_pending(0), m_start(clock::now()),
+        m_pool(std::make_unique<WorkPool>(std::max(jobs, 1u)))
+{
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    if (m_path.size() >= sizeof(addr.sun_path))
+        throw std::runtime_error("Socket path too long");
+    strcpy(addr.sun_path, path);
+
+    // A socket file left by a previous server: only replaced if nothing
+    // accepts connections on it anymore
+    struct stat st{};
+    if (stat(path, &st) == 0 && S_ISSOCK(st.st_mode))
+    {
+        int probe(socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0));
+        bool live(probe >= 0 && connect(probe, (sockaddr*) &addr, sizeof(addr)) == 0);
+        int error(errno);
+        if (probe >= 0)
+            ::close(probe);
+        if (live)
+            throw std::runtime_error("A server is already listening on \"" + m_path + "\"");
+        if (probe >= 0 && error == ECONNREFUSED)
+            unlink(path);
+    }
+
+    m_listen = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (m_listen < 0 || bind(m_listen, (sockaddr*) &addr, sizeof(addr)) != 0 ||
+        listen(m_listen, SOMAXCONN) != 0)
+    {
+        std::string error(strerror(errno));
+        if (m_listen >= 0)
+            ::close(m_listen);
+        throw std::runtime_error("Unable to listen on \"" + m_path + "\": " + error);
+    }
+
+    m_epoll = epoll_create1(EPOLL_CLOEXEC);
+    m_wake = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    epoll_event listen_event{EPOLLIN, {.u64 = LISTEN_ID}}, wake_event{EPOLLIN, {.u64 = WAKE_ID}};
+    if (m_epoll < 0 || m_wake < 0 ||
+        epoll_ctl(m_epoll, EPOLL_CTL_ADD, m_listen, &listen_event) != 0 ||
+        epoll_ctl(m_epoll, EPOLL_CTL_ADD, m_wake, &wake_event) != 0)
+    {
+        std::string error(strerror(errno));
+        for (int fd : {m_listen, m_epoll, m_wake})
+            if (fd >= 0)
+                ::close(fd);
+        unlink(path);
+        throw std::runtime_error("Unable to set up the event loop: " + error);
+    }
+
+    // Load the tables and assets before the first request
+    bool failed;
+    generate("warm-up", failed);
+}
+
+code3c_server::~code3c_server()
+{
+    m_pool.reset();
+    for (auto& [id, conn] : m_connections)
+        ::close(conn.fd);
+    ::close(m_listen);
+    ::close(m_epoll);
+    ::close(m_wake);
+    unlink(m_path.c_str());
+}
+
+void code3c_server::stop()
+{
+    m_stop = true;
+    uint64_t one(1);
+    [[maybe_unused]] ssize_t n = write(m_wake, &one, sizeof(one));
+}
+
+void code3c_server::run()
+{
+    epoll_event events[64];
+    while (!m_stop)
+    {
+        int count(epoll_wait(m_epoll, events, 64, -1));
+        if (count < 0 && errno == EINTR)
+            continue;
+        if (count < 0)
+            throw std::runtime_error(std::string("epoll_wait: ") + strerror(errno));
+
+        for (int i(0); i < count && !m_stop; i++)
+        {
+            uint64_t id(events[i].data.u64);
+            if (id == LISTEN_ID)
+            {
+                accept_all();
+                continue;
+            }
+            if (id == WAKE_ID)
+            {
+                uint64_t value;
+                while (read(m_wake, &value, sizeof(value)) > 0);
+                complete();
+                continue;
+            }
+
+            auto found(m_connections.find(id));
+            if (found == m_connections.end())
+                continue;
+            connection& conn(found->second);
+            if (events[i].events & (EPOLLERR | EPOLLHUP))
+            {
+                close(id);
+                continue;
+            }
+            if (events[i].events & EPOLLIN)
+                receive(id, conn);
+            if (m_connections.count(id) && (events[i].events & EPOLLOUT))
+                serve(id, conn);
+        }
+    }
+}
+
+void code3c_server::accept_all()
+{
+    int fd;
+    while ((fd = accept4(m_listen, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0)
+    {
+        uint64_t id(m_ids++);
+        epoll_event event{EPOLLIN, {.u64 = id}};
+        if (epoll_ctl(m_epoll, EPOLL_CTL_ADD, fd, &event) != 0)
+        {
+            ::close(fd);
+            continue;
+        }
+        connection& conn(m_connections[id]);
+        conn.id = id;
+        conn.fd = fd;
+        conn.events = EPOLLIN;
+    }
+}
+
+void code3c_server::receive(uint64_t id, connection &conn)
+{
+    // At most one largest request ahead of the queued ones
+    char buf[1 << 16];
+    ssize_t len(1);
+    while (conn.in.size() - conn.inpos < 4 + CODE3C_SERVE_MAX_SIZE &&
+           (len = recv(conn.fd, buf, sizeof(buf), 0)) > 0)
+        conn.in.append(buf, (size_t) len);
+    if (len == 0)
+        conn.eof = true;
+    else if (len < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+    {
+        close(id);
+        return;
+    }
+    serve(id, conn);
+}
+
+void code3c_server::serve(uint64_t id, connection &conn)
+{
+    // Sending the responses may resume the requests of a paused connection
+    do
+    {
+        while (!throttled(conn) && framed(conn))
+            queue(id, conn);
+        if (conn.inpos > 0)
+        {
+            conn.in.erase(0, conn.inpos);
+            conn.inpos = 0;
+        }
+
+        deliver(conn);
+        if (!send_all(conn))
+        {
+            close(id);
+            return;
+        }
+    }
+    while (!throttled(conn) && framed(conn));
+}
+
+void code3c_server::queue(uint64_t id, connection &conn)
+{
+    uint32_t size(read_be32(&conn.in[conn.inpos]));
+    if (size == 0 || size > CODE3C_SERVE_MAX_SIZE)
+    {
+        // Out of sync: answered, then closed
+        conn.ready[conn.next++] = serve_frame(CODE3C_SERVE_ERROR, "invalid request size");
+        conn.eof = true;
+        conn.inpos = conn.in.size();
+        return;
+    }
+
+    char kind(conn.in[conn.inpos + 4]);
+    uint64_t sequence(conn.next++);
+    if (kind == CODE3C_SERVE_STATS)
+        conn.ready[sequence] = serve_frame(CODE3C_SERVE_OK, statistics());
+    else if (kind == CODE3C_SERVE_CODE)
+    {
+        auto body(std::make_shared<const std::string>(conn.in, conn.inpos + 5, size - 1));
+        clock::time_point received(clock::now());
+        m_pending++;
+        m_pool->submit(1, [this, id, sequence, body, received](int) {
+            bool failed;
+            std::string frame(generate(*body, failed));
+            record(std::chrono::duration<double, std::milli>(clock::now() - received).count(),
+                   failed);
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_completed.push_back({id, sequence, std::move(frame)});
+            }
+            uint64_t one(1);
+            [[maybe_unused]] ssize_t n = write(m_wake, &one, sizeof(one));
+        });
+    }
+    else
+        conn.ready[sequence] = serve_frame(CODE3C_SERVE_ERROR, "unknown request kind");
+    conn.inpos += 4 + size;
+}
+
+bool code3c_server::framed(const connection &conn)
+{
+    // A complete request, or a size which can't be one
+    size_t available(conn.in.size() - conn.inpos);
+    if (available < 4)
+        return false;
+    uint32_t size(read_be32(&conn.in[conn.inpos]));
+    return size == 0 || size > CODE3C_SERVE_MAX_SIZE || available - 4 >= size;
+}
+
+bool code3c_server::throttled(const connection &conn)
+{
+    return conn.next - conn.sent >= CODE3C_SERVE_BACKLOG ||
+           conn.out.size() - conn.outpos >= CODE3C_SERVE_MAX_OUT;
+}
+
+void code3c_server::deliver(connection &conn)
+{
+    for (auto it(conn.ready.begin()); it != conn.ready.end() && it->first == conn.sent;
+         it = conn.ready.erase(it))
+    {
+        conn.out += it->second;
+        conn.sent++;
+    }
+}
+
+bool code3c_server::send_all(connection &conn)
+{
+    while (conn.outpos < conn.out.size())
+    {
+        ssize_t len(send(conn.fd, conn.out.data() + conn.outpos, conn.out.size() - conn.outpos,
+                         MSG_NOSIGNAL));
+        if (len < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            break;
+        if (len < 0 && errno != EINTR)
+            return false;
+        if (len > 0)
+            conn.outpos += (size_t) len;
+    }
+    if (conn.outpos == conn.out.size())
+    {
+        conn.out.clear();
+        conn.outpos = 0;
+    }
+
+    // Closed once every response of a finished client is sent
+    if (conn.eof && conn.out.empty() && conn.sent == conn.next && !framed(conn))
+        return false;
+
+    // Readable until the end of the requests (paused while throttled),
+    // writable while sending
+    uint32_t events((conn.eof || throttled(conn) ? 0 : (uint32_t) EPOLLIN) |
+                    (conn.out.empty() ? 0 : (uint32_t) EPOLLOUT));
+    if (events != conn.events)
+    {
+        epoll_event event{events, {.u64 = conn.id}};
+        epoll_ctl(m_epoll, EPOLL_CTL_MOD, conn.fd, &event);
+        conn.events = events;
+    }
+    return true;
+}
+
+void code3c_server::close(uint64_t id)
+{
+    auto found(m_connections.find(id));
+    if (found == m_connections.end())
+        return;
+    epoll_ctl(m_epoll, EPOLL_CTL_DEL, found->second.fd, nullptr);
+    ::close(found->second.fd);
+    m_connections.erase(found);
+}
+
+void code3c_server::complete()
+{
+    std::vector<completion> completed;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        completed.swap(m_completed);
+    }
+    for (completion& done : completed)
+    {
+        m_pending--;
+        auto found(m_connections.find(done.connection));
+        if (found == m_connections.end())
+            continue; // client gone
+        found->second.ready[done.sequence] = std::move(done.frame);
+    }
+    for (const completion& done : completed)
+    {
+        auto found(m_connections.find(done.connection));
+        if (found == m_connections.end())
+            continue;
+        serve(done.connection, found->second);
+    }
+}
+
+std::string code3c_server::generate(const std::string &body, bool &failed) const
+{
+    // Codes are generated in parallel: each one is rendered on its thread
+    thread_local WorkPool serial(0);
+
+    failed = true;
+    code3c_record rec;
+    rec.options = m_defaults;
+    std::string error;
+    PixelMap::Format format;
+    bool svg;
+    if (!parse_record(body, rec, error))
+        return serve_frame(CODE3C_SERVE_ERROR, error);
+    if (!format_of(rec.format, format, svg))
+        return serve_frame(CODE3C_SERVE_ERROR, "invalid format \"" + rec.format + "\"");
+
+    try
+    {
+        Code3C code(std::as_bytes(std::span(rec.data))); // borrows rec.data
+        setup_code(code, rec.options);
+        if (!code.generate())
+            return serve_frame(CODE3C_SERVE_ERROR, "input too large for the model");
+
+        failed = false;
+        if (svg)
+            return serve_frame(CODE3C_SERVE_OK, code.renderSVG());
+        std::vector<uint8_t> image(code.render(format, serial));
+        return serve_frame(CODE3C_SERVE_OK, {(const char*) image.data(), image.size()});
+    }
+    catch (const std::exception& e)
+    {
+        failed = true;
+        return serve_frame(CODE3C_SERVE_ERROR, e.what());
+    }
+}
+
+void code3c_server::record(double latency, bool failed)
+{
+    std::lock_guard<std::mutex> lock(m_statsMutex);
+    if (m_latencies.size() < CODE3C_SERVE_SAMPLES)
+        m_latencies.push_back((float) latency);
+    else
+        m_latencies[m_requests % CODE3C_SERVE_SAMPLES] = (float) latency;
+    m_requests++;
+    m_errors += failed;
+}
+
+std::string code3c_server::statistics()
+{
+    std::vector<float> sorted;
+    size_t requests, errors;
+    {
+        std::lock_guard<std::mutex> lock(m_statsMutex);
+        sorted = m_latencies;
+        requests = m_requests;
+        errors = m_errors;
+    }
+    std::sort(sorted.begin(), sorted.end());
+    auto percentile = [&sorted](double p) -> double {
+        if (sorted.empty())
+            return 0;
+        return sorted[std::min(sorted.size() - 1, (size_t) (p * (double) sorted.size()))];
+    };
+
+    char json[512];
+    snprintf(json, sizeof(json),
+             "{\"requests\": %zu, \"errors\": %zu, \"pending\": %zu, \"uptime\": %.3f, "
+             "\"latency\": {\"p50\": %.3f, \"p90\": %.3f, \"p99\": %.3f, \"max\": %.3f}}",
+             requests, errors, m_pending.load(),
+             std::chrono::duration<double>(clock::now() - m_start).count(),
+             percentile(0.50), percentile(0.90), percentile(0.99),
+             sorted.empty() ? 0.0 : (double) sorted.back());
+    return json;
+}
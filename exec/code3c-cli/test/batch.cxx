@@ -0,0 +1,222 @@
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <unistd.h>
+#include <code3c/pixelmap.hh>
+#include "batch.hh"
+
+using namespace code3c;
+
+// Test functions
+int batch_filenames();
+int batch_records();
+int batch_run();
+int batch_failures();
+
+// Utils functions
+static FILE* records_file(const char* content)
+{
+    FILE* in = tmpfile();
+    if (in)
+    {
+        fwrite(content, 1, strlen(content), in);
+        rewind(in);
+    }
+    return in;
+}
+
+static int run(const char* content, const char* pattern, unsigned jobs)
+{
+    FILE* in(records_file(content));
+    if (!in)
+        return -1;
+    int status(run_batch(in, pattern, jobs, code3c_options()));
+    fclose(in);
+    return status;
+}
+
+/**
+ * @return true if the file holds the code of the payload, with the default
+ * options but the model
+ */
+static bool same_code(const char* fname, std::string_view payload,
+                      uint8_t model = CODE3C_MODEL_WB2C)
+{
+    if (access(fname, R_OK) != 0)
+        return false;
+    code3c_options options;
+    options.model = model;
+    Code3C code{std::as_bytes(std::span<const char>(payload.data(), payload.size()))};
+    setup_code(code, options);
+    if (!code.generate())
+        return false;
+    PixelMap saved(PixelMap::loadFromPNG(fname));
+    PixelMap expected(PixelMap::decodePNG(code.renderPNG()));
+    return saved.width() == expected.width() && saved.height() == expected.height() &&
+           memcmp(saved.data(), expected.data(), expected.size() * sizeof(uint32_t)) == 0;
+}
+
+typedef int (*TestFunction)(void); /* NOLINT */
+typedef struct /* NOLINT */
+{
+    const char* name;
+    TestFunction func;
+    uint32_t id;
+    int exit_code;
+} testFunctionMapEntry;
+
+static testFunctionMapEntry registeredFunctionEntries[] = {
+        {
+                "filenames",
+                batch_filenames,
+                0, 0
+        },
+        {
+                "records",
+                batch_records,
+                1, 0
+        },
+        {
+                "run",
+                batch_run,
+                2, 0
+        },
+        {
+                "failures",
+                batch_failures,
+                3, 0
+        }
+};
+
+int test_batch(int argc [[maybe_unused]], char** argv [[maybe_unused]])
+{
+    uint32_t status(0u), pass(0),
+            found(sizeof(registeredFunctionEntries)/sizeof(testFunctionMapEntry));
+
+    std::cout << "Running batch tests..." << std::endl;
+    std::cout << "Found " << found << " test(s) to run" << std::endl;
+
+    for (testFunctionMapEntry &entry : registeredFunctionEntries)
+    {
+        std::cout << "test " << entry.name << "... ";
+        entry.exit_code = entry.func();
+        if (entry.exit_code != 0)
+        {
+            std::cout << "FAIL with return code " << entry.exit_code << std::endl;
+            status |= (0x1 << entry.id);
+        }
+        else
+        {
+            pass++;
+            std::cout << "OK" << std::endl;
+        }
+    }
+
+    std::cout << pass << "/" << found << " test(s) passed" << std::endl;
+    return (int) status;
+}
+
+int batch_filenames()
+{
+    std::string fname, error;
+
+    // Record number for {n}, and for {id} without id
+    if (!batch_filename("out-{n}-{id}.png", 7, "", fname, error) || fname != "out-7-7.png")
+        return 1;
+    if (!batch_filename("{id}/{id}.svg", 7, "label_1.x-y", fname, error) ||
+        fname != "label_1.x-y/label_1.x-y.svg")
+        return 2;
+
+    // Ids are plain file names
+    for (const char* id : {"../up", ".hidden", "a/b", "with space", "tab\t"})
+    {
+        error.clear();
+        if (batch_filename("{id}.png", 1, id, fname, error) || error.empty())
+            return 3;
+    }
+    return 0;
+}
+
+int batch_records()
+{
+    code3c_record record;
+    std::string error;
+
+    // Raw line, taken whole
+    if (!parse_record("raw {payload}", record, error) || record.data != "raw {payload}" ||
+        !record.id.empty())
+        return 1;
+
+    // JSON object, escaped NUL included
+    if (!parse_record(R"({"data": "a\u0000b\n", "id": "nul", "model": "WB6C"})", record, error) ||
+        record.data != std::string("a\0b\n", 4) || record.id != "nul" ||
+        record.options.model != CODE3C_MODEL_WB6C)
+        return 2;
+
+    // Invalid objects
+    for (const char* line : {R"({"data": 3})", R"({"id": "x"})", R"({"data": "x", "model": "RGB"})",
+                             R"({"data": "x"} trailing)", R"({"data": "x")"})
+    {
+        error.clear();
+        if (parse_record(line, record, error) || error.empty())
+            return 3;
+    }
+    return 0;
+}
+
+int batch_run()
+{
+    const char* content =
+            "raw payload\n"
+            "\n"
+            "{\"data\": \"json payload\", \"id\": \"json\", \"model\": \"WB\"}\r\n"
+            "{\"data\": \"nul\\u0000payload\", \"id\": \"nul\"}";
+    int status(run(content, "batch-{id}.png", 3));
+
+    // The empty line isn't a record: the last one is the third
+    int result(0);
+    if (status != EXIT_SUCCESS)
+        result = 1;
+    else if (!same_code("batch-1.png", "raw payload"))
+        result = 2;
+    else if (!same_code("batch-json.png", "json payload", CODE3C_MODEL_WB))
+        result = 3;
+    else if (!same_code("batch-nul.png", std::string_view("nul\0payload", 11)))
+        result = 4;
+    for (const char* fname : {"batch-1.png", "batch-json.png", "batch-nul.png"})
+        unlink(fname);
+
+    // Without {n} nor {id}, every record would go to the same file
+    if (result == 0 && run("raw payload\n", "batch.png", 1) != EXIT_FAILURE)
+        result = 5;
+    return result;
+}
+
+int batch_failures()
+{
+    // Invalid id and model, and file names taken by a previous record: the
+    // other records are still saved
+    const char* content =
+            "{\"data\": \"escape\", \"id\": \"../escape\"}\n"
+            "{\"data\": \"first\", \"id\": \"dup\"}\n"
+            "{\"data\": \"second\", \"id\": \"dup\"}\n"
+            "{\"data\": \"model\", \"model\": \"RGB\"}\n"
+            "fifth\n"
+            "{\"data\": \"sixth\", \"id\": \"5\"}\n"
+            "{\"data\": \"third\", \"id\": \"dup\"}\n";
+    int status(run(content, "batch-{id}.png", 3));
+
+    int result(0);
+    if (status != EXIT_FAILURE)
+        result = 1;
+    else if (!same_code("batch-dup.png", "first"))
+        result = 2;
+    else if (!same_code("batch-5.png", "fifth"))
+        result = 3;
+    else if (access("batch-4.png", F_OK) == 0)
+        result = 4;
+    for (const char* fname : {"batch-dup.png", "batch-5.png", "batch-4.png"})
+        unlink(fname);
+    return result;
+}
@@ -0,0 +1,187 @@
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <code3c/pixelmap.hh>
+#include "options.hh"
+
+using namespace code3c;
+
+extern char** environ;
+
+#define RENDER_TEST_PAYLOAD "render test"
+
+// Test functions
+int render_png();
+int render_svg();
+int render_errors();
+
+// Utils functions
+/**
+ * Run the CLI (CODE3C_CLI_PATH) with the given arguments, its output being
+ * discarded.
+ * @return the exit status, -1 if the CLI couldn't be run
+ */
+static int run_cli(std::vector<const char*> args)
+{
+    args.insert(args.begin(), CODE3C_CLI_PATH);
+    args.push_back(nullptr);
+
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_addopen(&actions, STDIN_FILENO, "/dev/null", O_RDONLY, 0);
+    posix_spawn_file_actions_addopen(&actions, STDOUT_FILENO, "/dev/null", O_WRONLY, 0);
+    pid_t pid;
+    int error(posix_spawn(&pid, CODE3C_CLI_PATH, &actions, nullptr,
+                          (char* const*) args.data(), environ));
+    posix_spawn_file_actions_destroy(&actions);
+
+    int status;
+    if (error != 0 || waitpid(pid, &status, 0) != pid || !WIFEXITED(status))
+        return -1;
+    return WEXITSTATUS(status);
+}
+
+static std::string read_file(const char* fname)
+{
+    std::string content;
+    FILE* file = fopen(fname, "rb");
+    if (!file)
+        return content;
+    char buf[4096];
+    for (size_t n; (n = fread(buf, 1, sizeof(buf), file)) > 0;)
+        content.append(buf, n);
+    fclose(file);
+    return content;
+}
+
+// The code the CLI renders with its default options
+static Code3C& expected_code()
+{
+    static Code3C code(RENDER_TEST_PAYLOAD);
+    static bool generated(false);
+    if (!generated)
+    {
+        setup_code(code, code3c_options());
+        generated = code.generate();
+    }
+    return code;
+}
+
+typedef int (*TestFunction)(void); /* NOLINT */
+typedef struct /* NOLINT */
+{
+    const char* name;
+    TestFunction func;
+    uint32_t id;
+    int exit_code;
+} testFunctionMapEntry;
+
+static testFunctionMapEntry registeredFunctionEntries[] = {
+        {
+                "png",
+                render_png,
+                0, 0
+        },
+        {
+                "svg",
+                render_svg,
+                1, 0
+        },
+        {
+                "errors",
+                render_errors,
+                2, 0
+        }
+};
+
+int test_render(int argc [[maybe_unused]], char** argv [[maybe_unused]])
+{
+    uint32_t status(0u), pass(0),
+            found(sizeof(registeredFunctionEntries)/sizeof(testFunctionMapEntry));
+
+    std::cout << "Running render mode tests..." << std::endl;
+    std::cout << "Found " << found << " test(s) to run" << std::endl;
+
+    for (testFunctionMapEntry &entry : registeredFunctionEntries)
+    {
+        std::cout << "test " << entry.name << "... ";
+        entry.exit_code = entry.func();
+        if (entry.exit_code != 0)
+        {
+            std::cout << "FAIL with return code " << entry.exit_code << std::endl;
+            status |= (0x1 << entry.id);
+        }
+        else
+        {
+            pass++;
+            std::cout << "OK" << std::endl;
+        }
+    }
+
+    std::cout << pass << "/" << found << " test(s) passed" << std::endl;
+    return (int) status;
+}
+
+int render_png()
+{
+    unlink("render_test.png");
+    if (run_cli({"-t", RENDER_TEST_PAYLOAD, "--render", "-o", "render_test.png"}) != EXIT_SUCCESS)
+        return 1;
+
+    // Same pixels as the library render
+    PixelMap saved(PixelMap::loadFromPNG("render_test.png"));
+    PixelMap expected(PixelMap::decodePNG(expected_code().renderPNG()));
+    unlink("render_test.png");
+    if (saved.width() != expected.width() || saved.height() != expected.height() ||
+        memcmp(saved.data(), expected.data(), expected.size() * sizeof(uint32_t)) != 0)
+        return 2;
+    return 0;
+}
+
+int render_svg()
+{
+    unlink("render_test.svg");
+    if (run_cli({"-t", RENDER_TEST_PAYLOAD, "--render", "-o", "render_test.svg"}) != EXIT_SUCCESS)
+        return 1;
+    std::string document(read_file("render_test.svg"));
+    unlink("render_test.svg");
+    return document == expected_code().renderSVG() ? 0 : 2;
+}
+
+int render_errors()
+{
+    // No output file
+    if (run_cli({"-t", RENDER_TEST_PAYLOAD, "--render"}) != EXIT_FAILURE)
+        return 1;
+    // Output directory missing
+    if (run_cli({"-t", RENDER_TEST_PAYLOAD, "--render", "-o", "missing/code.png"}) != EXIT_FAILURE)
+        return 2;
+    // Values longer than their option buffers
+    std::string digits("--unit=" + std::string(200, '1')), fname(400, 'a');
+    if (run_cli({"-t", RENDER_TEST_PAYLOAD, "--render", digits.c_str(), "-o", "code.png"}) !=
+        EXIT_FAILURE)
+        return 5;
+    if (run_cli({"-t", RENDER_TEST_PAYLOAD, "--render", "-o", fname.c_str()}) != EXIT_FAILURE)
+        return 6;
+
+    // Full device: opened, but every write fails (on close for buffered data)
+    if (access("/dev/full", W_OK) != 0)
+        return 0;
+    int status(0);
+    for (const char* fname : {"render_full.png", "render_full.svg", "render_full.qoi"})
+    {
+        unlink(fname);
+        if (symlink("/dev/full", fname) != 0)
+            return 3;
+        if (run_cli({"-t", RENDER_TEST_PAYLOAD, "--render", "-o", fname}) != EXIT_FAILURE)
+            status = 4;
+        unlink(fname);
+    }
+    return status;
+}
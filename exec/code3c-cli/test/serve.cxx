@@ -0,0 +1,382 @@
+#include <iostream>
+#include <thread>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "server.hh"
+
+using namespace code3c;
+
+#define SERVE_TEST_SOCKET "serve_test.sock"
+
+// Test functions
+int serve_png();
+int serve_formats();
+int serve_errors();
+int serve_pipeline();
+int serve_stats();
+int serve_invalid_size();
+int serve_socket_file();
+int serve_backpressure();
+
+// Utils functions
+static int connect_server()
+{
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, SERVE_TEST_SOCKET);
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd >= 0 && connect(fd, (sockaddr*) &addr, sizeof(addr)) != 0)
+    {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static bool send_request(int fd, char kind, std::string_view body)
+{
+    std::string frame(serve_frame(kind, body));
+    return send(fd, frame.data(), frame.size(), MSG_NOSIGNAL) == (ssize_t) frame.size();
+}
+
+static bool read_exact(int fd, char* buf, size_t len)
+{
+    for (size_t done(0); done < len;)
+    {
+        ssize_t n = read(fd, buf + done, len - done);
+        if (n <= 0)
+            return false;
+        done += (size_t) n;
+    }
+    return true;
+}
+
+// @return the response kind, 0 if the connection is closed
+static char read_response(int fd, std::string& body)
+{
+    char header[5];
+    if (!read_exact(fd, header, 4))
+        return 0;
+    auto* b = (unsigned char*) header;
+    uint32_t len(((uint32_t) b[0] << 24) | ((uint32_t) b[1] << 16) | ((uint32_t) b[2] << 8) | b[3]);
+    if (len == 0 || !read_exact(fd, header + 4, 1))
+        return 0;
+    body.resize(len - 1);
+    return read_exact(fd, body.data(), body.size()) ? header[4] : 0;
+}
+
+static char request(int fd, char kind, std::string_view body, std::string& response)
+{
+    return send_request(fd, kind, body) ? read_response(fd, response) : 0;
+}
+
+static std::string expected_png(const char* payload, uint8_t model = CODE3C_MODEL_WB2C)
+{
+    Code3C code(payload);
+    code.setModel(model);
+    code.generate();
+    std::vector<uint8_t> png(code.renderPNG());
+    return {png.begin(), png.end()};
+}
+
+typedef int (*TestFunction)(void); /* NOLINT */
+typedef struct /* NOLINT */
+{
+    const char* name;
+    TestFunction func;
+    uint32_t id;
+    int exit_code;
+} testFunctionMapEntry;
+
+static testFunctionMapEntry registeredFunctionEntries[] = {
+        {
+                "png",
+                serve_png,
+                0, 0
+        },
+        {
+                "formats",
+                serve_formats,
+                1, 0
+        },
+        {
+                "errors",
+                serve_errors,
+                2, 0
+        },
+        {
+                "pipeline",
+                serve_pipeline,
+                3, 0
+        },
+        {
+                "stats",
+                serve_stats,
+                4, 0
+        },
+        {
+                "invalid_size",
+                serve_invalid_size,
+                5, 0
+        },
+        {
+                "socket_file",
+                serve_socket_file,
+                6, 0
+        },
+        {
+                "backpressure",
+                serve_backpressure,
+                7, 0
+        }
+};
+
+int test_serve(int argc [[maybe_unused]], char** argv [[maybe_unused]])
+{
+    uint32_t status(0u), pass(0),
+            found(sizeof(registeredFunctionEntries)/sizeof(testFunctionMapEntry));
+
+    std::cout << "Running service tests..." << std::endl;
+    std::cout << "Found " << found << " test(s) to run" << std::endl;
+
+    code3c_server server(SERVE_TEST_SOCKET, 2, code3c_options());
+    std::thread loop([&server]() { server.run(); });
+
+    for (testFunctionMapEntry &entry : registeredFunctionEntries)
+    {
+        std::cout << "test " << entry.name << "... ";
+        entry.exit_code = entry.func();
+        if (entry.exit_code != 0)
+        {
+            std::cout << "FAIL with return code " << entry.exit_code << std::endl;
+            status |= (0x1 << entry.id);
+        }
+        else
+        {
+            pass++;
+            std::cout << "OK" << std::endl;
+        }
+    }
+
+    server.stop();
+    loop.join();
+    std::cout << pass << "/" << found << " test(s) passed" << std::endl;
+    return (int) status;
+}
+
+int serve_png()
+{
+    int fd(connect_server());
+    if (fd < 0)
+        return 1;
+
+    // Raw payload, default options
+    std::string response;
+    char kind(request(fd, CODE3C_SERVE_CODE, "hello service", response));
+    close(fd);
+    if (kind != CODE3C_SERVE_OK)
+        return 2;
+    return response == expected_png("hello service") ? 0 : 3;
+}
+
+int serve_formats()
+{
+    int fd(connect_server());
+    if (fd < 0)
+        return 1;
+
+    std::string svg, ppm, png;
+    char ksvg(request(fd, CODE3C_SERVE_CODE,
+                      R"({"data": "vector", "model": "WB6C", "format": "svg"})", svg));
+    char kppm(request(fd, CODE3C_SERVE_CODE, R"({"data": "raw", "format": "ppm"})", ppm));
+    char kpng(request(fd, CODE3C_SERVE_CODE, R"({"data": "model", "model": "WB"})", png));
+    close(fd);
+
+    Code3C code("vector");
+    code.setModel(CODE3C_MODEL_WB6C);
+    code.generate();
+    if (ksvg != CODE3C_SERVE_OK || svg != code.renderSVG())
+        return 2;
+    if (kppm != CODE3C_SERVE_OK || ppm.compare(0, 3, "P6\n") != 0)
+        return 3;
+    if (kpng != CODE3C_SERVE_OK || png != expected_png("model", CODE3C_MODEL_WB))
+        return 4;
+    return 0;
+}
+
+int serve_errors()
+{
+    int fd(connect_server());
+    if (fd < 0)
+        return 1;
+
+    std::string response;
+    if (request(fd, CODE3C_SERVE_CODE, R"({"data": "x", "model": "WB9"})", response)
+        != CODE3C_SERVE_ERROR || response.find("WB9") == std::string::npos)
+        return 2;
+    if (request(fd, CODE3C_SERVE_CODE, R"({"data": "x", "format": "gif"})", response)
+        != CODE3C_SERVE_ERROR)
+        return 3;
+    if (request(fd, 'X', "", response) != CODE3C_SERVE_ERROR)
+        return 4;
+
+    // Payload too large for every dimension of the model
+    std::string huge(100000, 'a');
+    if (request(fd, CODE3C_SERVE_CODE, huge, response) != CODE3C_SERVE_ERROR)
+        return 5;
+
+    // The connection is still served
+    if (request(fd, CODE3C_SERVE_CODE, "after errors", response) != CODE3C_SERVE_OK ||
+        response != expected_png("after errors"))
+        return 6;
+    close(fd);
+    return 0;
+}
+
+int serve_pipeline()
+{
+    int fd(connect_server());
+    if (fd < 0)
+        return 1;
+
+    // Every request sent at once, responses come back in order
+    const int count(8);
+    for (int i(0); i < count; i++)
+        if (!send_request(fd, CODE3C_SERVE_CODE, "pipelined " + std::to_string(i)))
+            return 2;
+    shutdown(fd, SHUT_WR);
+
+    std::string response;
+    for (int i(0); i < count; i++)
+    {
+        if (read_response(fd, response) != CODE3C_SERVE_OK)
+            return 3;
+        if (response != expected_png(("pipelined " + std::to_string(i)).c_str()))
+            return 4;
+    }
+
+    // Closed by the server once every response is sent
+    char end;
+    int status(read(fd, &end, 1) == 0 ? 0 : 5);
+    close(fd);
+    return status;
+}
+
+int serve_stats()
+{
+    int fd(connect_server());
+    if (fd < 0)
+        return 1;
+
+    std::string stats;
+    if (request(fd, CODE3C_SERVE_STATS, "", stats) != CODE3C_SERVE_OK)
+        return 2;
+    close(fd);
+
+    // Requests of the previous tests (warm-up excluded)
+    size_t requests, errors;
+    double p50, p90, p99, max;
+    if (sscanf(stats.c_str(), R"({"requests": %zu, "errors": %zu, "pending": %*u, "uptime": %*f, )"
+                              R"("latency": {"p50": %lf, "p90": %lf, "p99": %lf, "max": %lf}})",
+               &requests, &errors, &p50, &p90, &p99, &max) != 6)
+        return 3;
+    if (requests != 16 || errors != 3)
+        return 4;
+    if (!(0 < p50 && p50 <= p90 && p90 <= p99 && p99 <= max))
+        return 5;
+    return 0;
+}
+
+int serve_invalid_size()
+{
+    int fd(connect_server());
+    if (fd < 0)
+        return 1;
+
+    // A length over the limit can't be skipped: answered, then closed
+    const char header[5] = {0x7f, 0, 0, 0, CODE3C_SERVE_CODE};
+    if (send(fd, header, sizeof(header), MSG_NOSIGNAL) != sizeof(header))
+        return 2;
+    std::string response;
+    if (read_response(fd, response) != CODE3C_SERVE_ERROR)
+        return 3;
+    char end;
+    int status(read(fd, &end, 1) == 0 ? 0 : 4);
+    close(fd);
+    return status;
+}
+
+int serve_socket_file()
+{
+    // The socket of a live server is left alone
+    try
+    {
+        code3c_server other(SERVE_TEST_SOCKET, 1, code3c_options());
+        return 1;
+    }
+    catch (const std::runtime_error&) {}
+    int fd(connect_server());
+    if (fd < 0)
+        return 2;
+    close(fd);
+
+    // A stale one (no server behind it anymore) is replaced
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, "serve_stale.sock");
+    unlink(addr.sun_path);
+    int stale(socket(AF_UNIX, SOCK_STREAM, 0));
+    if (stale < 0 || bind(stale, (sockaddr*) &addr, sizeof(addr)) != 0)
+        return 3;
+    close(stale);
+    try
+    {
+        code3c_server replacing("serve_stale.sock", 1, code3c_options());
+    }
+    catch (const std::runtime_error&)
+    {
+        unlink(addr.sun_path);
+        return 4;
+    }
+    return access(addr.sun_path, F_OK) != 0 ? 0 : 5;
+}
+
+int serve_backpressure()
+{
+    int fd(connect_server());
+    if (fd < 0)
+        return 1;
+
+    // Far more requests than the backlog, sent without reading the responses:
+    // the server pauses the connection, then resumes its buffered requests
+    const int count(8 * CODE3C_SERVE_BACKLOG);
+    bool sent(true);
+    std::thread writer([fd, &sent]() {
+        for (int i(0); i < count && sent; i++)
+            sent = i % 16 == 0 ? send_request(fd, CODE3C_SERVE_CODE, "paused " + std::to_string(i))
+                               : send_request(fd, CODE3C_SERVE_STATS, "");
+        shutdown(fd, SHUT_WR);
+    });
+
+    int status(0);
+    std::string response;
+    for (int i(0); i < count && status == 0; i++)
+    {
+        if (read_response(fd, response) != CODE3C_SERVE_OK)
+            status = 2;
+        else if (i % 16 == 0 && response != expected_png(("paused " + std::to_string(i)).c_str()))
+            status = 3;
+        else if (i % 16 != 0 && response.rfind("{\"requests\": ", 0) != 0)
+            status = 4;
+    }
+    if (status != 0)
+        shutdown(fd, SHUT_RDWR);
+    writer.join();
+
+    char end;
+    if (status == 0 && (!sent || read(fd, &end, 1) != 0))
+        status = 5;
+    close(fd);
+    return status;
+}
@@ -0,0 +1,31 @@
+# Generate a C++ source holding the resources as byte arrays.
+# Usage: cmake -DOUTPUT=<file.cc> -DRESOURCES="<file>;<file>..." -P EmbedResources.cmake
+
+set(content "// Generated by EmbedResources.cmake, do not edit\n")
+string(APPEND content "#include \"code3c/resources.hh\"\n\nnamespace code3c\n{\n")
+
+set(index 0)
+set(table "")
+foreach (rfile ${RESOURCES})
+    get_filename_component(rname ${rfile} NAME)
+    file(READ ${rfile} hex HEX)
+    file(SIZE ${rfile} rsize)
+    string(REGEX REPLACE "([0-9a-f][0-9a-f])" "0x\\1," bytes "${hex}")
+    string(REGEX REPLACE "(0x..,0x..,0x..,0x..,0x..,0x..,0x..,0x..,0x..,0x..,0x..,0x..,0x..,0x..,0x..,0x..,)"
+           "\\1\n        " bytes "${bytes}")
+    string(APPEND content "    static const uint8_t resource_${index}[] = {\n        ${bytes}\n    };\n")
+    string(APPEND table "        {\"${rname}\", resource_${index}, ${rsize}},\n")
+    math(EXPR index "${index} + 1")
+endforeach ()
+
+string(APPEND content "\n    extern const embedded_resource code3c_embedded_resources[] = {\n")
+string(APPEND content "${table}        {nullptr, nullptr, 0}\n    };\n")
+string(APPEND content "    extern const size_t code3c_embedded_resources_count = ${index};\n}\n")
+
+# Only touch the output when it changed
+if (EXISTS ${OUTPUT})
+    file(READ ${OUTPUT} previous)
+endif ()
+if (NOT "${previous}" STREQUAL "${content}")
+    file(WRITE ${OUTPUT} "${content}")
+endif ()
@@ -18,10 +18,16 @@
 #define HH_LIB_3CCODE
 #include <cstddef>
 #include <cstdint>
+#include <memory>
+#include <span>
+#include <string_view>
 #include "drawer.hh"
+#include "assetcache.hh"
+#include "displaylist.hh"
 #include "huffman.hh"
 #include "bitmat.hh"
 #include "hamming743.hh"
+#include "parallel.hh"
 
 #define CODE3C_MODEL_WB 0   /*< White and Black model: 1bit per pattern      */
 #define CODE3C_MODEL_WB2C 1 /*< White, Black and 2 colours: 2bit per pattern */
@@ -39,7 +45,7 @@ namespace code3c
     static struct CODE3C_MODEL_DESC { /* NOLINT */
             int model_id;
             unsigned bitl, mask;
-            const char* default_logo;
+            const char* default_logo; /*< resource name (see resource_path()) */
             struct CODE3C_MODEL_DIMENSION { /* NOLINT */
                 const int rev, absRad, effRad, deltaRad;
                 const int axis_t = rev*2, axis_r = effRad/deltaRad;
@@ -53,7 +59,7 @@ namespace code3c
     } code3c_models[3] = {
             {
                     0,  CODE3C_COLORMODE_WB,
-                    C3CRC("3ccode-wb.png"),
+                    "3ccode-wb.png",
                     {
                         {30,  60, 30, 3}, /** 60 slices, 30 units, 3 units per data
                                            *  dimension 120x120 (pu²)
@@ -79,7 +85,7 @@ namespace code3c
             },
             {
                     1, CODE3C_COLORMODE_WB2C,
-                    C3CRC("3ccode-wb2c.png"),
+                    "3ccode-wb2c.png",
                     {
                         {30,  50, 24, 3}, /** 60 slices, 24 units, 3 units per data
                                            *  dimension 100x100 (pu²)
@@ -105,7 +111,7 @@ namespace code3c
             },
             {
                     2, CODE3C_COLORMODE_WB6C,
-                    C3CRC("3ccode-wb6c.png"),
+                    "3ccode-wb6c.png",
                     {
                         {30,  50, 21, 3}, /** 60 slices, 21 units, 3 units per data
                                            *  dimension 100x100 (pu²)
@@ -131,11 +137,14 @@ namespace code3c
             }
     };
 
-    class Code3CDrawer;
+    class Code3CPainter;
+    template<class Backend> class BasicCode3CDrawer;
+    typedef BasicCode3CDrawer<SimpleDrawer> Code3CDrawer;
 
     class Code3C
     {
-        friend class Code3CDrawer;
+        friend class Code3CPainter;
+        template<class Backend> friend class BasicCode3CDrawer;
     public:
         class data : public mat8_t
         {
@@ -209,13 +218,18 @@ namespace code3c
         uint8_t m_desc = CODE3C_MODEL_WB2C;
         uint8_t m_dim  = 0;
 
-        char8_t* m_rawdata;
+        const char8_t* m_rawdata;
         size_t m_datalen;
+        bool m_owner = true; // false if m_rawdata is borrowed
 
         // Drawer variables
         const char* m_logo;
         const char* m_outfile;
-        Code3CDrawer * m_drawer;
+        bool m_antialiased = false;
+        int m_unit = CODE3C_PIXEL_UNIT;
+        int m_margin = CODE3C_MARGIN;
+        mutable Code3CDrawer * m_drawer; // created on first display
+        mutable std::shared_ptr<const DisplayList> m_display; // laid out on first use
 
         struct header final
         {
@@ -226,7 +240,7 @@ namespace code3c
             uint32_t meta_head_bitl = 6; /*< header length (bit) */
             uint32_t meta_full_bitl = meta_head_bitl+meta_dlen_bitl;
             char8_t operator[](size_t i) const;
-            void from_buffer(char8_t * buf, size_t len);
+            void from_view(mat_view<const char8_t> buf);
         } m_header;
     public:
         /**
@@ -234,11 +248,24 @@ namespace code3c
          */
         explicit Code3C(const char* utf8buf);
         /**
+         * Copy a payload, embedded NULs included.
          *
-         * @param utf8buf
-         * @param buflen
+         * @param utf8buf the payload
+         * @param buflen the payload's length (byte)
          */
         Code3C(const char* utf8buf, size_t buflen);
+        /**
+         * Borrow a payload (binary or text) without copying it.
+         *
+         * @param data the payload, which must outlive the 3C-Code
+         */
+        explicit Code3C(std::span<const std::byte> data);
+        /**
+         * Borrow an UTF-8 payload without copying it.
+         *
+         * @param data the payload, which must outlive the 3C-Code
+         */
+        explicit Code3C(std::u8string_view data);
         /**
          *
          * @param in_data
@@ -264,6 +291,8 @@ namespace code3c
          * @version 1.0.0-RC
          * @warning Mandatory function (even if the default value is WB2C, it's
          * prefearable to explicitly specfied the 3C-Code model)
+         * @warning A generated 3C-Code is discarded when its model changes, it
+         * has to be generated again before being displayed or rendered
          * @param model
          */
         void setModel(uint8_t model);
@@ -303,6 +332,29 @@ namespace code3c
          * @param fname 
          */
         void setLogo(const char* fname);
+
+        /**
+         * Anti-alias the slices and circles of off-screen renders (see
+         * RasterDrawer::setAntialiased()). Disabled by default.
+         * @param antialiased true to blend the edge pixels
+         */
+        void setAntialiased(bool antialiased);
+
+        /**
+         * Defines the output resolution: the amount of pixels for each data
+         * unit and the blank border around the code. Any size can be rendered
+         * off-screen, files being written band by band (see save()). Values
+         * out of range are ignored.
+         *
+         * @note Per default, CODE3C_PIXEL_UNIT and CODE3C_MARGIN
+         * @param unit the pixels per data unit (at least 1)
+         * @param margin the border width in pixels (at least 0)
+         */
+        void setPixelUnit(int unit, int margin = CODE3C_MARGIN);
+        inline int pixelUnit() const
+        { return m_unit; }
+        inline int margin() const
+        { return m_margin; }
         
         /**
          * Generate the 3C-Code using every defined descriptor values setup before.
@@ -324,15 +376,75 @@ namespace code3c
          * @warning method available only if 3C-Code has been generated through
          * <code>Code3C::generate()</code> or using <code>Code3C::Code3C(const mat8_t&)
          * </code> constructor.
+         * @throw std::runtime_error if no display server can be reached (use
+         * <code>save()</code> or <code>render()</code> for headless output)
          */
         void display() const;
 
         /**
-         * Gets the drawer of the 3C-Code
+         * Gets the drawer of the 3C-Code, opening it on first call.
          * @return the 3C-Code drawer
          */
         Drawer* drawer() const;
 
+        /**
+         * Gets the display list of the 3C-Code, laid out on first call and
+         * shared by every later display or render, whatever the backend or
+         * the output size.
+         *
+         * @warning method available only if 3C-Code has been generated through
+         * <code>Code3C::generate()</code> or using <code>Code3C::Code3C(const mat8_t&)
+         * </code> constructor.
+         * @return the immutable display list
+         */
+        std::shared_ptr<const DisplayList> displayList() const;
+
+        /**
+         * Render the 3C-Code off-screen and encode it as PNG, without any
+         * display nor temporary file.
+         *
+         * @warning method available only if 3C-Code has been generated through
+         * <code>Code3C::generate()</code>.
+         * @return the png file content
+         * @throw std::runtime_error if the 3C-Code hasn't been generated
+         */
+        std::vector<uint8_t> renderPNG() const;
+
+        /**
+         * Render the 3C-Code off-screen and encode it in the specified format.
+         *
+         * @param format the image format (PNG, PPM, PAM or QOI)
+         * @param pool the pool rendering the tiles (e.g. a pool without
+         * thread to render many codes at once, one per thread)
+         * @return the file content
+         * @throw std::runtime_error if the 3C-Code hasn't been generated
+         */
+        std::vector<uint8_t> render(PixelMap::Format format,
+                                    WorkPool& pool = WorkPool::instance()) const;
+
+        /**
+         * Render the 3C-Code as an SVG document: one path per run of
+         * same-coloured cells along each ring, the marker and the logo being
+         * embedded as PNG data URIs.
+         *
+         * @return the SVG document
+         * @throw std::runtime_error if the 3C-Code hasn't been generated
+         */
+        std::string renderSVG() const;
+
+        /**
+         * Save the 3C-Code, the format being chosen from the file extension
+         * (<code>.svg</code>, <code>.ppm</code>, <code>.pam</code>,
+         * <code>.qoi</code>, PNG otherwise). Images are rendered and written
+         * band by band, in memory independent of the output size.
+         *
+         * @param fname the output file name
+         * @param pool the pool rendering the tiles (see <code>render()</code>)
+         * @throw std::runtime_error if the 3C-Code hasn't been generated or the
+         * file couldn't be opened
+         */
+        void save(const char* fname, WorkPool& pool = WorkPool::instance()) const;
+
         /**
          * Sets the output file's (png) name
          */
@@ -416,25 +528,72 @@ namespace code3c
         const CODE3C_MODEL_DESC& model() const;
     };
 
-    // Generate drawer
-    class Code3CDrawer : public SimpleDrawer
+    /**
+     * Paints a 3C-Code (marker, calibration ring, data and logo) through the
+     * Drawer interface, independently of the drawing backend.
+     */
+    class Code3CPainter
     {
         const Code3C *parent;
         const CODE3C_MODEL_DESC::CODE3C_MODEL_DIMENSION &modelDimension;
 
-        PixelMap *logo, *marker;
+        void layout_ring(DisplayList& list, const mat8_t& data, int r) const;
+    public:
+        explicit Code3CPainter(const Code3C *parent);
+        Code3CPainter(const Code3CPainter&) = delete;
+
+        /**
+         * @param unit the pixels per data unit
+         * @param margin the blank border width (pixels)
+         * @return the drawing size (width and height) of a 3C-Code
+         */
+        static int size(const CODE3C_MODEL_DESC::CODE3C_MODEL_DIMENSION& dim,
+                        int unit = CODE3C_PIXEL_UNIT, int margin = CODE3C_MARGIN);
+
+        unsigned long bit_to_color(char _byte) const;
+
+        /**
+         * @return the expected colours of the 3C-Code (see Drawer::palette())
+         */
+        std::vector<uint32_t> palette() const;
+
+        /**
+         * Lay out the 3C-Code (marker, calibration ring, data and logo) in a
+         * <code>size()</code> x <code>size()</code> reference space, at the
+         * pixel unit and margin of the code.
+         * @param data the 3C-Code matrix
+         * @return the display list of the code
+         */
+        DisplayList layout(const mat8_t& data) const;
+
+        /**
+         * Replay the display list of the 3C-Code, scaled to the drawer.
+         */
+        void paint(Drawer& drawer) const;
+    };
+
+    /**
+     * 3C-Code drawer on top of a drawing backend (SimpleDrawer to display the
+     * code, RasterDrawer to render it off-screen).
+     */
+    template<class Backend>
+    class BasicCode3CDrawer : public Backend
+    {
+        const Code3C *parent;
+        Code3CPainter painter;
 
         __dlgt save_ui();
     public:
-        Code3CDrawer(const Code3C *parent, const Code3C::data &cData);
-        ~Code3CDrawer();
+        BasicCode3CDrawer(const Code3C *parent, const Code3C::data &cData);
 
-        unsigned long bit_to_color(char _byte);
-        void draw_angle(int t);
+        std::vector<uint32_t> palette() const override;
 
         void setup() override;
         void draw() override;
     };
+
+    typedef BasicCode3CDrawer<RasterDrawer> Code3CRasterDrawer;
+    typedef BasicCode3CDrawer<SVGDrawer> Code3CSVGDrawer;
 }
 
 #endif // HH_LIB_3CCODE
\ No newline at end of file
@@ -55,34 +55,18 @@
 #ifdef CODE3C_UNIX
 #include "signal.h"
 #include "unistd.h"
-#define C3CRC(fname) []() -> const char* { \
-        if (access("/usr/share/code3c/" fname, F_OK) == 0) { \
-            cDebug("ressources: /usr/share/code3c/" fname "\n"); \
-            return "/usr/share/code3c/" fname;               \
-        }  \
-        if (access("/usr/local/share/code3c/" fname, F_OK) == 0) { \
-            cDebug("ressources: /usr/local/share/code3c/" fname "\n");  \
-            return "/usr/local/share/code3c/" fname;               \
-        }  \
-        else if (access("resources/" fname, F_OK) == 0)     \
-            return "resources/" fname;                      \
-        else  {                                             \
-            fprintf(stderr, "unable to find resources '%s'\n", fname); \
-            return fname;                                   \
-        }                                              \
-    }()
 #endif // CODE3C_UNIX
 
-#ifdef CODE3C_WIN32
-// #include <io.h>
-// #define F_OK 0
-// #define access _access
-#define C3CRC(fname) "resources/" fname
-#endif // CODE3C_WIN32
+#ifdef __cplusplus
+#include "resources.hh"
+// Resolved once per process (see code3c::resource_path())
+#define C3CRC(fname) code3c::resource_path(fname)
+#endif // __cplusplus
 
 // DEFINE CONSTANTS //
 
-#define CODE3C_PIXEL_UNIT 3 // Amount of pixel for each data unit
+#define CODE3C_PIXEL_UNIT 3 // Default amount of pixel for each data unit
+#define CODE3C_MARGIN 20    // Default blank border around the code (pixels)
 
 
 #endif //HH_LIB_3CCODELIB
@@ -0,0 +1,136 @@
+/*
+ * 3C-CODE Library
+ * Copyright (C) 2023 - Rin "madeshiro" Baudelet
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with this
+ * program. If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef HH_LIB_ASSETCACHE
+#define HH_LIB_ASSETCACHE
+#include "pixelmap.hh"
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#define CODE3C_ASSET_CACHE_CAPACITY (64u << 20) // Default memory cap (bytes)
+
+namespace code3c
+{
+    /**
+     * Process-wide LRU cache of decoded and resized PNG assets (marker, logos).
+     * Entries are keyed by the resolved file path, its modification time and
+     * the target size: a file modified on disk is decoded again. Cached images
+     * are immutable and shared, they stay valid as long as a user holds them,
+     * even once evicted. All methods are thread-safe.
+     */
+    class AssetCache
+    {
+    public:
+        typedef std::shared_ptr<const PixelMap> asset;
+        /** Post-processing applied once to a resized image before caching */
+        typedef std::function<void(PixelMap&)> Finisher;
+
+    private:
+        struct key
+        {
+            std::string path;
+            long long mtime;
+            int width, height;
+            int variant;
+
+            bool operator==(const key&) const = default;
+        };
+
+        struct key_hash
+        {
+            size_t operator()(const key& k) const;
+        };
+
+        struct entry
+        {
+            key id;
+            asset map;
+        };
+
+        mutable std::mutex m_mutex;
+        std::list<entry> m_entries; /*< most recently used first */
+        std::unordered_map<key, std::list<entry>::iterator, key_hash> m_index;
+        size_t m_capacity, m_memory;
+        size_t m_hits, m_misses;
+
+        void evict(size_t capacity);
+    public:
+        explicit AssetCache(size_t capacity = CODE3C_ASSET_CACHE_CAPACITY);
+        AssetCache(const AssetCache&) = delete;
+
+        /**
+         * @return the cache shared by the whole process
+         */
+        static AssetCache& instance();
+
+        /**
+         * Get a PNG file resized to <code>width</code> x <code>height</code>,
+         * decoding and resizing it on a miss (0 keeps the dimension).
+         *
+         * @param fname the PNG file
+         * @param width the target width
+         * @param height the target height
+         * @return the shared image
+         * @throw std::runtime_error if the file can't be decoded
+         */
+        asset load(const char* fname, int width, int height);
+
+        /**
+         * Get a PNG file at its own size, decoding it on a miss.
+         *
+         * @param fname the PNG file
+         * @return the shared image
+         * @throw std::runtime_error if the file can't be decoded
+         */
+        asset load(const char* fname);
+
+        /**
+         * Same as <code>load(fname, width, height)</code>, the resized image
+         * being processed by <code>finish</code> before it is cached.
+         *
+         * @param variant identifies the post-processing in the cache key, two
+         * different finishers must use different variants
+         * @param finish the post-processing
+         */
+        asset load(const char* fname, int width, int height, int variant,
+                   const Finisher& finish);
+
+        /**
+         * Set the memory cap (bytes of pixel data), evicting the least recently
+         * used entries if needed. Images larger than the cap aren't cached.
+         */
+        void setCapacity(size_t bytes);
+        size_t capacity() const;
+
+        /**
+         * @return the bytes of pixel data currently held by the cache
+         */
+        size_t memory() const;
+        size_t hits() const;
+        size_t misses() const;
+
+        /**
+         * Drop every entry and reset the counters.
+         */
+        void clear();
+    };
+}
+
+#endif //HH_LIB_ASSETCACHE
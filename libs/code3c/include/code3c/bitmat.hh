@@ -17,9 +17,90 @@
 #ifndef HH_LIB_BITMAT
 #define HH_LIB_BITMAT
 #include <cmath>
+#include <span>
+#include <stdexcept>
+#include <type_traits>
 
 namespace code3c
 {
+    template < typename T >
+    class mat;
+
+    template < typename T >
+    /**
+     * Non-owning view over the elements of a <code>mat&lt;T&gt;</code>. A view
+     * is described by an origin, a dimension and a stride for each axis, so it
+     * can express strided submatrices, single rows or columns and ring slices
+     * of a 3C-Code matrix without copying any element.
+     *
+     * @warning the view doesn't extend the lifetime of the viewed matrix.
+     * @tparam T type of data contains in the matrix (const-qualified for a
+     * read-only view)
+     */
+    class mat_view
+    {
+        T* const* m_rows;
+        int m_i0, m_j0;
+        int m_row, m_column;
+        int m_di, m_dj;
+    public:
+        mat_view(T* const* rows, int i0, int j0, int n, int m,
+                 int di = 1, int dj = 1) noexcept(true):
+            m_rows(rows), m_i0(i0), m_j0(j0), m_row(n), m_column(m),
+            m_di(di), m_dj(dj)
+        {
+        }
+
+        inline int n() const noexcept(true) { return m_row; }
+        inline int m() const noexcept(true) { return m_column; }
+        inline int size() const noexcept(true) { return m_row * m_column; }
+
+        inline T& operator[](int i, int j) const
+        { return m_rows[m_i0 + i*m_di][m_j0 + j*m_dj]; }
+
+        /**
+         * Get the element at the specified index, using row-major order.
+         */
+        inline T& operator[](int k) const
+        { return m_column == 1 ? operator[](k, 0) : operator[](k / m_column,
+                                                            k % m_column); }
+
+        /**
+         * Get a view over a part of this view (strides are relative to the view).
+         */
+        mat_view<T> view(int i, int j, int n, int m, int di = 1, int dj = 1) const
+        {
+            return mat_view<T>(m_rows, m_i0 + i*m_di, m_j0 + j*m_dj, n, m,
+                               m_di*di, m_dj*dj);
+        }
+
+        inline mat_view<T> row(int i) const
+        { return view(i, 0, 1, m_column); }
+
+        inline mat_view<T> column(int j) const
+        { return view(0, j, m_row, 1); }
+
+        /**
+         * Get the contiguous elements of a row.
+         * @warning only available when the column stride is 1
+         */
+        std::span<T> span(int i) const noexcept(false)
+        {
+            if (m_dj != 1)
+                throw std::runtime_error("Non-contiguous row (column stride)");
+            return std::span<T>(&m_rows[m_i0 + i*m_di][m_j0], m_column);
+        }
+
+        inline operator mat_view<const T>() const requires (!std::is_const_v<T>)
+        { return mat_view<const T>(m_rows, m_i0, m_j0, m_row, m_column,
+                                   m_di, m_dj); }
+
+        /**
+         * Build an owning copy of the viewed elements.
+         */
+        mat<std::remove_const_t<T>> copy() const;
+    };
+
     template < typename T >
     /**
      * 
@@ -45,6 +126,42 @@ namespace code3c
         virtual mat<T> transposed() const;
         virtual mat<T> submatrix(int rows[], int nrows,
                                  int columns[], int ncolomns) const;
+
+        /**
+         * Get a non-owning view over a (strided) submatrix.
+         * @param i first row
+         * @param j first column
+         * @param n number of rows
+         * @param m number of columns
+         * @param di row stride
+         * @param dj column stride
+         */
+        inline mat_view<T> view(int i, int j, int n, int m, int di = 1, int dj = 1)
+        { return mat_view<T>(m_mat, i, j, n, m, di, dj); }
+        inline mat_view<const T> view(int i, int j, int n, int m,
+                                      int di = 1, int dj = 1) const
+        { return mat_view<const T>(m_mat, i, j, n, m, di, dj); }
+
+        inline operator mat_view<T>() /* NOLINT */
+        { return view(0, 0, m_row, m_column); }
+        inline operator mat_view<const T>() const /* NOLINT */
+        { return view(0, 0, m_row, m_column); }
+
+        /**
+         * Get the contiguous elements of the ith row.
+         */
+        inline std::span<T> row(int i)
+        { return std::span<T>(m_mat[i], m_column); }
+        inline std::span<const T> row(int i) const
+        { return std::span<const T>(m_mat[i], m_column); }
+
+        /**
+         * Get a non-owning view over the jth column.
+         */
+        inline mat_view<T> column(int j)
+        { return view(0, j, m_row, 1); }
+        inline mat_view<const T> column(int j) const
+        { return view(0, j, m_row, 1); }
         
         virtual int n() const noexcept(true) final;
         virtual int m() const noexcept(true) final;
@@ -78,6 +195,16 @@ namespace code3c
         virtual explicit operator T() const;
     };
     
+    template < typename T >
+    mat<std::remove_const_t<T>> mat_view<T>::copy() const
+    {
+        mat<std::remove_const_t<T>> mat1(m_row, m_column);
+        for (int i(0); i < m_row; i++)
+            for (int j(0); j < m_column; j++)
+                mat1[i, j] = operator[](i, j);
+        return mat1;
+    }
+
     template < typename T >
     mat<T> operator *(T val, const mat<T>& mat1)
     {
@@ -90,31 +217,201 @@ namespace code3c
         return mat1 / val;
     }
     
+    template < typename T, int N, int M >
+    /**
+     * Fixed-size matrix, allocated on the stack and usable in constant expressions.
+     * Dimensions are known at compile-time, so every loop has a constant trip count
+     * and is fully unrolled by the compiler (no allocation, no virtual dispatch).
+     * Intended for the small constant matrices of the library (Hamming G/H matrices,
+     * identity matrices...). Converts to a <code>mat&lt;T&gt;</code> when required.
+     *
+     * @tparam T type of data contains in the matrix
+     * @tparam N number of rows
+     * @tparam M number of columns
+     */
+    class fixed_mat
+    {
+        static_assert(N > 0 && M > 0, "Invalid fixed_mat dimension");
+
+        T m_mat[N][M] {};
+
+        static constexpr T add(T a, T b)
+        {
+            if constexpr (std::is_same_v<T, bool>) return a != b;
+            else return a + b;
+        }
+
+        static constexpr T sub(T a, T b)
+        {
+            if constexpr (std::is_same_v<T, bool>) return a != b;
+            else return a - b;
+        }
+
+        static constexpr T mul(T a, T b)
+        {
+            if constexpr (std::is_same_v<T, bool>) return a && b;
+            else return a * b;
+        }
+    public:
+        constexpr fixed_mat() = default;
+        constexpr fixed_mat(const T (&table)[N][M])
+        {
+            for (int i(0); i < N; i++)
+                for (int j(0); j < M; j++)
+                    m_mat[i][j] = table[i][j];
+        }
+        explicit fixed_mat(const mat<T>& mat1) noexcept(false)
+        {
+            if (mat1.n() != N || mat1.m() != M)
+                throw std::runtime_error("Invalid matrix dimension");
+            for (int i(0); i < N; i++)
+                for (int j(0); j < M; j++)
+                    m_mat[i][j] = mat1[i, j];
+        }
+
+        static constexpr int n() noexcept(true) { return N; }
+        static constexpr int m() noexcept(true) { return M; }
+
+        static constexpr fixed_mat<T, N, M> identity()
+        {
+            static_assert(N == M, "Identity matrix requires square dimension");
+            fixed_mat<T, N, M> _identity;
+            for (int i(0); i < N; i++)
+                _identity.m_mat[i][i] = (T) 1;
+            return _identity;
+        }
+
+        constexpr fixed_mat<T, M, N> transposed() const
+        {
+            fixed_mat<T, M, N> tr;
+            for (int i(0); i < N; i++)
+                for (int j(0); j < M; j++)
+                    tr[j, i] = m_mat[i][j];
+            return tr;
+        }
+
+        constexpr bool operator ==(const fixed_mat<T, N, M>& mat1) const
+        {
+            for (int i(0); i < N; i++)
+                for (int j(0); j < M; j++)
+                    if (m_mat[i][j] != mat1.m_mat[i][j])
+                        return false;
+            return true;
+        }
+
+        constexpr bool operator !=(const fixed_mat<T, N, M>& mat1) const
+        {
+            return !operator==(mat1);
+        }
+
+        constexpr fixed_mat<T, N, M> operator +(const fixed_mat<T, N, M>& mat1) const
+        {
+            fixed_mat<T, N, M> mat2;
+            for (int i(0); i < N; i++)
+                for (int j(0); j < M; j++)
+                    mat2.m_mat[i][j] = add(m_mat[i][j], mat1.m_mat[i][j]);
+            return mat2;
+        }
+
+        constexpr fixed_mat<T, N, M> operator -(const fixed_mat<T, N, M>& mat1) const
+        {
+            fixed_mat<T, N, M> mat2;
+            for (int i(0); i < N; i++)
+                for (int j(0); j < M; j++)
+                    mat2.m_mat[i][j] = sub(m_mat[i][j], mat1.m_mat[i][j]);
+            return mat2;
+        }
+
+        constexpr fixed_mat<T, N, M> operator *(T val) const
+        {
+            fixed_mat<T, N, M> mat1;
+            for (int i(0); i < N; i++)
+                for (int j(0); j < M; j++)
+                    mat1.m_mat[i][j] = mul(m_mat[i][j], val);
+            return mat1;
+        }
+
+        template < int K >
+        constexpr fixed_mat<T, N, K> operator *(const fixed_mat<T, M, K>& mat1) const
+        {
+            fixed_mat<T, N, K> mat2;
+            for (int i(0); i < N; i++)
+            {
+                for (int j(0); j < K; j++)
+                {
+                    T _sum((T) 0);
+                    for (int k(0); k < M; k++)
+                        _sum = add(_sum, mul(m_mat[i][k], mat1[k, j]));
+                    mat2[i, j] = _sum;
+                }
+            }
+            return mat2;
+        }
+
+        /**
+         * Multiply by a dynamic matrix (e.g. a Hamming word vector).
+         * @return the dynamic result matrix (N x mat1.m())
+         */
+        mat<T> operator *(const mat<T>& mat1) const noexcept(false)
+        {
+            if (mat1.n() != M)
+                throw std::runtime_error("Invalid dimension for matrix multiplication");
+
+            mat<T> mat2(N, mat1.m());
+            for (int i(0); i < N; i++)
+            {
+                for (int j(0); j < mat1.m(); j++)
+                {
+                    T _sum((T) 0);
+                    for (int k(0); k < M; k++)
+                        _sum = add(_sum, mul(m_mat[i][k], mat1[k, j]));
+                    mat2[i, j] = _sum;
+                }
+            }
+            return mat2;
+        }
+
+        constexpr T& operator[](int i, int j) { return m_mat[i][j]; }
+        constexpr T operator[](int i, int j) const { return m_mat[i][j]; }
+
+        /**
+         * Build the equivalent dynamic (heap-allocated) matrix.
+         */
+        operator mat<T>() const /* NOLINT */
+        {
+            mat<T> mat1(N, M);
+            for (int i(0); i < N; i++)
+                for (int j(0); j < M; j++)
+                    mat1[i, j] = m_mat[i][j];
+            return mat1;
+        }
+    };
+
     template < typename T >
     mat<T> matIn(int n)
     {
-        mat<T> matrix(0);
+        mat<T> matrix(n);
         for (int i(0); i < n; i++)
             matrix[i, i] = (T) 1;
         return matrix;
     }
     
     template < typename T >
-    inline mat<T> matI2()
+    constexpr fixed_mat<T, 2, 2> matI2()
     {
-        return matIn<T>(2);
+        return fixed_mat<T, 2, 2>::identity();
     }
     
     template < typename T >
-    inline mat<T> matI3()
+    constexpr fixed_mat<T, 3, 3> matI3()
     {
-        return matIn<T>(3);
+        return fixed_mat<T, 3, 3>::identity();
     }
     
     template < typename T >
-    inline mat<T> matI4()
+    constexpr fixed_mat<T, 4, 4> matI4()
     {
-        return matIn<T>(4);
+        return fixed_mat<T, 4, 4>::identity();
     }
 
     template < typename T >
@@ -0,0 +1,158 @@
+/*
+ * 3C-CODE Library
+ * Copyright (C) 2023 - Rin "madeshiro" Baudelet
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with this
+ * program. If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef HH_LIB_DISPLAYLIST
+#define HH_LIB_DISPLAYLIST
+#include "drawer.hh"
+#include "assetcache.hh"
+#include <cstdint>
+#include <span>
+#include <string>
+#include <vector>
+
+#define CODE3C_ASSET_LOGO    1 /*< AssetCache variant of the circle-clipped logo */
+#define CODE3C_ASSET_ALIASED 2 /*< AssetCache variant of the snapped image (flag) */
+#define CODE3C_ASSET_WHOLE   (1 << 20) /*< largest image (pixels) resized whole and cached */
+#define CODE3C_ASSET_PALETTE 240 /*< most colours of an image snapped to its palette */
+
+namespace code3c
+{
+    /**
+     * Backend-independent list of drawing primitives, laid out once in a
+     * <code>width()</code> x <code>height()</code> reference space and
+     * replayed on any Drawer at any scale. Images are referenced by file and
+     * decoded at the replay size through the process-wide AssetCache.
+     */
+    class DisplayList
+    {
+    public:
+        enum Kind
+        {
+            DL_BACKGROUND, /*< clear with color                               */
+            DL_SLICES,     /*< color, slices [first, first+count)             */
+            DL_CIRCLE,     /*< color, filled disc args = {x, y, radius}       */
+            DL_LINE,       /*< color, args = {x1, y1, x2, y2}                 */
+            DL_BLIT        /*< image first, args = {x, y, width, height}      */
+        };
+
+        struct command
+        {
+            Kind kind;
+            unsigned long color;
+            int args[4];
+            uint32_t first, count;
+        };
+
+        struct image
+        {
+            std::string path;
+            bool circular; /*< transparent outside the inscribed disc */
+        };
+
+    private:
+        int m_width, m_height;
+        std::vector<command> m_commands;
+        std::vector<Slice> m_slices;
+        std::vector<image> m_images;
+
+    public:
+        DisplayList(int width, int height);
+
+        inline int width() const
+        { return m_width; }
+        inline int height() const
+        { return m_height; }
+
+        inline std::span<const command> commands() const
+        { return m_commands; }
+        inline std::span<const Slice> slices() const
+        { return m_slices; }
+        inline std::span<const image> images() const
+        { return m_images; }
+
+        // #### Recording #### //
+
+        void background(unsigned long color);
+        void slices(unsigned long color, std::span<const Slice> slices);
+        void circle(unsigned long color, int x, int y, int radius);
+        void line(unsigned long color, int x1, int y1, int x2, int y2);
+        /**
+         * @param fname the PNG file, resized to <code>width</code> x
+         * <code>height</code> when replayed
+         * @param circular clip the image to its inscribed disc
+         */
+        void blit(const char* fname, bool circular, int x, int y, int width, int height);
+
+        /**
+         * Record the primitives of another list, translated by (x, y). Its
+         * backgrounds are left out: the background of this list shows
+         * through.
+         */
+        void append(const DisplayList& list, int x, int y);
+
+        // #### Replay #### //
+
+        /**
+         * Decode an image of the list at the specified size, through the
+         * process-wide AssetCache (clipped to its disc if circular).
+         *
+         * An aliased image, for the frames whose edges aren't blended, is
+         * snapped after resizing: pixels are either opaque or transparent
+         * (alpha threshold at 0x80), and their colour is the nearest one of
+         * imagePalette() if not empty. The frame colours then stay known,
+         * which keeps indexed PNG files possible.
+         *
+         * @param index the image index (see images())
+         * @param aliased snap the resized image
+         * @throw std::runtime_error if the image can't be decoded
+         */
+        AssetCache::asset loadImage(size_t index, int width, int height,
+                                    bool aliased = false) const;
+
+        /**
+         * Same as loadImage(), resized lazily: only the source image is
+         * decoded (and cached), the windows of the resized image being
+         * computed on demand. Images up to CODE3C_ASSET_WHOLE pixels are
+         * resized whole through loadImage() instead, once for every code
+         * drawn at that size.
+         * @throw std::runtime_error if the image can't be decoded
+         */
+        Resampler sampleImage(size_t index, int width, int height,
+                              bool aliased = false) const;
+
+        /**
+         * Colours of an image once aliased (see loadImage()): the opaque
+         * colours of its source (every colour if circular), as packed RGBA8.
+         * @return the colours, empty if more than CODE3C_ASSET_PALETTE
+         * @throw std::runtime_error if the image can't be decoded
+         */
+        std::vector<uint32_t> imagePalette(size_t index) const;
+
+        /**
+         * Replay the primitives, scaled to fit the drawer dimension.
+         */
+        void replay(Drawer& drawer) const;
+
+        /**
+         * Replay the primitives, every coordinate and length being multiplied
+         * by <code>scale</code> (angles are kept).
+         * @throw std::runtime_error if an image can't be decoded
+         */
+        void replay(Drawer& drawer, double scale) const;
+    };
+}
+
+#endif //HH_LIB_DISPLAYLIST
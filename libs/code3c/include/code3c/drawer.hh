@@ -22,6 +22,12 @@
 #include <cstdint>
 #include <png.h>
 #include <map>
+#include <string>
+#include <vector>
+
+#define CODE3C_FRAME_STATS 256 // Number of frames in Drawer::frameStats()
+#define CODE3C_X11_ARCS    1024 // Arcs per XFillArcs request
+#define CODE3C_SVG_TRACED  16   // Most colours of a pixel map outlined in SVG
 
 #ifdef CODE3C_UNIX
 #include <X11/X.h>
@@ -82,6 +88,34 @@ namespace code3c
         bool button1Pressed;
         bool button2Pressed;
     };
+
+    /**
+     * Distribution of the recent frame times (see Drawer::frameStats()).
+     */
+    struct FrameStats
+    {
+        unsigned long frames; /*< frames measured since run() started */
+        double min, avg, p99; /*< milliseconds, over the last frames   */
+    };
+
+    /**
+     * Pie slice, with the parameters of Drawer::draw_slice().
+     */
+    struct Slice
+    {
+        int x, y;
+        int radius;
+        int degree, rotation;
+    };
+
+    /**
+     * Rectangular area of a drawer, in pixels.
+     */
+    struct Rect
+    {
+        int x, y;
+        int width, height;
+    };
     
     class Drawer /* abstract */
     {
@@ -92,6 +126,17 @@ namespace code3c
         
         // FPS management
         unsigned long m_fps = 30;
+
+        // Retained mode: the frame is drawn once and kept until invalidated
+        bool m_retained = false;
+        bool m_valid = false;
+
+        // Frame times (ms), ring buffer of the last CODE3C_FRAME_STATS frames
+        std::vector<double> m_frameTimes;
+        unsigned long m_frames = 0;
+
+        void record_frame(double millis);
+        void reset_frame_stats();
     
         // Event variables
         char key;
@@ -131,8 +176,33 @@ namespace code3c
         virtual void setHeigh(int height) = 0;
         virtual void setWidth(int width) = 0;
         virtual void setFrameRate(int fps);
+
+        /**
+         * In retained mode, <code>draw()</code> is called once and the frame is
+         * kept in the back buffer: the window is only refreshed from it (e.g.
+         * when exposed or resized), until <code>invalidate()</code> is called.
+         * Per default, <code>draw()</code> is called on every frame.
+         *
+         * @param retained true to draw the frame only once
+         */
+        void setRetained(bool retained);
+        bool retained() const;
+
+        /**
+         * Request a new <code>draw()</code> in retained mode (the drawn content
+         * changed).
+         */
+        void invalidate();
         
         virtual unsigned long frameRate() const = 0;
+
+        /**
+         * Frame time distribution: the time between two frames drawn in a row,
+         * over the last CODE3C_FRAME_STATS frames (retained frames aren't
+         * measured).
+         * @return the frame statistics, zeroed if no frame was measured
+         */
+        FrameStats frameStats() const;
         
         virtual void setup() = 0;
         virtual void run() = 0;
@@ -155,6 +225,14 @@ namespace code3c
          * @param name
          */
         virtual void savePNG(const char *name) const = 0;
+
+        /**
+         * Colours this drawer is expected to produce, used as the preferred
+         * palette when saving indexed PNG files.
+         *
+         * @return packed RGBA8 colours (see rgba8()), empty by default
+         */
+        virtual std::vector<uint32_t> palette() const;
         
         /* Draw functions */
         virtual void foreground(unsigned long color) = 0;
@@ -166,14 +244,231 @@ namespace code3c
         virtual void draw_slice(int origin_x, int origin_y, int radius, int degree,
                                 int rotation) = 0;
 
+        /**
+         * Fill several slices of the same colour, in order. The default
+         * implementation calls <code>draw_slice()</code> for each of them,
+         * backends override it to submit the slices in batches.
+         *
+         * @param color the slices colour (also left as the foreground colour)
+         * @param slices the slices to draw
+         */
+        virtual void fill_slices(unsigned long color, std::span<const Slice> slices);
+
         virtual void fill_circle(int x, int y, int radius) = 0;
         virtual void draw_line(int x1, int y1, int x2, int y2) = 0;
 
-        virtual void draw_pixelmap(const PixelMap& pixelMap, int x, int y);
+        /**
+         * Copy a pixel map onto the drawer, restricted to the clip area.
+         * Pixels with alpha below 0x80 are left out (the transparency of the
+         * marker and the circular logo clip). The default implementation goes
+         * through draw_pixel(), backends override it with a bulk transfer.
+         *
+         * @param pixelMap the image to copy
+         * @param x the destination of the left column
+         * @param y the destination of the top row
+         * @param clip the drawer area that may be modified
+         */
+        virtual void blit(const PixelMap& pixelMap, int x, int y, const Rect& clip);
+
+        /**
+         * @return true if the edges are blended (see
+         * RasterDrawer::setAntialiased()), false by default
+         */
+        virtual bool antialiased() const;
+
+        inline void draw_pixelmap(const PixelMap& pixelMap, int x, int y)
+        { blit(pixelMap, x, y, {0, 0, m_width, m_height}); }
 
         virtual uint64_t hash() const;
     };
 
+    /**
+     * Off-screen drawer rendering into a PixelMap, with no window system.
+     * <code>run()</code> renders a single frame (setup then draw), which can
+     * then be saved or encoded as PNG.
+     */
+    class RasterDrawer : public Drawer
+    {
+        PixelMap m_frame;
+        uint32_t m_foreground;
+
+        bool m_antialiased;
+        std::vector<float> m_coverage;   /*< partial coverage of the batch  */
+        std::vector<float> m_line;       /*< coverage of the current row    */
+        std::vector<uint32_t> m_touched; /*< pixels with a partial coverage */
+
+        void fill_span(int y, int x0, int x1);
+        void cover_slice(const Slice& slice);
+        void flush_coverage();
+    public:
+        RasterDrawer(int width, int height, const mat8_t& data);
+        RasterDrawer(const RasterDrawer& rasterDrawer);
+        ~RasterDrawer() noexcept override = default;
+
+        void show(bool b) override;
+        void setTitle(const char *) override;
+        void setHeigh(int height) override;
+        void setWidth(int width) override;
+
+        void run() override;
+        void exit() override;
+        void clear() override;
+
+        unsigned long frameRate() const override;
+
+        void setup() override = 0;
+        void draw() override = 0;
+
+        void savePNG(const char *name) const override;
+
+        /**
+         * Encode the current frame as PNG, using the drawer palette.
+         * @return the png file content
+         */
+        std::vector<uint8_t> encodePNG() const;
+
+        /**
+         * Encode the current frame in the specified format (the drawer
+         * palette is used for PNG).
+         * @return the file content
+         */
+        std::vector<uint8_t> encode(PixelMap::Format format) const;
+
+        /**
+         * @return the frame buffer
+         */
+        inline const PixelMap& frame() const
+        { return m_frame; }
+
+        /**
+         * Enable anti-aliased slices and circles: the coverage of every pixel
+         * is computed analytically from its distance to the centre and to the
+         * slice edges, and the colour blended accordingly. Slices of a same
+         * <code>fill_slices()</code> batch add up, adjacent cells of a colour
+         * leave no seam. Disabled by default (one colour per pixel).
+         */
+        void setAntialiased(bool antialiased);
+        inline bool antialiased() const override
+        { return m_antialiased; }
+
+        /**
+         * Coverage, in [0, 1], of the pixels [x0, x0 + n) of row y by an
+         * anti-aliased slice (see setAntialiased()).
+         *
+         * @param out the n coverage values
+         * @param vectorized use the AVX2 kernel when the processor has it,
+         * the scalar one otherwise
+         * @return true if the AVX2 kernel was used
+         */
+        static bool coverage(const Slice& slice, int y, int x0, int n, float* out,
+                             bool vectorized = true);
+
+        /* draw functions */
+
+        void background(unsigned long color) override;
+        void foreground(unsigned long color) override;
+
+        void draw_pixel(unsigned long color, int x, int y) override;
+        /**
+         * Not supported: no font is available off-screen.
+         * @throw std::runtime_error always
+         */
+        void draw_text(const char *str, int x, int y) override;
+        void draw_slice(
+                int origin_x, int origin_y, int radius, int degree,
+                int rotation
+        ) override;
+        void fill_slices(unsigned long color, std::span<const Slice> slices) override;
+        void fill_circle(int x, int y, int radius) override;
+        void draw_line(int x1, int y1, int x2, int y2) override;
+        /**
+         * Draw the pixel map with alpha blending over the frame.
+         */
+        void blit(const PixelMap& pixelMap, int x, int y, const Rect& clip) override;
+    };
+
+    /**
+     * Vector drawer producing an SVG document. Slices are buffered and
+     * contiguous slices of the same colour and radius are merged in a single
+     * path; pixel maps are embedded as PNG data URIs.
+     */
+    class SVGDrawer : public Drawer
+    {
+        struct slice
+        {
+            int x, y, radius;
+            int start, degree; /*< counter-clockwise, from 3 o'clock */
+            unsigned long color;
+        };
+
+        struct image
+        {
+            int width, height;
+            uint64_t hash;  /*< of the pixels                   */
+            int x, y;       /*< position of the embedded image  */
+        };
+
+        std::string m_body;
+        std::vector<slice> m_slices; /*< pending slices, see flush_slices() */
+        std::vector<image> m_images; /*< embedded, referenced by index  */
+        unsigned long m_foreground;
+
+        void flush_slices();
+        void write_slices(std::string& out) const;
+    public:
+        SVGDrawer(int width, int height, const mat8_t& data);
+        SVGDrawer(const SVGDrawer& svgDrawer);
+        ~SVGDrawer() noexcept override = default;
+
+        void show(bool b) override;
+        void setTitle(const char *) override;
+        void setHeigh(int height) override;
+        void setWidth(int width) override;
+
+        void run() override;
+        void exit() override;
+        void clear() override;
+
+        unsigned long frameRate() const override;
+
+        void setup() override = 0;
+        void draw() override = 0;
+
+        /**
+         * Not supported, see <code>saveSVG()</code>.
+         * @throw std::runtime_error always
+         */
+        void savePNG(const char *name) const override;
+
+        /**
+         * @return the SVG document of everything drawn so far
+         */
+        std::string svg() const;
+        void saveSVG(const char *name) const;
+
+        /* draw functions */
+
+        void background(unsigned long color) override;
+        void foreground(unsigned long color) override;
+
+        void draw_pixel(unsigned long color, int x, int y) override;
+        void draw_text(const char *str, int x, int y) override;
+        void draw_slice(
+                int origin_x, int origin_y, int radius, int degree,
+                int rotation
+        ) override;
+        void fill_circle(int x, int y, int radius) override;
+        void draw_line(int x1, int y1, int x2, int y2) override;
+        /**
+         * Outline the visible part of the pixel map as paths when it is
+         * opaque or transparent with at most CODE3C_SVG_TRACED colours (e.g.
+         * the marker), otherwise embed it as a PNG data URI. A pixel map drawn
+         * whole again (e.g. the marker of every code of a sheet) is written
+         * once and referenced.
+         */
+        void blit(const PixelMap& pixelMap, int x, int y, const Rect& clip) override;
+    };
+
 #ifdef CODE3C_UNIX
     class X11Drawer : public Drawer
     {
@@ -193,9 +488,9 @@ namespace code3c
         Atom wmDeleteWindow;
         KeySym keySym;
         unsigned int keyMod;
-        unsigned long m_frameRate;
 
         void key_binding(bool _register);
+        void process_event(XEvent& event, bool& done, bool& exposed);
 
     public:
         X11Drawer(int width, int height, const mat8_t&data);
@@ -218,6 +513,14 @@ namespace code3c
         void draw() override = 0;
         
         void savePNG(const char *name) const override;
+
+        /**
+         * Read the double buffer back from the X server as a ZPixmap image
+         * (through MIT-SHM when available) and convert it in one pass.
+         * @return the current frame
+         * @throw std::runtime_error if the image can't be read
+         */
+        PixelMap capture() const;
         
         /* draw functions */
         
@@ -230,8 +533,17 @@ namespace code3c
                 int origin_x, int origin_y, int radius, int degree,
                 int rotation
         ) override;
+        /**
+         * One XFillArcs request per CODE3C_X11_ARCS slices.
+         */
+        void fill_slices(unsigned long color, std::span<const Slice> slices) override;
         void fill_circle(int x, int y, int radius) override;
         void draw_line(int x1, int y1, int x2, int y2) override;
+        /**
+         * Single XPutImage, transparent pixels being masked out by a clip
+         * bitmap built from the alpha channel.
+         */
+        void blit(const PixelMap& pixelMap, int x, int y, const Rect& clip) override;
     };
 
     typedef X11Drawer SimpleDrawer;
@@ -16,6 +16,7 @@
  */
 #ifndef HH_LIB_HAMMING743
 #define HH_LIB_HAMMING743
+#include <array>
 #include "bitmat.hh"
 
 namespace code3c
@@ -164,6 +165,14 @@ namespace code3c
 
         virtual Hamming* copy() const = 0;
 
+        /**
+         * Encode a message word (<code>G*x</code>). Per default, computed from
+         * the dynamic G matrix.
+         * @param x the message, on its dim_k() lowest bits
+         * @return the codeword, on its dim_n() lowest bits
+         */
+        virtual hword::hword_t codeword(hword::hword_t x) const;
+
         /**
          *
          * @param xbuf
@@ -188,18 +197,59 @@ namespace code3c
         { return m_hwordsl; }
     };
 
+    /**
+     * Build the codeword <code>G*x</code> of every message word x at
+     * compile-time, bits being ordered as by hword::wtom() and hword::mtow().
+     */
+    template < int N, int K >
+    constexpr std::array<char, (1 << K)> codewords(const fixed_mat<bool, N, K>& G)
+    {
+        std::array<char, (1 << K)> table {};
+        for (int x(0); x < (1 << K); x++)
+        {
+            fixed_mat<bool, K, 1> xmat;
+            for (int i(0); i < K; i++)
+                xmat[i, 0] = (x >> (K-1-i)) & 1;
+
+            fixed_mat<bool, N, 1> cmat(G * xmat);
+            for (int i(0); i < N; i++)
+                table[x] = (char) (table[x] | (cmat[i, 0] << (N-1-i)));
+        }
+        return table;
+    }
+
     /**
      * 14% redundancy
      */
     class Hamming743 : public Hamming
     {
     public:
+        static constexpr fixed_mat<bool, 7, 4> G743 {{ /* NOLINT */
+            {1, 1, 0, 1},
+            {1, 0, 1, 1},
+            {1, 0, 0, 0},
+            {0, 1, 1, 1},
+            {0, 1, 0, 0},
+            {0, 0, 1, 0},
+            {0, 0, 0, 1}
+        }};
+        static constexpr fixed_mat<bool, 3, 7> H743 {{ /* NOLINT */
+            {0, 0, 0, 1, 1, 1, 1},
+            {0, 1, 1, 0, 0, 1, 1},
+            {1, 0, 1, 0, 1, 0, 1}
+        }};
+
+        static constexpr std::array<char, 16> C743 = codewords(G743);
+
         static const matbase2& G_();
         static const matbase2& H_();
 
         const matbase2& G() const override;
         const matbase2& H() const override;
 
+        inline hword::hword_t codeword(hword::hword_t x) const override
+        { return C743[x & 0xf]; }
+
         Hamming743() = default;
         Hamming743(const Hamming743& hamm) = default;
 
@@ -213,12 +263,27 @@ namespace code3c
     class Hamming313 : public Hamming
     {
     public:
+        static constexpr fixed_mat<bool, 3, 1> G313 {{ /* NOLINT */
+            {1},
+            {1},
+            {1}
+        }};
+        static constexpr fixed_mat<bool, 2, 3> H313 {{ /* NOLINT */
+            {0, 1, 1},
+            {1, 0, 1}
+        }};
+
+        static constexpr std::array<char, 2> C313 = codewords(G313);
+
         static const matbase2& G_();
         static const matbase2& H_();
 
         const matbase2& G() const override;
         const matbase2& H() const override;
 
+        inline hword::hword_t codeword(hword::hword_t x) const override
+        { return C313[x & 0x1]; }
+
         Hamming313() = default;
         Hamming313(const Hamming313& hamm) = default;
 
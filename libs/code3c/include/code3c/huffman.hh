@@ -490,13 +490,14 @@ namespace code3c
         return buf;
     }
 
-    static HuffmanTable* code3c_default_htf[5] {
-        nullptr,
-        HTFile::fromFile(C3CRC("en_EN.htf")),
-        HTFile::fromFile(C3CRC("fr_FR.htf")),
-        nullptr,
-        nullptr
-    };
+    /**
+     * Get the default huffman table of a compression model, the tables being
+     * loaded once, on first use.
+     *
+     * @param huffmodel the compression model (CODE3C_HUFFMAN_*)
+     * @return the huffman table, or nullptr if the model doesn't compress
+     */
+    HuffmanTable* code3c_default_htf(unsigned huffmodel);
 }
 
 #endif //HH_LIB_HUFFMAN_3CCODE
@@ -0,0 +1,137 @@
+/*
+ * 3C-CODE Library
+ * Copyright (C) 2023 - Rin "madeshiro" Baudelet
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with this
+ * program. If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef HH_LIB_PARALLEL
+#define HH_LIB_PARALLEL
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace code3c
+{
+    /**
+     * Get the number of worker threads used by the library.
+     * @return the number of hardware threads (at least 1)
+     */
+    unsigned parallel_workers();
+
+    /**
+     * Split the range [begin, end) into contiguous bands of at least
+     * <code>grain</code> items and run <code>fn(band_begin, band_end)</code> on
+     * each band, in parallel on the WorkPool::instance() threads. The calling
+     * thread takes part in the work and the function returns once every band
+     * is done. Small ranges run in place.
+     *
+     * @param begin first index of the range
+     * @param end end index of the range (excluded)
+     * @param grain minimal number of items per band
+     * @param fn the function to run on each band
+     */
+    void parallel_for(int begin, int end, int grain,
+                      const std::function<void(int, int)>& fn);
+
+    /**
+     * Persistent work-stealing thread pool. A batch of <code>count</code>
+     * tasks is spread over per-worker queues; a worker runs its own queue
+     * from the front and, once empty, steals from the back of the others, so
+     * uneven tasks (uniform and detailed image tiles) keep every thread
+     * busy. The thread waiting for a batch runs tasks too.
+     */
+    class WorkPool
+    {
+    public:
+        typedef std::function<void(int)> Task;
+
+    private:
+        struct batch_state
+        {
+            Task task;
+            std::atomic<int> remaining;
+            std::mutex mutex;
+            std::condition_variable done;
+            std::exception_ptr error;
+        };
+
+        struct item
+        {
+            std::shared_ptr<batch_state> batch;
+            int index;
+        };
+
+        struct queue
+        {
+            std::mutex mutex;
+            std::deque<item> items;
+        };
+
+        std::vector<std::unique_ptr<queue>> m_queues;
+        std::vector<std::thread> m_threads;
+        std::mutex m_mutex;
+        std::condition_variable m_wake;
+        std::atomic<long> m_pending;
+        bool m_stop;
+
+        bool pop(size_t q, item& it);
+        bool steal(size_t q, item& it);
+        void execute(item& it);
+        void work(size_t q);
+    public:
+        /** Handle of a submitted batch */
+        typedef std::shared_ptr<batch_state> Batch;
+
+        /**
+         * @param threads the number of worker threads (0: tasks only run in
+         * wait())
+         */
+        explicit WorkPool(unsigned threads);
+        WorkPool(const WorkPool&) = delete;
+        ~WorkPool();
+
+        /**
+         * @return the pool shared by the library, with
+         * <code>parallel_workers() - 1</code> threads
+         */
+        static WorkPool& instance();
+
+        /**
+         * Queue the tasks <code>task(0)</code> ... <code>task(count-1)</code>,
+         * which start at once on the worker threads.
+         * @return the batch, to be waited for
+         */
+        Batch submit(int count, Task task);
+
+        /**
+         * Wait for every task of the batch, running queued tasks meanwhile (so
+         * a task may wait for a nested batch).
+         * @throw the first exception thrown by a task of the batch
+         */
+        void wait(const Batch& batch);
+
+        /**
+         * Submit the tasks and wait for them.
+         */
+        inline void run(int count, Task task)
+        { wait(submit(count, std::move(task))); }
+    };
+}
+
+#endif //HH_LIB_PARALLEL
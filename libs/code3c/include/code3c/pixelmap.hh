@@ -43,61 +43,450 @@ extern "C" {
         FILE* _file;
     };
     
+    /**
+     * Compression settings applied when writing a PNG file. A negative value
+     * (or 0 for <code>filters</code>) keeps the libpng default.
+     */
+    typedef struct PNG_WRITE_OPTIONS png_write_opts;
+    struct PNG_WRITE_OPTIONS
+    {
+        int compression_level; /*< zlib compression level (0-9)           */
+        int filters;           /*< PNG_FILTER_* mask (e.g. PNG_FILTER_NONE) */
+        int strategy;          /*< zlib strategy (e.g. Z_RLE = 3)           */
+    };
+#define PNG_WRITE_OPTS_DEFAULT {-1, 0, -1}
+
+    /**
+     * Custom png I/O, replacing the FILE* stream of a descriptor (see
+     * png_set_read_fn() and png_set_write_fn()). Callbacks report errors with
+     * png_error().
+     */
+    typedef struct PNG_IO png_io;
+    struct PNG_IO
+    {
+        void* user;          /*< png_get_io_ptr() value          */
+        png_rw_ptr rw;       /*< read or write callback          */
+        png_flush_ptr flush; /*< flush callback (write only)     */
+    };
+
+    /**
+     * Produce the row <code>y</code> of an image being written. The producer
+     * either fills <code>row</code> (one reusable buffer of the png row size)
+     * or returns its own row data.
+     *
+     * @return the row to write, or NULL to abort the writing
+     */
+    typedef png_const_bytep (*png_row_producer)(int y, png_bytep row, void* user);
+
     png_descp open_png(FILE* pngfile);
+    /**
+     * Read a whole png image as 8-bit RGBA. Row pointers and pixels are kept in
+     * one contiguous block (desc->rows), released with free_png_desc().
+     */
     png_descp read_png(FILE* fin);
+    /**
+     * Read the png header and setup the RGBA8 transformations, without reading
+     * the image (see read_png_image()).
+     */
+    png_descp read_png_info(FILE* fin);
+    /**
+     * Same as read_png_info(), reading through <code>io</code> when not NULL.
+     */
+    png_descp read_png_info_io(FILE* fin, const png_io* io);
+    /**
+     * Read the image of a descriptor opened with read_png_info() as 8-bit RGBA.
+     * @param dest the destination buffer, <code>height * stride</code> bytes
+     * @param stride the distance in bytes between two rows
+     * @return 0 on success, -1 on error
+     */
+    int read_png_image(png_descp desc, png_bytep dest, size_t stride);
     png_descp create_png(FILE* fio, int width, int height);
+    /**
+     * Create a 8-bit RGBA png file descriptor.
+     * @param opts the compression settings (NULL for default)
+     */
+    png_descp create_png_rgba(FILE* fio, int width, int height,
+                              const png_write_opts* opts);
+    /**
+     * Same as create_png_rgba(), writing through <code>io</code> when not NULL.
+     */
+    png_descp create_png_rgba_io(FILE* fio, const png_io* io, int width, int height,
+                                 const png_write_opts* opts);
+    /**
+     * Create a palette-indexed png file descriptor.
+     * @param bit_depth bits per pixel (1, 2, 4 or 8)
+     * @param palette the palette colours
+     * @param alpha the palette alpha values (NULL if fully opaque)
+     * @param npalette number of palette entries (up to 2^bit_depth)
+     * @param opts the compression settings (NULL for default)
+     */
+    png_descp create_png_indexed(FILE* fio, int width, int height, int bit_depth,
+                                 const png_color* palette, const png_byte* alpha,
+                                 int npalette, const png_write_opts* opts);
+    /**
+     * Same as create_png_indexed(), writing through <code>io</code> when not NULL.
+     */
+    png_descp create_png_indexed_io(FILE* fio, const png_io* io, int width,
+                                    int height, int bit_depth,
+                                    const png_color* palette, const png_byte* alpha,
+                                    int npalette, const png_write_opts* opts);
+    /**
+     * Write the image of a descriptor row by row from a single reusable row
+     * buffer, then end the png file.
+     * @return 0 on success, -1 on error or if the producer aborted
+     */
+    int write_png_rows(png_descp desc, png_row_producer producer, void* user);
     void free_png_desc(png_descp desc);
 #ifdef __cplusplus
 }
 #endif // __cplusplus
 
 #ifdef __cplusplus
+#include <bit>
+#include <functional>
+#include <memory>
+#include <vector>
+#include <span>
+
 namespace code3c
 {
+    /**
+     * Compatibility view of a single pixel. PixelMap doesn't store Pixel anymore
+     * (see PixelMap), the structure is built on the fly by the accessors.
+     */
     struct Pixel
     {
         int x, y;
         unsigned long color;
         unsigned char alpha;
     };
-    
+
+    /**
+     * Pack a RGB colour (0xRRGGBB) and an alpha value into a RGBA8 pixel. The
+     * packed pixel is laid out in memory as R, G, B, A bytes, which is the
+     * libpng RGBA row format.
+     * @param color the RGB colour (0xRRGGBB)
+     * @param alpha the alpha value (0xff = opaque)
+     * @return the packed pixel
+     */
+    constexpr uint32_t rgba8(unsigned long color, unsigned char alpha = 0xff)
+    {
+        uint32_t r((color >> 16) & 0xff), g((color >> 8) & 0xff), b(color & 0xff);
+        if constexpr (std::endian::native == std::endian::little)
+            return r | (g << 8) | (b << 16) | ((uint32_t) alpha << 24);
+        else
+            return (r << 24) | (g << 16) | (b << 8) | alpha;
+    }
+
+    /**
+     * @return the RGB colour (0xRRGGBB) of a packed RGBA8 pixel
+     */
+    constexpr unsigned long rgba8_color(uint32_t px)
+    {
+        if constexpr (std::endian::native == std::endian::little)
+            return ((px & 0xff) << 16) | (px & 0xff00) | ((px >> 16) & 0xff);
+        else
+            return px >> 8;
+    }
+
+    /**
+     * @return the alpha value of a packed RGBA8 pixel
+     */
+    constexpr unsigned char rgba8_alpha(uint32_t px)
+    {
+        if constexpr (std::endian::native == std::endian::little)
+            return px >> 24;
+        else
+            return px & 0xff;
+    }
+
+    /**
+     * Bitmap image stored as a contiguous, row-major buffer of packed RGBA8
+     * pixels (4 bytes per pixel, see rgba8()).
+     */
     class PixelMap
     {
         int m_width, m_height;
         
         uint32_t m_size;
-        Pixel* m_pixels;
+        uint32_t* m_pixels;
     public:
+        /**
+         * Compatibility proxy returned by the non-const <code>operator[]</code>,
+         * assignable from and convertible to a Pixel.
+         */
+        class reference final
+        {
+            friend class PixelMap;
+
+            uint32_t& m_px;
+            int m_x, m_y;
+
+            reference(uint32_t& px, int x, int y): m_px(px), m_x(x), m_y(y) {}
+        public:
+            inline reference& operator =(const Pixel& pixel)
+            { m_px = rgba8(pixel.color, pixel.alpha); return *this; }
+
+            inline operator Pixel() const /* NOLINT */
+            { return {m_x, m_y, rgba8_color(m_px), rgba8_alpha(m_px)}; }
+        };
+
         PixelMap(int width, int height);
         PixelMap(const PixelMap& map);
+        PixelMap(PixelMap&& map) noexcept;
         virtual ~PixelMap();
         
         virtual int height() const final;
         virtual int width() const final;
         virtual uint32_t size() const final;
+
+        /**
+         * Get the packed pixels buffer (<code>size()</code> RGBA8 pixels).
+         */
+        inline uint32_t* data() { return m_pixels; }
+        inline const uint32_t* data() const { return m_pixels; }
+
+        /**
+         * Get the packed pixels of the yth row.
+         */
+        inline std::span<uint32_t> row(int y)
+        { return std::span<uint32_t>(&m_pixels[y*m_width], m_width); }
+        inline std::span<const uint32_t> row(int y) const
+        { return std::span<const uint32_t>(&m_pixels[y*m_width], m_width); }
+
+        inline unsigned long color(int x, int y) const
+        { return rgba8_color(m_pixels[y*m_width+x]); }
+        inline unsigned char alpha(int x, int y) const
+        { return rgba8_alpha(m_pixels[y*m_width+x]); }
+        inline void set(int x, int y, unsigned long color, unsigned char alpha = 0xff)
+        { m_pixels[y*m_width+x] = rgba8(color, alpha); }
         
+        /**
+         * Resampling filters available for <code>resize</code>.
+         */
+        enum Filter
+        {
+            FILTER_NEAREST,  /*< nearest neighbour (no filtering)      */
+            FILTER_BOX,      /*< box filter (area average)             */
+            FILTER_BILINEAR, /*< triangle filter                       */
+            FILTER_LANCZOS3  /*< Lanczos windowed sinc (3 lobes)       */
+        };
+
         /**
          * Resize the Pixelmap according to the specified scale.
          * @param scale the resizing scale
+         * @param filter the resampling filter
          */
-        virtual PixelMap resize(float scale) const;
+        virtual PixelMap resize(float scale, Filter filter = FILTER_BILINEAR) const;
         /**
-         * Resize the Pixelmap to another width x height.
+         * Resize the Pixelmap to another width x height. The image is resampled
+         * in two separable passes (rows then columns) with pre-computed filter
+         * weights, on premultiplied alpha, and split in row bands among the
+         * worker threads (see parallel_for).
          *
          * @param width New width to apply (put 0 to remain unchanged)
          * @param height New height to apply (put 0 to remain unchanged)
+         * @param filter the resampling filter
          */
-        virtual PixelMap resize(int width, int height) const;
+        virtual PixelMap resize(int width, int height,
+                                Filter filter = FILTER_BILINEAR) const;
         
         PixelMap& operator =(const PixelMap& map);
+        PixelMap& operator =(PixelMap&& map) noexcept;
         
-        Pixel& operator[](int i);
-        Pixel& operator[](int x, int y);
+        reference operator[](int i);
+        reference operator[](int x, int y);
         Pixel operator[](int i) const;
         Pixel operator[](int x, int y) const;
         
+        /**
+         * PNG output settings.
+         */
+        struct PNGOptions
+        {
+            png_write_opts zlib = PNG_WRITE_OPTS_DEFAULT; /*< compression    */
+            bool indexed = true; /*< palette output when at most 256 colours */
+            /**
+             * Preferred palette entries (packed RGBA8), placed first in the
+             * palette in this order. Colours found in the image are appended.
+             */
+            std::span<const uint32_t> palette = {};
+        };
+
         static PixelMap loadFromPNG(const char* pngfile) noexcept(false);
+        /**
+         * Decode a png image held in memory.
+         * @param data the png file content
+         * @throw std::runtime_error if the data isn't a valid png image
+         */
+        static PixelMap decodePNG(std::span<const uint8_t> data) noexcept(false);
+        /**
+         * Save the PixelMap as PNG. When the image uses at most 256 colours and
+         * <code>opts.indexed</code> is set, a palette image is written with the
+         * smallest bit depth (1, 2, 4 or 8 bits per pixel), otherwise the image
+         * is written as 8-bit RGBA.
+         *
+         * @param map the image to save
+         * @param dest the output file
+         * @param opts the output settings
+         */
+        static void saveInPng(const PixelMap& map, FILE* dest,
+                              const PNGOptions& opts);
         static void saveInPng(const PixelMap& map, FILE* dest);
+
+        /**
+         * Encode the PixelMap as PNG in memory (see saveInPng()).
+         * @return the png file content
+         */
+        static std::vector<uint8_t> encodePNG(const PixelMap& map,
+                                              const PNGOptions& opts);
+        static std::vector<uint8_t> encodePNG(const PixelMap& map);
+        /**
+         * Encode the PixelMap as PNG into a caller-provided buffer.
+         * @return the number of bytes written to <code>dest</code>
+         * @throw std::length_error if <code>dest</code> is too small
+         */
+        static size_t encodePNG(const PixelMap& map, std::span<uint8_t> dest,
+                                const PNGOptions& opts);
+
+        /**
+         * Fill the row <code>y</code> (<code>width</code> RGBA8 pixels, see
+         * rgba8()) of an image being streamed.
+         */
+        typedef std::function<void(int y, std::span<uint32_t> row)> RowProducer;
+
+        /**
+         * Stream a PNG image row by row: each row is produced into a single
+         * reusable buffer and compressed right away, so the full image never
+         * needs to be held in memory. The output is indexed when
+         * <code>opts.indexed</code> is set and <code>opts.palette</code> is not
+         * empty, every pixel must then be one of the palette colours.
+         *
+         * @param dest the output file
+         * @param width the image width
+         * @param height the image height
+         * @param producer called once per row, from top to bottom
+         * @param opts the output settings
+         * @throw std::runtime_error if the png couldn't be written or a pixel
+         *        is missing from the palette
+         */
+        static void saveInPng(FILE* dest, int width, int height,
+                              const RowProducer& producer, const PNGOptions& opts);
+        static void saveInPng(FILE* dest, int width, int height,
+                              const RowProducer& producer);
+
+        /**
+         * Image file formats.
+         */
+        enum Format
+        {
+            FORMAT_PNG, /*< PNG, zlib compressed (see saveInPng())           */
+            FORMAT_PPM, /*< binary PPM (P6), RGB without alpha               */
+            FORMAT_PAM, /*< PAM (P7) RGB_ALPHA, raw copy of the pixel buffer */
+            FORMAT_QOI  /*< Quite OK Image format, fast lossless RGBA        */
+        };
+
+        /**
+         * @return the format matching the file extension (.ppm, .pam, .qoi),
+         * PNG otherwise
+         */
+        static Format formatOf(const char* fname);
+
+        /**
+         * Save the PixelMap in the specified format. PPM, PAM and QOI are
+         * encoded straight from the packed pixel buffer, in a single pass.
+         *
+         * @param map the image to save
+         * @param dest the output file
+         * @param format the file format
+         * @param opts the PNG output settings (ignored by other formats)
+         */
+        static void save(const PixelMap& map, FILE* dest, Format format,
+                         const PNGOptions& opts);
+        static void save(const PixelMap& map, FILE* dest, Format format);
+
+        /**
+         * Save an image in the specified format, row by row: the producer
+         * fills each row in order, so only a row needs to be held in memory
+         * (see saveInPng() for PNG).
+         *
+         * @param dest the output file
+         * @param width the image width
+         * @param height the image height
+         * @param format the file format
+         * @param producer called once per row, in order
+         * @param opts the PNG output settings (ignored by other formats)
+         * @throw std::runtime_error if the file couldn't be written
+         */
+        static void save(FILE* dest, int width, int height, Format format,
+                         const RowProducer& producer, const PNGOptions& opts);
+
+        /**
+         * Encode the PixelMap in the specified format, in memory.
+         * @return the file content
+         */
+        static std::vector<uint8_t> encode(const PixelMap& map, Format format,
+                                           const PNGOptions& opts);
+        static std::vector<uint8_t> encode(const PixelMap& map, Format format);
+    };
+
+    /**
+     * Lazy resize of a PixelMap: any window of the resized image is computed
+     * on demand, pixel for pixel the same as <code>PixelMap::resize()</code>,
+     * in memory proportional to the source and the window rather than to the
+     * resized image. Images of the source size are copied as they are.
+     */
+    class Resampler
+    {
+    public:
+        /** Post-processing of a window at (x, y) of the resized image */
+        typedef std::function<void(PixelMap& window, int x, int y)> Finisher;
+
+    private:
+        struct axes; // filter weights of both axes
+
+        std::shared_ptr<const PixelMap> m_source;
+        int m_width, m_height;
+        PixelMap::Filter m_filter;
+        std::unique_ptr<const axes> m_axes;
+        Finisher m_finish;
+        /** Summed-area table of the non-transparent source pixels */
+        std::vector<uint32_t> m_opaque;
+    public:
+        /**
+         * @param source the image to resize, shared
+         * @param width the resized width
+         * @param height the resized height
+         * @param filter the resampling filter
+         * @param finish applied to every sampled window (may be empty)
+         */
+        Resampler(std::shared_ptr<const PixelMap> source, int width, int height,
+                  PixelMap::Filter filter = PixelMap::FILTER_BILINEAR,
+                  Finisher finish = Finisher());
+        Resampler(const Resampler&) = delete;
+        Resampler(Resampler&& resampler) noexcept;
+        ~Resampler();
+
+        inline int width() const
+        { return m_width; }
+        inline int height() const
+        { return m_height; }
+        inline const PixelMap& source() const
+        { return *m_source; }
+
+        /**
+         * Compute the window of the resized image whose top left corner is
+         * (x, y), of the window dimension. Pixels out of the image are
+         * transparent.
+         */
+        void sample(int x, int y, PixelMap& window) const;
+
+        /**
+         * @return true if no source pixel contributing to the window is
+         * visible (the window is then fully transparent), false if it may
+         * hold visible pixels
+         */
+        bool transparent(int x, int y, int width, int height) const;
     };
 }
 #endif
@@ -0,0 +1,70 @@
+/*
+ * 3C-CODE Library
+ * Copyright (C) 2023 - Rin "madeshiro" Baudelet
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with this
+ * program. If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef HH_LIB_RESOURCES
+#define HH_LIB_RESOURCES
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+#define CODE3C_RESOURCE_PREFIX ":/code3c/" // Path prefix of embedded resources
+
+namespace code3c
+{
+    /**
+     * Resource compiled into the library (see CODE3C_EMBED_RESOURCES).
+     */
+    struct embedded_resource
+    {
+        const char* name;
+        const uint8_t* data;
+        size_t size;
+    };
+
+    /**
+     * Resolve a resource file (marker, default logos, huffman tables).
+     * Resources compiled into the library resolve to
+     * <code>CODE3C_RESOURCE_PREFIX name</code> without any filesystem access.
+     * Others are searched once in <code>/usr/share/code3c/</code>,
+     * <code>/usr/local/share/code3c/</code> and <code>resources/</code>, the
+     * result being kept for the whole process. This function is thread-safe.
+     *
+     * @param name the resource file name
+     * @return the resource path (valid until the end of the process), or
+     * <code>name</code> if the resource can't be found
+     */
+    const char* resource_path(const char* name);
+
+    /**
+     * @param path a path returned by resource_path()
+     * @return the content of an embedded resource, an empty span if the path
+     * doesn't designate one
+     */
+    std::span<const uint8_t> resource_data(const char* path);
+
+    /**
+     * @return the resources compiled into the library
+     */
+    std::span<const embedded_resource> embedded_resources();
+
+    /**
+     * @return true if the file name ends with <code>ext</code> (case
+     * insensitive), e.g. <code>".svg"</code>
+     */
+    bool has_extension(const char* fname, const char* ext);
+}
+
+#endif //HH_LIB_RESOURCES
@@ -0,0 +1,114 @@
+/*
+ * 3C-CODE Library
+ * Copyright (C) 2023 - Rin "madeshiro" Baudelet
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with this
+ * program. If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef HH_LIB_SHEET
+#define HH_LIB_SHEET
+#include "3ccode.hh"
+#include "parallel.hh"
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace code3c
+{
+    /**
+     * Sheet of 3C-Codes laid out in a grid and rendered in a single image,
+     * e.g. for label printing. Every cell is as large as the largest code,
+     * each code being centred in its cell (its margin separates it from the
+     * next one). The codes are generated and laid out in parallel, their
+     * marker and logo are decoded once for the whole sheet.
+     */
+    class Code3CSheet
+    {
+        int m_columns;
+        bool m_antialiased = false;
+        std::vector<std::unique_ptr<Code3C>> m_codes;
+        mutable std::shared_ptr<const DisplayList> m_display; // laid out on first use
+    public:
+        /**
+         * @param columns the number of codes per row
+         * @throw std::runtime_error if <code>columns</code> is below 1
+         */
+        explicit Code3CSheet(int columns);
+        Code3CSheet(const Code3CSheet&) = delete;
+
+        /**
+         * Add a code to the sheet, in reading order.
+         *
+         * @param utf8buf the payload
+         * @param buflen the payload length
+         * @return the code, to be set up (model, error model, logo, pixel
+         * unit...) before <code>generate()</code>
+         */
+        Code3C& add(const char* utf8buf, size_t buflen);
+
+        inline size_t size() const
+        { return m_codes.size(); }
+        /**
+         * @return the code, to be set up again: the sheet is laid out again
+         * on the next render
+         */
+        inline Code3C& operator[](size_t index)
+        { m_display.reset(); return *m_codes[index]; }
+        inline const Code3C& operator[](size_t index) const
+        { return *m_codes[index]; }
+        inline int columns() const
+        { return m_columns; }
+        inline int rows() const
+        { return (int) ((m_codes.size() + m_columns - 1) / m_columns); }
+
+        /**
+         * Anti-alias the slices and circles of the sheet renders (see
+         * Code3C::setAntialiased()).
+         */
+        void setAntialiased(bool antialiased);
+
+        /**
+         * Generate every code of the sheet, in parallel.
+         * @return false if a code couldn't be generated (payload too large)
+         */
+        bool generate(WorkPool& pool = WorkPool::instance());
+
+        /**
+         * Gets the display list of the whole sheet, laid out on first call.
+         * @throw std::runtime_error if the sheet is empty or not generated
+         */
+        std::shared_ptr<const DisplayList> displayList() const;
+
+        /**
+         * Render the sheet off-screen and encode it in the specified format.
+         * @throw std::runtime_error if the sheet is empty or not generated
+         */
+        std::vector<uint8_t> render(PixelMap::Format format) const;
+
+        /**
+         * Render the sheet as a single SVG document, the marker and logos
+         * being embedded once.
+         * @throw std::runtime_error if the sheet is empty or not generated
+         */
+        std::string renderSVG() const;
+
+        /**
+         * Save the sheet, the format being chosen from the file extension
+         * (see Code3C::save()). Raster images are written band by band.
+         * @throw std::runtime_error if the sheet is empty, not generated, or
+         * the file couldn't be opened
+         */
+        void save(const char* fname) const;
+    };
+}
+
+#endif //HH_LIB_SHEET
@@ -0,0 +1,138 @@
+/*
+ * 3C-CODE Library
+ * Copyright (C) 2023 - Rin "madeshiro" Baudelet
+ *
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with this
+ * program. If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef HH_LIB_TILEDRASTER
+#define HH_LIB_TILEDRASTER
+#include "displaylist.hh"
+#include "parallel.hh"
+#include <atomic>
+#include <cstdio>
+
+#define CODE3C_TILE_SIZE 64 // Tile width and height (pixels)
+
+namespace code3c
+{
+    /**
+     * Headless rasterizer of a DisplayList, splitting the image in
+     * CODE3C_TILE_SIZE square tiles rendered in parallel on a WorkPool. Each
+     * tile only replays the primitives touching it, from the last one
+     * covering it whole: a tile within a single cell, the logo disc or the
+     * background is filled at once. Images are resized tile by tile from
+     * their source. The result is the same as a RasterDrawer replaying the
+     * list at the same scale, in memory independent of the image size when
+     * it is streamed to a file.
+     */
+    class TiledRasterizer
+    {
+        struct wedge
+        {
+            Slice slice;          /*< scaled slice                          */
+            float start, sweep;   /*< degrees, counter-clockwise (y up)     */
+        };
+
+        struct operation
+        {
+            DisplayList::Kind kind;
+            unsigned long color;
+            int args[4];          /*< scaled command arguments              */
+            int bounds[4];        /*< x0, y0, x1, y1 (excluded), pixels     */
+            uint32_t first, count;/*< wedges, or image                      */
+            int cx, cy, radius;   /*< common centre and largest radius      */
+            bool centred;         /*< every wedge shares the centre         */
+        };
+
+        const DisplayList& m_list;
+        double m_scale;
+        bool m_antialiased;
+        int m_width, m_height;
+        int m_columns, m_rows; /*< tiles */
+
+        std::vector<operation> m_operations;
+        std::vector<wedge> m_wedges;
+        std::vector<Resampler> m_images; /*< resized tile by tile */
+        std::vector<uint32_t> m_imageSources; /*< list image of each sampler */
+
+        mutable std::atomic<size_t> m_uniform, m_rasterized;
+
+        void render_tile(int column, int row, PixelMap& band, int y) const;
+    public:
+        /**
+         * Prepare the list for rendering: scale the primitives and load the
+         * source images.
+         *
+         * @param list the display list, kept by reference
+         * @param scale the output scale (see DisplayList::replay())
+         * @param antialiased anti-alias the slices and circles (see
+         * RasterDrawer::setAntialiased())
+         * @throw std::runtime_error if an image can't be decoded
+         */
+        TiledRasterizer(const DisplayList& list, double scale, bool antialiased = false);
+        TiledRasterizer(const TiledRasterizer&) = delete;
+
+        inline int width() const
+        { return m_width; }
+        inline int height() const
+        { return m_height; }
+
+        /**
+         * Render the rows <code>[y, y + band.height())</code> of the image.
+         * @param y first row, a multiple of CODE3C_TILE_SIZE
+         * @param band the destination, <code>width()</code> pixels wide
+         */
+        void render(int y, PixelMap& band, WorkPool& pool = WorkPool::instance()) const;
+
+        /**
+         * @return the whole image
+         */
+        PixelMap render(WorkPool& pool = WorkPool::instance()) const;
+
+        /**
+         * Stream the image to a file, one band of tiles at a time: the next
+         * band is rendered while the current one is encoded, at most two bands
+         * are held in memory. A PNG output is indexed when the image has at
+         * most 256 colours, <code>opts.palette</code> giving the first
+         * entries.
+         *
+         * @param format the file format (see PixelMap::save())
+         * @throw std::runtime_error if the file couldn't be written
+         */
+        void save(FILE* dest, PixelMap::Format format, const PixelMap::PNGOptions& opts,
+                  WorkPool& pool = WorkPool::instance()) const;
+
+        inline void savePNG(FILE* dest, const PixelMap::PNGOptions& opts,
+                            WorkPool& pool = WorkPool::instance()) const
+        { save(dest, PixelMap::FORMAT_PNG, opts, pool); }
+
+        /**
+         * @return every colour of the image (packed RGBA8) when there are at
+         * most 256 of them, an empty vector otherwise (or if anti-aliased, or
+         * if a resized image has too many colours, see
+         * DisplayList::imagePalette())
+         */
+        std::vector<uint32_t> colors() const;
+
+        /**
+         * @return the number of tiles filled at once, and rasterized, since
+         * the creation of the rasterizer
+         */
+        inline size_t uniformTiles() const
+        { return m_uniform; }
+        inline size_t rasterizedTiles() const
+        { return m_rasterized; }
+    };
+}
+
+#endif //HH_LIB_TILEDRASTER
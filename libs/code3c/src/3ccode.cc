@@ -1,10 +1,27 @@
 #include "code3c/3ccode.hh"
+#include <algorithm>
 #include <cstring>
 #include <stdexcept>
 #include "code3c/pixelmap.hh"
+#include "code3c/tiledraster.hh"
 
 namespace code3c
 {
+    namespace
+    {
+        /**
+         * @return a NUL-terminated copy of the <code>len</code> bytes of
+         * <code>buf</code>, embedded NULs included
+         */
+        const char8_t* copy_payload(const void* buf, size_t len)
+        {
+            auto* copy = new char8_t[len+1];
+            memcpy(copy, buf, len);
+            copy[len] = u8'\0';
+            return copy;
+        }
+    }
+
     Code3C::data::data(Code3C *parent):
             mat8_t(parent->dimension().axis_t, parent->dimension().axis_r),
             m_parent(parent),
@@ -21,7 +38,7 @@ namespace code3c
         };
 
         // Huffman compression
-        HuffmanTable* huffman = code3c_default_htf[parent->m_huffmodel];
+        HuffmanTable* huffman = code3c_default_htf(parent->m_huffmodel);
         if (huffman)
         {
             data3c = huffman->encode<char8_t>(parent->m_rawdata,
@@ -32,9 +49,9 @@ namespace code3c
         }
         else
         {
-            data3c  = (char8_t*) strncpy(new char[parent->m_datalen],
-                    (char*)parent->m_rawdata, parent->m_datalen);
-            data    = (char*) data3c;
+            // Read in place by the Hamming encoder
+            data3c  = nullptr;
+            data    = (char*) parent->m_rawdata;
             ldata3c = parent->m_datalen;
         }
 
@@ -59,6 +76,7 @@ namespace code3c
 
         for (int i(0); i < dim.axis_t; i++)
         {
+            std::span<char8_t> sector(row(i));
             if (i == 0 || i == qcal3)
             {
                 // Setup Calibration (radius)
@@ -66,14 +84,14 @@ namespace code3c
 
                 for (int j(0); j < dim.axis_r; j++)
                 {
-                    m_mat[i][j] = static_cast<char8_t>(mask() * (j%2));
+                    sector[j] = static_cast<char8_t>(mask() * (j%2));
                 }
             }
             else if (i <= qcal1 ||  (i >= qcal2 && i <= qcal3))
             {
                 // Setup Calibration (angle)
                 set_range(1, dim.axis_r);
-                m_mat[i][0] = static_cast<char8_t>(mask() * ((i + (i >= qcal2)) % 2));
+                sector[0] = static_cast<char8_t>(mask() * ((i + (i >= qcal2)) % 2));
             }
             else if (i == tcal1 || i == tcal1 + 1)
             {
@@ -82,7 +100,7 @@ namespace code3c
                 // Setup header
                 for (int j(0); j < dim.axis_r; j++, ihead++)
                 {
-                    m_mat[i][j] = head[ihead]* mask();
+                    sector[j] = head[ihead]* mask();
                 }
             }
             else set_range(0, dim.axis_r);
@@ -99,7 +117,7 @@ namespace code3c
                     index = bit / 8;
                 }
 
-                m_mat[i][j] = _byte;
+                sector[j] = _byte;
             }
         }
 
@@ -164,17 +182,20 @@ namespace code3c
         return bit & 1;
     }
 
-    void Code3C::header::from_buffer(char8_t *buf, size_t len)
+    void Code3C::header::from_view(mat_view<const char8_t> buf)
     {
-        size_t i(0);
-        for (size_t k(0); k < 2; k++, i++, desc <<= 1)
-            desc |= buf[i] & 1;
-        err |= buf[i++] & 1;
-        for (size_t k(0); k < 3; k++, i++, huff <<= 1)
-            huff |= buf[i] & 1;
+        size_t i(0), len(buf.size());
+        desc = err = huff = 0;
+        dlen = 0;
 
-        for (; i < len; i++, dlen <<= 1)
-            dlen |= buf[i] & 1;
+        for (size_t k(0); k < 2; k++, i++)
+            desc = (desc << 1) | (buf[i] & 1);
+        err = buf[i++] & 1;
+        for (size_t k(0); k < 3; k++, i++)
+            huff = (huff << 1) | (buf[i] & 1);
+
+        for (; i < len; i++)
+            dlen = (dlen << 1) | (buf[i] & 1);
     }
 
     Code3C::Code3C(const char *utf8buf):
@@ -183,39 +204,54 @@ namespace code3c
     }
 
     Code3C::Code3C(const char *utf8buf, size_t buflen):
-            m_rawdata((char8_t *) strcpy(new char[buflen+1], utf8buf)),
+            m_rawdata(copy_payload(utf8buf, buflen)),
             m_datalen(buflen),
             m_logo(nullptr),
-            m_header({0,0,0,0,0}),
+            m_outfile(nullptr),
+            m_drawer(nullptr),
+            m_header({0,0,0,0,0})
+    {
+    }
+
+    Code3C::Code3C(std::span<const std::byte> data):
+            m_rawdata(reinterpret_cast<const char8_t*>(data.data())),
+            m_datalen(data.size()),
+            m_owner(false),
+            m_logo(nullptr),
+            m_outfile(nullptr),
             m_drawer(nullptr),
-            m_outfile(nullptr)
+            m_header({0,0,0,0,0})
+    {
+    }
+
+    Code3C::Code3C(std::u8string_view data):
+            Code3C(std::as_bytes(std::span(data)))
     {
     }
 
     Code3C::Code3C(const mat8_t &in_data):
-            m_header({0,0,0,0,0}),
             m_data(new data(this, in_data)),
+            m_rawdata(nullptr),
+            m_datalen(0),
             m_logo(nullptr),
-            m_outfile(nullptr)
+            m_outfile(nullptr),
+            m_drawer(nullptr),
+            m_header({0,0,0,0,0})
     {
-        size_t i, j, r, t, bit(0);
+        size_t i, j, bit(0);
         size_t range[2] = {0, 0};
         auto set_range = [&range](size_t lindex, size_t hindex) -> void {
             range[0] = lindex; range[1] = hindex;
         };
 
         // Compute specials sections positions
-        int qcal1 = 1*dimension().axis_t/4, // q1: rad and angle calibration begin
-            qcal2 = 1*dimension().axis_t/2, // q2: end angle calibration
-            qcal3 = 3*dimension().axis_t/4; // q3: rad calibration
-        int tcal1 = 3*dimension().axis_t/8; // header position
-
-        // Read header
-        char8_t *headbuf = new char8_t[2*in_data.m()];
-        for (i = 0, t = 0; t < 2; t++)
-            for (r = 0; r < in_data.m(); r++, i++)
-                headbuf[i] = in_data[t, r];
-        m_header.from_buffer(headbuf, 2*in_data.m());
+        int qcal1 = 1*in_data.n()/4, // q1: rad and angle calibration begin
+            qcal2 = 1*in_data.n()/2, // q2: end angle calibration
+            qcal3 = 3*in_data.n()/4; // q3: rad calibration
+        int tcal1 = 3*in_data.n()/8; // header position
+
+        // Read header (two sectors, read in place)
+        m_header.from_view(in_data.view(tcal1, 0, 2, in_data.m()));
 
         // Set-up descriptor values
         m_desc = m_header.desc - 1;
@@ -256,32 +292,41 @@ namespace code3c
                 // TODO
             }
         }
-
-        // Free memory
-        delete[] headbuf;
     }
 
     Code3C::Code3C(const Code3C &code3C):
-            m_rawdata((char8_t *) strcpy(new char[code3C.m_datalen+1], (char*)
-                                         code3C.m_rawdata)),
+            m_rawdata(copy_payload(code3C.m_rawdata, code3C.m_datalen)),
             m_datalen(code3C.m_datalen),
-            m_header(code3C.m_header),
             m_logo(code3C.m_logo),
-            m_drawer(nullptr)
+            m_antialiased(code3C.m_antialiased),
+            m_unit(code3C.m_unit),
+            m_margin(code3C.m_margin),
+            m_drawer(nullptr),
+            m_header(code3C.m_header)
     {
     }
 
     Code3C::~Code3C() noexcept
     {
-        delete[] m_rawdata;
+        delete m_drawer;
+        if (m_owner)
+            delete[] m_rawdata;
         delete m_data;
     }
 
     void Code3C::setModel(uint8_t model)
     {
-        if (model <= CODE3C_MODEL_WB6C)
+        if (model <= CODE3C_MODEL_WB6C && model != m_desc)
         {
+            // The matrix, header and dimension belong to the previous model:
+            // the 3C-Code has to be generated again
             m_desc = model;
+            delete m_data;
+            delete m_drawer;
+
+            m_data = nullptr;
+            m_drawer = nullptr;
+            m_display.reset();
         }
     }
 
@@ -304,12 +349,28 @@ namespace code3c
     void Code3C::setLogo(const char *fname)
     {
         m_logo = fname;
+        m_display.reset();
+    }
+
+    void Code3C::setAntialiased(bool antialiased)
+    {
+        m_antialiased = antialiased;
+    }
+
+    void Code3C::setPixelUnit(int unit, int margin)
+    {
+        if (unit >= 1 && margin >= 0 && (unit != m_unit || margin != m_margin))
+        {
+            m_unit = unit;
+            m_margin = margin;
+            m_display.reset(); // laid out again
+        }
     }
 
     bool Code3C::generate()
     {
         // Check dimensions
-        const HuffmanTable* huffman = code3c_default_htf[m_huffmodel];
+        const HuffmanTable* huffman = code3c_default_htf(m_huffmodel);
         const Hamming* hamming = model().hamming[m_errmodel];
 
         size_t buflen = huffman ? huffman->lengthOf<char8_t>(m_rawdata, m_datalen)
@@ -339,12 +400,13 @@ namespace code3c
         };
         m_header.meta_full_bitl = m_header.meta_head_bitl+m_header.meta_dlen_bitl;
 
-        // Generate code3c data
+        // Generate code3c data (the drawer is opened on display)
         delete m_data;
         delete m_drawer;
 
+        m_drawer = nullptr;
+        m_display.reset();
         m_data = new data(this);
-        m_drawer = new Code3CDrawer(this, *m_data);
 
         return m_data != nullptr;
     }
@@ -353,14 +415,90 @@ namespace code3c
 
     void Code3C::display() const
     {
-        m_drawer->run();
+        drawer()->run();
     }
 
     Drawer* Code3C::drawer() const
     {
+        if (!m_drawer && m_data)
+            m_drawer = new Code3CDrawer(this, *m_data);
         return m_drawer;
     }
 
+    std::shared_ptr<const DisplayList> Code3C::displayList() const
+    {
+        if (!m_data)
+            throw std::runtime_error("3C-Code not generated");
+
+        if (!m_display)
+            m_display = std::make_shared<const DisplayList>(Code3CPainter(this).layout(*m_data));
+        return m_display;
+    }
+
+    std::vector<uint8_t> Code3C::renderPNG() const
+    {
+        return render(PixelMap::FORMAT_PNG);
+    }
+
+    std::vector<uint8_t> Code3C::render(PixelMap::Format format, WorkPool& pool) const
+    {
+        if (!m_data)
+            throw std::runtime_error("3C-Code not generated");
+
+        std::shared_ptr<const DisplayList> list(displayList());
+        TiledRasterizer raster(*list, 1.0, m_antialiased);
+        std::vector<uint32_t> colors(Code3CPainter(this).palette());
+        PixelMap::PNGOptions opts;
+        opts.palette = colors;
+        // Flat colours: unfiltered rows compress faster and smaller
+        opts.zlib.filters = PNG_FILTER_NONE;
+        return PixelMap::encode(raster.render(pool), format, opts);
+    }
+
+    std::string Code3C::renderSVG() const
+    {
+        if (!m_data)
+            throw std::runtime_error("3C-Code not generated");
+
+        Code3CSVGDrawer svg(this, *m_data);
+        svg.run();
+        return svg.svg();
+    }
+
+    void Code3C::save(const char *fname, WorkPool& pool) const
+    {
+        FILE* dest = fopen(fname, "wb");
+        if (!dest)
+            throw std::runtime_error("Unable to open output file");
+        try
+        {
+            if (has_extension(fname, ".svg"))
+            {
+                std::string document(renderSVG());
+                if (fwrite(document.data(), 1, document.size(), dest) != document.size())
+                    throw std::runtime_error("Unable to write output file");
+            }
+            else
+            {
+                std::shared_ptr<const DisplayList> list(displayList());
+                TiledRasterizer raster(*list, 1.0, m_antialiased);
+                std::vector<uint32_t> colors(Code3CPainter(this).palette());
+                PixelMap::PNGOptions opts;
+                opts.palette = colors;
+                opts.zlib.filters = PNG_FILTER_NONE;
+                raster.save(dest, PixelMap::formatOf(fname), opts, pool);
+            }
+        }
+        catch (...)
+        {
+            fclose(dest);
+            throw;
+        }
+        // Buffered data is only written on close
+        if (fclose(dest) != 0)
+            throw std::runtime_error("Unable to write output file");
+    }
+
     void Code3C::set_output(const char *dest)
     {
         m_outfile = dest;
@@ -403,30 +541,18 @@ namespace code3c
         return code3c_models[m_desc];
     }
 
-    __dlgt Code3CDrawer::save_ui()
+    Code3CPainter::Code3CPainter(const Code3C *parent) :
+            parent(parent), modelDimension(parent->dimension())
     {
-        savePNG(parent->m_outfile ? parent->m_outfile : "code3c.png");
     }
 
-    Code3CDrawer::Code3CDrawer(const code3c::Code3C *parent, const Code3C::data &cData) :
-            parent(parent), logo(nullptr), marker(nullptr),
-            SimpleDrawer(
-                    40 + 2 * parent->dimension().absRad * CODE3C_PIXEL_UNIT,
-                    40 + 2 * parent->dimension().absRad * CODE3C_PIXEL_UNIT,
-                    cData
-            ), modelDimension(parent->dimension())
+    int Code3CPainter::size(const CODE3C_MODEL_DESC::CODE3C_MODEL_DIMENSION& dim,
+                            int unit, int margin)
     {
-        bindKey((DRAWER_KEY_CTRL | 's'),
-                reinterpret_cast<delegate>(&Code3CDrawer::save_ui));
+        return 2 * margin + 2 * dim.absRad * unit;
     }
 
-    Code3CDrawer::~Code3CDrawer()
-    {
-        delete logo;
-        delete marker;
-    }
-
-    unsigned long Code3CDrawer::bit_to_color(char _byte)
+    unsigned long Code3CPainter::bit_to_color(char _byte) const
     {
         switch (parent->model().model_id)
         {
@@ -452,65 +578,65 @@ namespace code3c
         }
     }
 
-    void Code3CDrawer::draw_angle(int t)
+    void Code3CPainter::layout_ring(DisplayList& list, const mat8_t& data, int r) const
     {
-        for (int r(m_data.m() - 1); r >= 0; r--)
+        int center(size(modelDimension, parent->m_unit, parent->m_margin) / 2);
+        int currentRad((modelDimension.absRad - modelDimension.effRad
+                        + modelDimension.deltaRad + (r * modelDimension.deltaRad))
+                       * parent->m_unit
+        );
+
+        // Cells of the ring bucketed by colour (at most 8), each bucket being
+        // submitted at once
+        std::vector<std::pair<unsigned long, std::vector<Slice>>> buckets;
+        for (int t(0); t < modelDimension.axis_t; t++)
         {
-            char _byte(m_data[t, r]);
-
-            int offRad(modelDimension.absRad - modelDimension.effRad
-                       + modelDimension.deltaRad
-            );
-            int currentRad((offRad + (r * modelDimension.deltaRad))
-                           * CODE3C_PIXEL_UNIT
-            );
-
-            foreground(bit_to_color(_byte));
-            draw_slice(width() / 2, height() / 2, currentRad,
-                       180 / modelDimension.rev,
-                       t * 180 / (modelDimension.rev));
+            unsigned long color(bit_to_color((char) data.row(t)[r]));
+            auto bucket(std::find_if(buckets.begin(), buckets.end(),
+                                     [color](const auto& b) { return b.first == color; }));
+            if (bucket == buckets.end())
+                bucket = buckets.insert(buckets.end(), {color, {}});
+            bucket->second.push_back({center, center, currentRad,
+                                      180 / modelDimension.rev,
+                                      t * 180 / (modelDimension.rev)});
         }
+        for (const auto& bucket : buckets)
+            list.slices(bucket.first, bucket.second);
     }
 
-    void Code3CDrawer::setup()
+    std::vector<uint32_t> Code3CPainter::palette() const
     {
-        // Setup window
-        setTitle("Code3C Drawing Frame");
-
-        // Load marker
+        // Background and logo disc first, then one colour per symbol. The
+        // marker and logo pixels are appended when the image is scanned.
+        std::vector<uint32_t> colors{rgba8(0xffffff), rgba8(0xbe55ab)};
+        for (unsigned bits(0); bits < (1u << parent->model().bitl); bits++)
         {
-            PixelMap map = PixelMap::loadFromPNG(C3CRC("code3c-marker.png"));
-            marker = new PixelMap(map.resize(width(), height()));
-        }
-
-        // Load logo
-        {
-            int logoDiameter = (modelDimension.absRad - modelDimension.effRad) *
-                               CODE3C_PIXEL_UNIT * 2;
-            PixelMap map = PixelMap::loadFromPNG(parent->m_logo
-                                                 ? parent->m_logo
-                                                 : parent->model().default_logo
-            );
-            logo = new PixelMap(map.resize(logoDiameter, logoDiameter));
+            uint32_t color(rgba8(bit_to_color((char) bits)));
+            if (std::find(colors.begin(), colors.end(), color) == colors.end())
+                colors.push_back(color);
         }
+        return colors;
     }
 
-    void Code3CDrawer::draw()
+    DisplayList Code3CPainter::layout(const mat8_t& data) const
     {
+        int unit(parent->m_unit);
+        int width(size(modelDimension, unit, parent->m_margin)), height(width);
+        DisplayList list(width, height);
         {
             // white background
-            background(0xffffff);
+            list.background(0xffffff);
 
             // Draw marker
-            draw_pixelmap(*marker, 0, 0);
+            list.blit(C3CRC("code3c-marker.png"), false, 0, 0, width, height);
 
             // Draw colour calibration
             {
                 int offRad(modelDimension.absRad - modelDimension.effRad
                            + modelDimension.deltaRad
                 );
-                int currentRad((offRad + (m_data.m() * modelDimension.deltaRad))
-                               * CODE3C_PIXEL_UNIT
+                int currentRad((offRad + (data.m() * modelDimension.deltaRad)) * unit
+                               + 5 * unit / CODE3C_PIXEL_UNIT // 5px at the default unit
                 );
                 int tcal1 = 3 * modelDimension.axis_t / 8; // header position
 
@@ -519,66 +645,97 @@ namespace code3c
                      bit < (1 << parent->model().bitl) / 2;
                      bit++, t++)
                 {
-                    foreground(bit_to_color(bit));
-                    draw_slice(width() / 2, height() / 2, currentRad + 5,
+                    Slice cell{width / 2, height / 2, currentRad,
                                180 / modelDimension.rev,
-                               t * 180 / (modelDimension.rev));
+                               t * 180 / (modelDimension.rev)};
+                    list.slices(bit_to_color(bit), {&cell, 1});
                 }
                 // Right part from the header
                 for (int bit(0b111 & parent->model().mask), i(0), t = tcal1;
                      i < (1 << parent->model().bitl) / 2;
                      bit--, t--, i++)
                 {
-                    foreground(bit_to_color(bit));
-                    draw_slice(width() / 2, height() / 2, currentRad + 5,
+                    Slice cell{width / 2, height / 2, currentRad,
                                180 / modelDimension.rev,
-                               t * 180 / (modelDimension.rev));
+                               t * 180 / (modelDimension.rev)};
+                    list.slices(bit_to_color(bit), {&cell, 1});
                 }
             }
 
 #ifdef CODE3C_DEBUG
             // Draw 3ccode outline
-            foreground(0);
-            fill_circle(width()/2, height()/2, 2+(width()-40)/2);
-            draw_line(0, height()/2, width(), height()/2);
-            draw_line(width()/2, 0, width()/2, height());
+            list.circle(0, width/2, height/2, 2+(width-2*parent->m_margin)/2);
+            list.line(0, 0, height/2, width, height/2);
+            list.line(0, width/2, 0, width/2, height);
 
             // Debug : header landmark
-            foreground(0xff0000);
-            draw_line(0, 0, width()/2, height()/2);
+            list.line(0xff0000, 0, 0, width/2, height/2);
 #endif // CODE3C_DEBUG
 
-            // Draw data
-            for (int t(0); t < modelDimension.axis_t; t++)
+            // Draw data: pie slices, from the outer ring inwards
+            for (int r(data.m() - 1); r >= 0; r--)
             {
-                draw_angle(t);
+                layout_ring(list, data, r);
             }
 
             // Fill logo
-            foreground(0xbe55ab);
-            fill_circle(width() / 2, height() / 2, (modelDimension
-                                                            .absRad -
-                                                    modelDimension.effRad) *
-                                                   CODE3C_PIXEL_UNIT
-            );
-
-            // Draw logo
-            int logoDiameter = (modelDimension.absRad - modelDimension.effRad) *
-                               CODE3C_PIXEL_UNIT * 2;
-            int origX = (width() - logoDiameter) / 2;
-            int origY = (height() - logoDiameter) / 2;
-
-            int rlogo = logoDiameter / 2;
-            for (int x = 0, xx = origX; x < logoDiameter; x++, xx++)
-            {
-                int rx = abs(rlogo - x);
-                for (int y = 0, yy = origY; y < logoDiameter; y++, yy++)
-                {
-                    int ry = abs(rlogo - y);
-                    if (((rx * rx) + (ry * ry)) < (rlogo * rlogo))
-                        draw_pixel((*logo)[x, y].color, xx, yy);
-                }
-            }
+            int logoRad((modelDimension.absRad - modelDimension.effRad) * unit);
+            list.circle(0xbe55ab, width / 2, height / 2, logoRad);
+
+            // Draw logo (clipped to its disc)
+            int logoDiameter = logoRad * 2;
+            list.blit(parent->m_logo ? parent->m_logo : C3CRC(parent->model().default_logo),
+                      true, (width - logoDiameter) / 2, (height - logoDiameter) / 2,
+                      logoDiameter, logoDiameter);
         }
+        return list;
+    }
+
+    void Code3CPainter::paint(Drawer& drawer) const
+    {
+        parent->displayList()->replay(drawer);
+    }
+
+    template<class Backend>
+    __dlgt BasicCode3CDrawer<Backend>::save_ui()
+    {
+        parent->save(parent->m_outfile ? parent->m_outfile : "code3c.png");
+    }
+
+    template<class Backend>
+    BasicCode3CDrawer<Backend>::BasicCode3CDrawer(const Code3C *parent,
+                                                  const Code3C::data &cData) :
+            Backend(Code3CPainter::size(parent->dimension(), parent->m_unit, parent->m_margin),
+                    Code3CPainter::size(parent->dimension(), parent->m_unit, parent->m_margin),
+                    cData),
+            parent(parent), painter(parent)
+    {
+        // The code never changes once generated
+        this->setRetained(true);
+        this->bindKey((DRAWER_KEY_CTRL | 's'),
+                      reinterpret_cast<Drawer::delegate>(&BasicCode3CDrawer::save_ui));
     }
-}
\ No newline at end of file
+
+    template<class Backend>
+    std::vector<uint32_t> BasicCode3CDrawer<Backend>::palette() const
+    {
+        return painter.palette();
+    }
+
+    template<class Backend>
+    void BasicCode3CDrawer<Backend>::setup()
+    {
+        // Setup window
+        this->setTitle("Code3C Drawing Frame");
+    }
+
+    template<class Backend>
+    void BasicCode3CDrawer<Backend>::draw()
+    {
+        painter.paint(*this);
+    }
+
+    template class BasicCode3CDrawer<SimpleDrawer>;
+    template class BasicCode3CDrawer<RasterDrawer>;
+    template class BasicCode3CDrawer<SVGDrawer>;
+}
@@ -0,0 +1,135 @@
+#include "code3c/assetcache.hh"
+#include <filesystem>
+
+namespace code3c
+{
+    size_t AssetCache::key_hash::operator()(const key &k) const
+    {
+        size_t h(std::hash<std::string>()(k.path));
+        for (long long v : {k.mtime, (long long) k.width, (long long) k.height,
+                            (long long) k.variant})
+            h ^= std::hash<long long>()(v) + 0x9e3779b97f4a7c15ull + (h << 6) + (h >> 2);
+        return h;
+    }
+
+    AssetCache::AssetCache(size_t capacity):
+            m_capacity(capacity), m_memory(0), m_hits(0), m_misses(0)
+    {
+    }
+
+    AssetCache& AssetCache::instance()
+    {
+        static AssetCache cache;
+        return cache;
+    }
+
+    AssetCache::asset AssetCache::load(const char *fname, int width, int height)
+    {
+        return load(fname, width, height, 0, Finisher());
+    }
+
+    AssetCache::asset AssetCache::load(const char *fname)
+    {
+        return load(fname, 0, 0);
+    }
+
+    AssetCache::asset AssetCache::load(const char *fname, int width, int height,
+                                       int variant, const Finisher& finish)
+    {
+        // Resolve the file, a missing one is reported by the decoder
+        std::error_code error;
+        std::filesystem::path path(std::filesystem::canonical(fname, error));
+        long long mtime(0);
+        if (!error)
+            mtime = std::filesystem::last_write_time(path, error).time_since_epoch().count();
+        key id{error ? std::string(fname) : path.string(), mtime, width, height, variant};
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            auto found(m_index.find(id));
+            if (found != m_index.end())
+            {
+                m_hits++;
+                m_entries.splice(m_entries.begin(), m_entries, found->second);
+                return found->second->map;
+            }
+            m_misses++;
+        }
+
+        // Decoded outside the lock: concurrent misses on the same key may
+        // decode twice, the first inserted image is kept
+        PixelMap decoded(PixelMap::loadFromPNG(fname));
+        auto map = std::make_shared<PixelMap>(
+                (width <= 0 || decoded.width() == width) &&
+                (height <= 0 || decoded.height() == height)
+                ? decoded : decoded.resize(width, height));
+        if (finish)
+            finish(*map);
+
+        size_t bytes(map->size() * sizeof(uint32_t));
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto found(m_index.find(id));
+        if (found != m_index.end())
+            return found->second->map;
+        if (bytes <= m_capacity)
+        {
+            evict(m_capacity - bytes);
+            m_entries.push_front(entry{id, map});
+            m_index.emplace(std::move(id), m_entries.begin());
+            m_memory += bytes;
+        }
+        return map;
+    }
+
+    void AssetCache::evict(size_t capacity)
+    {
+        while (m_memory > capacity && !m_entries.empty())
+        {
+            const entry& last(m_entries.back());
+            m_memory -= last.map->size() * sizeof(uint32_t);
+            m_index.erase(last.id);
+            m_entries.pop_back();
+        }
+    }
+
+    void AssetCache::setCapacity(size_t bytes)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_capacity = bytes;
+        evict(bytes);
+    }
+
+    size_t AssetCache::capacity() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_capacity;
+    }
+
+    size_t AssetCache::memory() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_memory;
+    }
+
+    size_t AssetCache::hits() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_hits;
+    }
+
+    size_t AssetCache::misses() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_misses;
+    }
+
+    void AssetCache::clear()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_entries.clear();
+        m_index.clear();
+        m_memory = 0;
+        m_hits = 0;
+        m_misses = 0;
+    }
+}
@@ -0,0 +1,261 @@
+#include "code3c/displaylist.hh"
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace code3c
+{
+    namespace
+    {
+        // Circular clip of a size x size image: opaque inside the disc,
+        // transparent outside. map holds the window at (x0, y0).
+        void clip_circle(PixelMap& map, int size, int x0, int y0)
+        {
+            int rlogo = size / 2;
+            for (int y = 0; y < map.height(); y++)
+            {
+                int ry = abs(rlogo - (y0 + y));
+                std::span<uint32_t> row(map.row(y));
+                for (int x = 0; x < map.width(); x++)
+                {
+                    int rx = abs(rlogo - (x0 + x));
+                    bool inside(((rx * rx) + (ry * ry)) < (rlogo * rlogo));
+                    row[x] = rgba8(rgba8_color(row[x]), inside ? 0xff : 0);
+                }
+            }
+        }
+
+        // Aliased image: opaque or transparent pixels, coloured from the
+        // palette if not empty
+        void snap(PixelMap& map, const std::vector<uint32_t>& palette)
+        {
+            std::unordered_map<uint32_t, uint32_t> nearest;
+            for (size_t i(0); i < map.size(); i++)
+            {
+                uint32_t& px(map.data()[i]);
+                if (rgba8_alpha(px) < 0x80)
+                {
+                    px = 0;
+                    continue;
+                }
+                px = rgba8(rgba8_color(px));
+                if (palette.empty())
+                    continue;
+
+                auto found(nearest.find(px));
+                if (found == nearest.end())
+                {
+                    uint32_t best(palette[0]);
+                    long bestDistance(LONG_MAX);
+                    for (uint32_t color : palette)
+                    {
+                        long distance(0);
+                        for (int shift : {0, 8, 16})
+                        {
+                            long d((long) ((px >> shift) & 0xff) - (long) ((color >> shift) & 0xff));
+                            distance += d * d;
+                        }
+                        if (distance < bestDistance)
+                        {
+                            best = color;
+                            bestDistance = distance;
+                        }
+                    }
+                    found = nearest.emplace(px, best).first;
+                }
+                px = found->second;
+            }
+        }
+    }
+
+    DisplayList::DisplayList(int width, int height):
+            m_width(width), m_height(height)
+    {
+    }
+
+    void DisplayList::background(unsigned long color)
+    {
+        m_commands.push_back({DL_BACKGROUND, color, {0, 0, 0, 0}, 0, 0});
+    }
+
+    void DisplayList::slices(unsigned long color, std::span<const Slice> slices)
+    {
+        m_commands.push_back({DL_SLICES, color, {0, 0, 0, 0},
+                              (uint32_t) m_slices.size(), (uint32_t) slices.size()});
+        m_slices.insert(m_slices.end(), slices.begin(), slices.end());
+    }
+
+    void DisplayList::circle(unsigned long color, int x, int y, int radius)
+    {
+        m_commands.push_back({DL_CIRCLE, color, {x, y, radius, 0}, 0, 0});
+    }
+
+    void DisplayList::line(unsigned long color, int x1, int y1, int x2, int y2)
+    {
+        m_commands.push_back({DL_LINE, color, {x1, y1, x2, y2}, 0, 0});
+    }
+
+    void DisplayList::blit(const char *fname, bool circular, int x, int y,
+                           int width, int height)
+    {
+        m_commands.push_back({DL_BLIT, 0, {x, y, width, height},
+                              (uint32_t) m_images.size(), 1});
+        m_images.push_back({fname, circular});
+    }
+
+    void DisplayList::append(const DisplayList &list, int x, int y)
+    {
+        auto image0((uint32_t) m_images.size());
+        for (const command& cmd : list.m_commands)
+        {
+            command moved(cmd);
+            switch (cmd.kind)
+            {
+                case DL_BACKGROUND:
+                    continue;
+                case DL_SLICES:
+                    moved.first = (uint32_t) m_slices.size();
+                    for (const Slice& s : list.slices().subspan(cmd.first, cmd.count))
+                        m_slices.push_back({s.x + x, s.y + y, s.radius, s.degree, s.rotation});
+                    break;
+                case DL_LINE:
+                    moved.args[2] += x;
+                    moved.args[3] += y;
+                    [[fallthrough]];
+                case DL_CIRCLE:
+                    moved.args[0] += x;
+                    moved.args[1] += y;
+                    break;
+                case DL_BLIT:
+                    moved.args[0] += x;
+                    moved.args[1] += y;
+                    moved.first += image0;
+                    break;
+            }
+            m_commands.push_back(moved);
+        }
+        m_images.insert(m_images.end(), list.m_images.begin(), list.m_images.end());
+    }
+
+    AssetCache::asset DisplayList::loadImage(size_t index, int width, int height,
+                                             bool aliased) const
+    {
+        const image& img(m_images[index]);
+        if (!img.circular && !aliased)
+            return AssetCache::instance().load(img.path.c_str(), width, height);
+
+        // The palette is only read on a cache miss
+        int variant((img.circular ? CODE3C_ASSET_LOGO : 0) | (aliased ? CODE3C_ASSET_ALIASED : 0));
+        return AssetCache::instance().load(img.path.c_str(), width, height, variant,
+                                           [this, &img, index, aliased](PixelMap& map) {
+            if (img.circular)
+                clip_circle(map, map.width(), 0, 0);
+            if (aliased)
+                snap(map, imagePalette(index));
+        });
+    }
+
+    Resampler DisplayList::sampleImage(size_t index, int width, int height, bool aliased) const
+    {
+        if ((long long) width * height <= CODE3C_ASSET_WHOLE)
+            return {loadImage(index, width, height, aliased), width, height};
+
+        const image& img(m_images[index]);
+        auto palette(std::make_shared<const std::vector<uint32_t>>(
+                aliased ? imagePalette(index) : std::vector<uint32_t>()));
+        Resampler::Finisher finish;
+        if (img.circular || aliased)
+            finish = [width, circular(img.circular), aliased, palette](PixelMap& window,
+                                                                       int x, int y) {
+                if (circular)
+                    clip_circle(window, width, x, y);
+                if (aliased)
+                    snap(window, *palette);
+            };
+        return {AssetCache::instance().load(img.path.c_str()), width, height,
+                PixelMap::FILTER_BILINEAR, finish};
+    }
+
+    std::vector<uint32_t> DisplayList::imagePalette(size_t index) const
+    {
+        const image& img(m_images[index]);
+        AssetCache::asset source(AssetCache::instance().load(img.path.c_str()));
+
+        std::unordered_set<uint32_t> found;
+        std::vector<uint32_t> colors;
+        uint32_t last(0);
+        for (size_t i(0); i < source->size(); i++)
+        {
+            uint32_t px(source->data()[i]);
+            if (!img.circular && rgba8_alpha(px) == 0)
+                continue;
+            px = rgba8(rgba8_color(px));
+            if ((colors.empty() || px != last) && found.insert(px).second)
+            {
+                if (colors.size() == CODE3C_ASSET_PALETTE)
+                    return {};
+                colors.push_back(px);
+            }
+            last = px;
+        }
+        return colors;
+    }
+
+    void DisplayList::replay(Drawer &drawer) const
+    {
+        replay(drawer, std::min(drawer.width() / (double) m_width,
+                                drawer.height() / (double) m_height));
+    }
+
+    void DisplayList::replay(Drawer &drawer, double scale) const
+    {
+        auto px = [scale](int v) -> int { return (int) std::lround(v * scale); };
+        bool identity(scale == 1.0);
+        std::vector<Slice> scaled;
+
+        for (const command& cmd : m_commands)
+        {
+            switch (cmd.kind)
+            {
+                case DL_BACKGROUND:
+                    drawer.background(cmd.color);
+                    break;
+                case DL_SLICES:
+                {
+                    std::span<const Slice> run(m_slices.data() + cmd.first, cmd.count);
+                    if (!identity)
+                    {
+                        scaled.clear();
+                        for (const Slice& s : run)
+                            scaled.push_back({px(s.x), px(s.y), px(s.radius),
+                                              s.degree, s.rotation});
+                        run = scaled;
+                    }
+                    drawer.fill_slices(cmd.color, run);
+                    break;
+                }
+                case DL_CIRCLE:
+                    drawer.foreground(cmd.color);
+                    drawer.fill_circle(px(cmd.args[0]), px(cmd.args[1]), px(cmd.args[2]));
+                    break;
+                case DL_LINE:
+                    drawer.foreground(cmd.color);
+                    drawer.draw_line(px(cmd.args[0]), px(cmd.args[1]),
+                                     px(cmd.args[2]), px(cmd.args[3]));
+                    break;
+                case DL_BLIT:
+                {
+                    AssetCache::asset map(loadImage(cmd.first, std::max(1, px(cmd.args[2])),
+                                                    std::max(1, px(cmd.args[3])),
+                                                    !drawer.antialiased()));
+                    drawer.blit(*map, px(cmd.args[0]), px(cmd.args[1]),
+                                {0, 0, drawer.width(), drawer.height()});
+                    break;
+                }
+            }
+        }
+    }
+}
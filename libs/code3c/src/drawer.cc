@@ -1,5 +1,7 @@
 #include "code3c/drawer.hh"
 
+#include <algorithm>
+
 namespace code3c
 {
     unsigned long rgb(int r, int g, int b)
@@ -51,11 +53,16 @@ namespace code3c
     
     Drawer::Drawer(const Drawer & drawer):
         m_data(drawer.m_data), m_width(drawer.m_width), m_height(drawer.m_height),
-        m_fps(drawer.m_fps),
+        m_fps(drawer.m_fps), m_retained(drawer.m_retained),
         key(0), keyCode(0), keys_pressed(0)
     {
     }
     
+    std::vector<uint32_t> Drawer::palette() const
+    {
+        return {};
+    }
+    
     uint64_t Drawer::hash() const
     {
         uint64_t hash(0);
@@ -130,6 +137,53 @@ namespace code3c
     {
         m_fps = fps;
     }
+
+    void Drawer::setRetained(bool retained)
+    {
+        m_retained = retained;
+        m_valid = false;
+    }
+
+    bool Drawer::retained() const
+    {
+        return m_retained;
+    }
+
+    void Drawer::invalidate()
+    {
+        m_valid = false;
+    }
+
+    void Drawer::record_frame(double millis)
+    {
+        if (m_frameTimes.size() < CODE3C_FRAME_STATS)
+            m_frameTimes.push_back(millis);
+        else
+            m_frameTimes[m_frames % CODE3C_FRAME_STATS] = millis;
+        m_frames++;
+    }
+
+    void Drawer::reset_frame_stats()
+    {
+        m_frameTimes.clear();
+        m_frames = 0;
+    }
+
+    FrameStats Drawer::frameStats() const
+    {
+        FrameStats stats{m_frames, 0, 0, 0};
+        if (m_frameTimes.empty())
+            return stats;
+
+        std::vector<double> sorted(m_frameTimes);
+        std::sort(sorted.begin(), sorted.end());
+        stats.min = sorted.front();
+        for (double millis : sorted)
+            stats.avg += millis;
+        stats.avg /= (double) sorted.size();
+        stats.p99 = sorted[std::min(sorted.size() - 1, (sorted.size() * 99 + 99) / 100 - 1)];
+        return stats;
+    }
     
     void Drawer::setDimension(int width, int height)
     {
@@ -137,15 +191,32 @@ namespace code3c
         this->setWidth(width);
     }
 
-    void Drawer::draw_pixelmap(const PixelMap &pixelMap, int x, int y)
+    void Drawer::fill_slices(unsigned long color, std::span<const Slice> slices)
+    {
+        foreground(color);
+        for (const Slice& slice : slices)
+            draw_slice(slice.x, slice.y, slice.radius, slice.degree, slice.rotation);
+    }
+
+    void Drawer::blit(const PixelMap &pixelMap, int x, int y, const Rect& clip)
     {
-        for (int px(0); px < pixelMap.width(); px++)
+        int x0(std::max({clip.x, 0, x})), y0(std::max({clip.y, 0, y}));
+        int x1(std::min({clip.x + clip.width, m_width, x + pixelMap.width()}));
+        int y1(std::min({clip.y + clip.height, m_height, y + pixelMap.height()}));
+        for (int py(y0); py < y1; py++)
         {
-            int xx(px+x);
-            for (int py(0); py < pixelMap.height(); py++)
+            std::span<const uint32_t> row(pixelMap.row(py - y));
+            for (int px(x0); px < x1; px++)
             {
-                draw_pixel(pixelMap[px, py].color, xx, py+y);
+                // No blending: mostly transparent pixels are left out
+                if (rgba8_alpha(row[px - x]) >= 0x80)
+                    draw_pixel(rgba8_color(row[px - x]), px, py);
             }
         }
     }
+
+    bool Drawer::antialiased() const
+    {
+        return false;
+    }
 }
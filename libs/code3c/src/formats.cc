@@ -0,0 +1,331 @@
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include "code3c/pixelmap.hh"
+
+namespace code3c
+{
+    namespace
+    {
+        constexpr size_t SINK_BUFFER = 1 << 16;
+
+        /**
+         * Buffered output to a file.
+         */
+        class file_sink
+        {
+            FILE* m_file;
+            uint8_t m_buffer[SINK_BUFFER];
+            size_t m_size = 0;
+        public:
+            explicit file_sink(FILE* file) : m_file(file) {}
+
+            void write(const void* data, size_t len)
+            {
+                if (m_size + len > SINK_BUFFER)
+                    flush();
+                if (len >= SINK_BUFFER)
+                {
+                    // Large blocks (e.g. whole rows) are written as they are
+                    if (fwrite(data, 1, len, m_file) != len)
+                        throw std::runtime_error("Unable to write image file");
+                    return;
+                }
+                std::memcpy(&m_buffer[m_size], data, len);
+                m_size += len;
+            }
+
+            inline void put(uint8_t byte)
+            {
+                if (m_size == SINK_BUFFER)
+                    flush();
+                m_buffer[m_size++] = byte;
+            }
+
+            void flush()
+            {
+                if (m_size && fwrite(m_buffer, 1, m_size, m_file) != m_size)
+                    throw std::runtime_error("Unable to write image file");
+                m_size = 0;
+            }
+        };
+
+        /**
+         * Output to a growable byte vector.
+         */
+        class vector_sink
+        {
+            std::vector<uint8_t>& m_out;
+        public:
+            explicit vector_sink(std::vector<uint8_t>& out) : m_out(out) {}
+
+            inline void write(const void* data, size_t len)
+            {
+                auto bytes = (const uint8_t*) data;
+                m_out.insert(m_out.end(), bytes, bytes + len);
+            }
+
+            inline void put(uint8_t byte)
+            { m_out.push_back(byte); }
+
+            void flush() {}
+        };
+
+        template<class Sink>
+        void write_header(Sink& sink, const char* format, int width, int height)
+        {
+            char header[128];
+            int len(snprintf(header, sizeof(header), format, width, height));
+            sink.write(header, len);
+        }
+
+        /**
+         * Rows of a PixelMap in memory.
+         */
+        class map_rows
+        {
+            const PixelMap& m_map;
+        public:
+            explicit map_rows(const PixelMap& map) : m_map(map) {}
+
+            inline std::span<const uint32_t> operator()(int y) const
+            { return m_map.row(y); }
+        };
+
+        /**
+         * Rows filled in order by a producer, in a single reusable buffer.
+         */
+        class produced_rows
+        {
+            const PixelMap::RowProducer& m_producer;
+            std::vector<uint32_t> m_row;
+        public:
+            produced_rows(const PixelMap::RowProducer& producer, int width) :
+                    m_producer(producer), m_row(width) {}
+
+            std::span<const uint32_t> operator()(int y)
+            {
+                m_producer(y, m_row);
+                return m_row;
+            }
+        };
+
+        /**
+         * PAM RGB_ALPHA has the memory layout of the pixel buffer: rows are
+         * written as they are.
+         */
+        template<class Rows, class Sink>
+        void write_pam(int width, int height, Rows& rows, Sink& sink)
+        {
+            write_header(sink, "P7\nWIDTH %d\nHEIGHT %d\nDEPTH 4\nMAXVAL 255\n"
+                               "TUPLTYPE RGB_ALPHA\nENDHDR\n",
+                         width, height);
+            for (int y(0); y < height; y++)
+                sink.write(rows(y).data(), (size_t) width * sizeof(uint32_t));
+            sink.flush();
+        }
+
+        template<class Rows, class Sink>
+        void write_ppm(int width, int height, Rows& rows, Sink& sink)
+        {
+            write_header(sink, "P6\n%d %d\n255\n", width, height);
+
+            // Alpha dropped, one reusable row buffer
+            std::vector<uint8_t> line((size_t) width * 3);
+            for (int y(0); y < height; y++)
+            {
+                auto src = (const uint8_t*) rows(y).data();
+                for (int x(0); x < width; x++)
+                {
+                    line[x*3]   = src[x*4];
+                    line[x*3+1] = src[x*4+1];
+                    line[x*3+2] = src[x*4+2];
+                }
+                sink.write(line.data(), line.size());
+            }
+            sink.flush();
+        }
+
+        /**
+         * QOI encoder (see https://qoiformat.org/qoi-specification.pdf).
+         */
+        template<class Rows, class Sink>
+        void write_qoi(int width, int height, Rows& rows, Sink& sink)
+        {
+            enum : uint8_t {
+                QOI_OP_INDEX = 0x00, QOI_OP_DIFF = 0x40, QOI_OP_LUMA = 0x80,
+                QOI_OP_RUN   = 0xc0, QOI_OP_RGB  = 0xfe, QOI_OP_RGBA = 0xff
+            };
+
+            uint8_t header[14] = {'q', 'o', 'i', 'f'};
+            for (int i(0); i < 4; i++)
+            {
+                header[4 + i] = (uint8_t) ((uint32_t) width >> (24 - 8*i));
+                header[8 + i] = (uint8_t) ((uint32_t) height >> (24 - 8*i));
+            }
+            header[12] = 4; // RGBA
+            header[13] = 0; // sRGB with linear alpha
+            sink.write(header, sizeof(header));
+
+            // Pixels compared as packed RGBA8, bytes read in memory order.
+            // Runs go on across rows.
+            uint32_t index[64] = {};
+            uint32_t prev(rgba8(0, 0xff));
+            int run(0);
+            for (int y(0); y < height; y++)
+            {
+                const uint32_t* px(rows(y).data());
+                for (int i(0); i < width; i++)
+                {
+                    uint32_t cur(px[i]);
+                    if (cur == prev)
+                    {
+                        if (++run == 62)
+                        {
+                            sink.put(QOI_OP_RUN | (run - 1));
+                            run = 0;
+                        }
+                        continue;
+                    }
+                    if (run > 0)
+                    {
+                        sink.put(QOI_OP_RUN | (run - 1));
+                        run = 0;
+                    }
+
+                    auto c = (const uint8_t*) &px[i];
+                    auto p = (const uint8_t*) &prev;
+                    int hash((c[0]*3 + c[1]*5 + c[2]*7 + c[3]*11) % 64);
+                    if (index[hash] == cur)
+                    {
+                        sink.put(QOI_OP_INDEX | hash);
+                    }
+                    else
+                    {
+                        index[hash] = cur;
+                        if (c[3] == p[3])
+                        {
+                            int8_t vr((int8_t) (c[0] - p[0]));
+                            int8_t vg((int8_t) (c[1] - p[1]));
+                            int8_t vb((int8_t) (c[2] - p[2]));
+                            int8_t vg_r((int8_t) (vr - vg)), vg_b((int8_t) (vb - vg));
+
+                            if (vr > -3 && vr < 2 && vg > -3 && vg < 2 && vb > -3 && vb < 2)
+                            {
+                                sink.put(QOI_OP_DIFF | (vr + 2) << 4 | (vg + 2) << 2 | (vb + 2));
+                            }
+                            else if (vg_r > -9 && vg_r < 8 && vg > -33 && vg < 32 &&
+                                     vg_b > -9 && vg_b < 8)
+                            {
+                                sink.put(QOI_OP_LUMA | (vg + 32));
+                                sink.put((vg_r + 8) << 4 | (vg_b + 8));
+                            }
+                            else
+                            {
+                                uint8_t op[4] = {QOI_OP_RGB, c[0], c[1], c[2]};
+                                sink.write(op, sizeof(op));
+                            }
+                        }
+                        else
+                        {
+                            uint8_t op[5] = {QOI_OP_RGBA, c[0], c[1], c[2], c[3]};
+                            sink.write(op, sizeof(op));
+                        }
+                    }
+                    prev = cur;
+                }
+            }
+            if (run > 0)
+                sink.put(QOI_OP_RUN | (run - 1));
+
+            static const uint8_t padding[8] = {0, 0, 0, 0, 0, 0, 0, 1};
+            sink.write(padding, sizeof(padding));
+            sink.flush();
+        }
+
+        template<class Rows, class Sink>
+        void write_image(int width, int height, Rows& rows, Sink& sink,
+                         PixelMap::Format format)
+        {
+            switch (format)
+            {
+                case PixelMap::FORMAT_PPM: write_ppm(width, height, rows, sink); break;
+                case PixelMap::FORMAT_PAM: write_pam(width, height, rows, sink); break;
+                case PixelMap::FORMAT_QOI: write_qoi(width, height, rows, sink); break;
+                default:
+                    throw std::runtime_error("Unsupported image format");
+            }
+        }
+    }
+
+    PixelMap::Format PixelMap::formatOf(const char *fname)
+    {
+        const char* ext(strrchr(fname, '.'));
+        if (!ext)
+            return FORMAT_PNG;
+
+        char lower[5] = {};
+        for (int i(0); i < 4 && ext[i + 1]; i++)
+            lower[i] = (char) tolower(ext[i + 1]);
+        if (strcmp(lower, "ppm") == 0)
+            return FORMAT_PPM;
+        if (strcmp(lower, "pam") == 0)
+            return FORMAT_PAM;
+        if (strcmp(lower, "qoi") == 0)
+            return FORMAT_QOI;
+        return FORMAT_PNG;
+    }
+
+    void PixelMap::save(const PixelMap &map, FILE *dest, Format format,
+                        const PNGOptions& opts)
+    {
+        if (format == FORMAT_PNG)
+        {
+            saveInPng(map, dest, opts);
+            return;
+        }
+        auto sink = std::make_unique<file_sink>(dest);
+        map_rows rows(map);
+        write_image(map.width(), map.height(), rows, *sink, format);
+    }
+
+    void PixelMap::save(const PixelMap &map, FILE *dest, Format format)
+    {
+        save(map, dest, format, PNGOptions());
+    }
+
+    void PixelMap::save(FILE *dest, int width, int height, Format format,
+                        const RowProducer &producer, const PNGOptions &opts)
+    {
+        if (format == FORMAT_PNG)
+        {
+            saveInPng(dest, width, height, producer, opts);
+            return;
+        }
+        auto sink = std::make_unique<file_sink>(dest);
+        produced_rows rows(producer, width);
+        write_image(width, height, rows, *sink, format);
+    }
+
+    std::vector<uint8_t> PixelMap::encode(const PixelMap &map, Format format,
+                                          const PNGOptions& opts)
+    {
+        if (format == FORMAT_PNG)
+            return encodePNG(map, opts);
+
+        std::vector<uint8_t> out;
+        // Raw size for PAM, a rough bound otherwise
+        out.reserve(map.size() * (format == FORMAT_PPM ? 3 : 4) + 128);
+        vector_sink sink(out);
+        map_rows rows(map);
+        write_image(map.width(), map.height(), rows, sink, format);
+        return out;
+    }
+
+    std::vector<uint8_t> PixelMap::encode(const PixelMap &map, Format format)
+    {
+        return encode(map, format, PNGOptions());
+    }
+}
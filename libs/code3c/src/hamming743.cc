@@ -5,18 +5,13 @@ namespace code3c
 {
 #pragma clang diagnostic push
 #pragma ide diagnostic ignored "modernize-use-bool-literals"
+    // Both codes must satisfy H*G = 0, checked at compile-time
+    static_assert(Hamming743::H743 * Hamming743::G743 == fixed_mat<bool, 3, 4>());
+    static_assert(Hamming313::H313 * Hamming313::G313 == fixed_mat<bool, 2, 1>());
+
     const matbase2& Hamming743::G_()
     {
-        static matbase2 _G(7, 4, new bool*[7] { /* NOLINT */
-            new bool[4] {1, 1, 0, 1},
-            new bool[4] {1, 0, 1, 1},
-            new bool[4] {1, 0, 0, 0},
-            new bool[4] {0, 1, 1, 1},
-            new bool[4] {0, 1, 0, 0},
-            new bool[4] {0, 0, 1, 0},
-            new bool[4] {0, 0, 0, 1}
-        });
-
+        static const matbase2 _G(G743);
         return _G;
     }
 
@@ -27,12 +22,7 @@ namespace code3c
 
     const matbase2& Hamming743::H_()
     {
-        static matbase2 _H(3, 7, new bool*[3] { /* NOLINT */
-            new bool[7] {0, 0, 0, 1, 1, 1, 1},
-            new bool[7] {0, 1, 1, 0, 0, 1, 1},
-            new bool[7] {1, 0, 1, 0, 1, 0, 1}
-        });
-
+        static const matbase2 _H(H743);
         return _H;
     }
 
@@ -43,12 +33,7 @@ namespace code3c
 
     const matbase2& Hamming313::G_()
     {
-        static matbase2 _G(3, 1, new bool*[3] { /* NOLINT */
-            new bool(1),
-            new bool(1),
-            new bool(1)
-        });
-
+        static const matbase2 _G(G313);
         return _G;
     }
 
@@ -59,11 +44,7 @@ namespace code3c
 
     const matbase2& Hamming313::H_()
     {
-        static matbase2 _H(2, 3, new bool*[2] { /* NOLINT */
-            new bool[3] {0,1,1},
-            new bool[3] {1,0,1}
-        });
-
+        static const matbase2 _H(H313);
         return _H;
     }
 
@@ -144,11 +125,9 @@ namespace code3c
             m_hword(0), m_matb(hamm.G().n(), 1), m_g(hamm.G()), m_h(hamm.H()) {}
 
     Hamming::hword::hword(hword_t x, const Hamming& hamm):
-            m_hword(0), m_matb(hamm.G().n(), 1), m_g(hamm.G()), m_h(hamm.H())
+            m_hword(hamm.codeword(x)), m_matb(wtom(m_hword, hamm.dim_n())),
+            m_g(hamm.G()), m_h(hamm.H())
     {
-        matbase2 xmatb(wtom(x, hamm.G().m()));
-        m_matb = m_g*xmatb;
-        m_hword = mtow(m_matb);
     }
 
     Hamming::hword::hword(hword_t x, hword_t p, const Hamming& hamm):
@@ -232,6 +211,11 @@ namespace code3c
         return !operator==(_hword);
     }
 
+    Hamming::hword::hword_t Hamming::codeword(hword::hword_t x) const
+    {
+        return hword::mtow(G() * hword::wtom(x, dim_k()));
+    }
+
     Hamming::Hamming(): m_hwordsl(0), m_hwords(nullptr)
     {
     }
@@ -604,6 +604,10 @@ namespace code3c
 
     HuffmanTable* HTFile::fromFile(const char *fname)
     {
+        std::span<const uint8_t> embedded(resource_data(fname));
+        if (!embedded.empty())
+            return fromBuffer((const char*) embedded.data(), embedded.size());
+
         std::FILE* file = std::fopen(fname, "rb");
         if (file)
         {
@@ -635,4 +639,16 @@ namespace code3c
     {
         return HTFile(table).write(_out_len);
     }
-}
\ No newline at end of file
+
+    HuffmanTable* code3c_default_htf(unsigned huffmodel)
+    {
+        static HuffmanTable* const tables[5] {
+            nullptr,
+            HTFile::fromFile(C3CRC("en_EN.htf")),
+            HTFile::fromFile(C3CRC("fr_FR.htf")),
+            nullptr,
+            nullptr
+        };
+        return huffmodel < 5 ? tables[huffmodel] : nullptr;
+    }
+}
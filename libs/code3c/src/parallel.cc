@@ -0,0 +1,169 @@
+#include "code3c/parallel.hh"
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+namespace code3c
+{
+    unsigned parallel_workers()
+    {
+        static const unsigned workers(std::max(1u, std::thread::hardware_concurrency()));
+        return workers;
+    }
+
+    void parallel_for(int begin, int end, int grain,
+                      const std::function<void(int, int)>& fn)
+    {
+        int count(end - begin);
+        if (count <= 0)
+            return;
+        if (grain < 1)
+            grain = 1;
+
+        int bands(std::min<int>((int) parallel_workers(), count / grain));
+        if (bands <= 1)
+        {
+            fn(begin, end);
+            return;
+        }
+
+        WorkPool::instance().run(bands, [begin, count, bands, &fn](int i) {
+            fn(begin + (int) ((long) count * i / bands),
+               begin + (int) ((long) count * (i+1) / bands));
+        });
+    }
+
+    WorkPool::WorkPool(unsigned threads):
+            m_pending(0), m_stop(false)
+    {
+        for (unsigned i(0); i < std::max(1u, threads); i++)
+            m_queues.push_back(std::make_unique<queue>());
+        for (unsigned i(0); i < threads; i++)
+            m_threads.emplace_back(&WorkPool::work, this, (size_t) i);
+    }
+
+    WorkPool::~WorkPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stop = true;
+        }
+        m_wake.notify_all();
+        for (std::thread& thread : m_threads)
+            thread.join();
+    }
+
+    WorkPool& WorkPool::instance()
+    {
+        static WorkPool pool(parallel_workers() - 1);
+        return pool;
+    }
+
+    bool WorkPool::pop(size_t q, item &it)
+    {
+        std::lock_guard<std::mutex> lock(m_queues[q]->mutex);
+        if (m_queues[q]->items.empty())
+            return false;
+        it = std::move(m_queues[q]->items.front());
+        m_queues[q]->items.pop_front();
+        m_pending--;
+        return true;
+    }
+
+    bool WorkPool::steal(size_t q, item &it)
+    {
+        for (size_t i(1); i <= m_queues.size(); i++)
+        {
+            queue& victim(*m_queues[(q + i) % m_queues.size()]);
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            if (!victim.items.empty())
+            {
+                it = std::move(victim.items.back());
+                victim.items.pop_back();
+                m_pending--;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void WorkPool::execute(item &it)
+    {
+        batch_state& batch(*it.batch);
+        try
+        {
+            batch.task(it.index);
+        }
+        catch (...)
+        {
+            std::lock_guard<std::mutex> lock(batch.mutex);
+            if (!batch.error)
+                batch.error = std::current_exception();
+        }
+        if (--batch.remaining == 0)
+        {
+            std::lock_guard<std::mutex> lock(batch.mutex);
+            batch.done.notify_all();
+        }
+        it.batch.reset();
+    }
+
+    void WorkPool::work(size_t q)
+    {
+        item it;
+        while (true)
+        {
+            if (pop(q, it) || steal(q, it))
+            {
+                execute(it);
+                continue;
+            }
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_wake.wait(lock, [this]() { return m_stop || m_pending > 0; });
+            if (m_stop)
+                return;
+        }
+    }
+
+    WorkPool::Batch WorkPool::submit(int count, Task task)
+    {
+        auto batch(std::make_shared<batch_state>());
+        batch->task = std::move(task);
+        batch->remaining = std::max(count, 0);
+        if (count <= 0)
+            return batch;
+
+        // Contiguous ranges, one per queue
+        size_t queues(m_queues.size());
+        for (size_t q(0); q < queues; q++)
+        {
+            int i0((int) ((long) count * q / queues)), i1((int) ((long) count * (q+1) / queues));
+            std::lock_guard<std::mutex> lock(m_queues[q]->mutex);
+            for (int i(i0); i < i1; i++)
+                m_queues[q]->items.push_back({batch, i});
+        }
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_pending += count;
+        }
+        m_wake.notify_all();
+        return batch;
+    }
+
+    void WorkPool::wait(const Batch &batch)
+    {
+        item it;
+        while (batch->remaining > 0)
+        {
+            if (steal(0, it))
+            {
+                execute(it);
+                continue;
+            }
+            std::unique_lock<std::mutex> lock(batch->mutex);
+            batch->done.wait(lock, [&batch]() { return batch->remaining == 0; });
+        }
+        if (batch->error)
+            std::rethrow_exception(batch->error);
+    }
+}
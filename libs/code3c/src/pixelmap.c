@@ -12,33 +12,66 @@ png_descp open_png(FILE* filepng)
 }
 
 png_descp read_png(FILE* fin)
+{
+    png_descp desc = read_png_info(fin);
+    if (!desc)
+        return NULL;
+    
+    // Row pointers and pixels share a single allocation
+    size_t rowbytes = png_get_rowbytes(desc->png, desc->info);
+    size_t offset = sizeof(png_bytep) * desc->height;
+    png_bytep block = (png_bytep) malloc(offset + rowbytes * desc->height);
+    if (!block) {
+        free_png_desc(desc);
+        return NULL;
+    }
+    desc->rows = (png_bytepp) block;
+    
+    if (read_png_image(desc, block + offset, rowbytes) != 0) {
+        free_png_desc(desc);
+        return NULL;
+    }
+    return desc;
+}
+
+png_descp read_png_info(FILE* fin)
+{
+    return read_png_info_io(fin, NULL);
+}
+
+png_descp read_png_info_io(FILE* fin, const png_io* io)
 {
     png_desc* desc = (png_descp) malloc(sizeof(png_desc));
+    if (!desc)
+        return NULL;
+    desc->_file = fin;
+    desc->mode = PNG_DESC_MODE_READ;
+    desc->rows = NULL;
+    
     desc->png = png_create_read_struct(
             PNG_LIBPNG_VER_STRING, NULL, NULL, NULL
             );
-    
     if (!desc->png) {
-        desc->png = NULL;
         free(desc);
         return NULL;
     }
     
-    desc->_file = fin;
-    desc->mode = PNG_DESC_MODE_READ;
-    
     desc->info = png_create_info_struct(desc->png);
     if (!desc->info) {
+        png_destroy_read_struct(&desc->png, NULL, NULL);
         free(desc);
         return NULL;
     }
     
     if (setjmp(png_jmpbuf(desc->png))) {
-        free(desc);
+        free_png_desc(desc);
         return NULL;
     }
     
-    png_init_io(desc->png, fin);
+    if (io)
+        png_set_read_fn(desc->png, io->user, io->rw);
+    else
+        png_init_io(desc->png, fin);
     png_read_info(desc->png, desc->info);
     
     desc->width      = png_get_image_width(desc->png, desc->info);
@@ -68,21 +101,37 @@ png_descp read_png(FILE* fin)
         png_set_gray_to_rgb(desc->png);
     
     png_read_update_info(desc->png, desc->info);
+    return desc;
+}
+
+int read_png_image(png_descp desc, png_bytep dest, size_t stride)
+{
+    // Point the rows into the destination buffer, reusing desc->rows if the
+    // pointers are already allocated (see read_png). Volatile: still read
+    // after a longjmp
+    png_bytepp volatile rows = desc->rows;
+    if (!rows && !(rows = (png_bytepp) malloc(sizeof(png_bytep) * desc->height)))
+        return -1;
+    for (int y = 0; y < desc->height; y++)
+        rows[y] = dest + stride * y;
     
-    // Read image
-    desc->rows = (png_bytepp) malloc(sizeof(png_bytep)*desc->height);
-    if (!desc->rows) {
-        free(desc);
-        return NULL;
+    if (setjmp(png_jmpbuf(desc->png))) {
+        if (rows != desc->rows)
+            free(rows);
+        return -1;
     }
-    for (int y = 0; y < desc->height; y++)
-        desc->rows[y] = (png_bytep) malloc(png_get_rowbytes(desc->png, desc->info));
-    png_read_image(desc->png, desc->rows);
     
-    return desc;
+    png_read_image(desc->png, rows);
+    png_read_end(desc->png, NULL);
+    
+    if (rows != desc->rows)
+        free(rows);
+    return 0;
 }
 
-png_descp create_png(FILE* fio, int width, int height)
+static png_descp create_png_desc(FILE* fio, const png_io* io, int width, int height,
+                                 int bit_depth, int color_type,
+                                 const png_write_opts* opts)
 {
     // Create descriptor
     png_descp desc = (png_descp) malloc(sizeof(png_desc));
@@ -90,6 +139,11 @@ png_descp create_png(FILE* fio, int width, int height)
         return NULL;
     desc->_file = fio;
     desc->mode = PNG_DESC_MODE_WRITE;
+    desc->width = width;
+    desc->height = height;
+    desc->bit_depth = bit_depth;
+    desc->color_type = color_type;
+    desc->rows = NULL;
     
     // Create png struct
     desc->png = png_create_write_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
@@ -106,25 +160,126 @@ png_descp create_png(FILE* fio, int width, int height)
     }
     
     if (setjmp(png_jmpbuf(desc->png))) {
-        free(desc);
+        free_png_desc(desc);
         return NULL;
     }
     
-    png_init_io(desc->png, fio);
+    if (io)
+        png_set_write_fn(desc->png, io->user, io->rw, io->flush);
+    else
+        png_init_io(desc->png, fio);
+    if (opts)
+    {
+        if (opts->compression_level >= 0)
+            png_set_compression_level(desc->png, opts->compression_level);
+        if (opts->strategy >= 0)
+            png_set_compression_strategy(desc->png, opts->strategy);
+        if (opts->filters)
+            png_set_filter(desc->png, PNG_FILTER_TYPE_BASE, opts->filters);
+    }
     png_set_IHDR(
             desc->png,
             desc->info,
-            width, height, 8,    // width, height, depth
-            PNG_COLOR_TYPE_RGBA, // Support alpha
+            width, height, bit_depth,
+            color_type,
             PNG_INTERLACE_NONE,
             PNG_COMPRESSION_TYPE_DEFAULT,
             PNG_FILTER_TYPE_DEFAULT
             );
-    png_write_info(desc->png, desc->info);
     
     return desc;
 }
 
+png_descp create_png(FILE* fio, int width, int height)
+{
+    return create_png_rgba(fio, width, height, NULL);
+}
+
+png_descp create_png_rgba(FILE* fio, int width, int height,
+                          const png_write_opts* opts)
+{
+    return create_png_rgba_io(fio, NULL, width, height, opts);
+}
+
+png_descp create_png_rgba_io(FILE* fio, const png_io* io, int width, int height,
+                             const png_write_opts* opts)
+{
+    png_descp desc = create_png_desc(fio, io, width, height, 8, // Support alpha
+                                     PNG_COLOR_TYPE_RGBA, opts);
+    if (desc)
+    {
+        if (setjmp(png_jmpbuf(desc->png))) {
+            free_png_desc(desc);
+            return NULL;
+        }
+        png_write_info(desc->png, desc->info);
+    }
+    return desc;
+}
+
+png_descp create_png_indexed(FILE* fio, int width, int height, int bit_depth,
+                             const png_color* palette, const png_byte* alpha,
+                             int npalette, const png_write_opts* opts)
+{
+    return create_png_indexed_io(fio, NULL, width, height, bit_depth,
+                                 palette, alpha, npalette, opts);
+}
+
+png_descp create_png_indexed_io(FILE* fio, const png_io* io, int width, int height,
+                                int bit_depth, const png_color* palette,
+                                const png_byte* alpha, int npalette,
+                                const png_write_opts* opts)
+{
+    png_descp desc = create_png_desc(fio, io, width, height, bit_depth,
+                                     PNG_COLOR_TYPE_PALETTE, opts);
+    if (desc)
+    {
+        if (setjmp(png_jmpbuf(desc->png))) {
+            free_png_desc(desc);
+            return NULL;
+        }
+        png_set_PLTE(desc->png, desc->info, palette, npalette);
+        if (alpha)
+        {
+            // Only keep the alpha entries up to the last translucent colour
+            int ntrans = npalette;
+            while (ntrans > 0 && alpha[ntrans-1] == 0xff)
+                ntrans--;
+            if (ntrans > 0)
+                png_set_tRNS(desc->png, desc->info, alpha, ntrans, NULL);
+        }
+        png_write_info(desc->png, desc->info);
+    }
+    return desc;
+}
+
+int write_png_rows(png_descp desc, png_row_producer producer, void* user)
+{
+    png_bytep row = (png_bytep) malloc(png_get_rowbytes(desc->png, desc->info));
+    if (!row)
+        return -1;
+    
+    if (setjmp(png_jmpbuf(desc->png))) {
+        free(row);
+        return -1;
+    }
+    
+    for (int y = 0; y < desc->height; y++)
+    {
+        png_const_bytep data = producer(y, row, user);
+        if (!data) {
+            free(row);
+            return -1;
+        }
+        png_write_row(desc->png, data);
+    }
+    
+    png_write_end(desc->png, NULL);
+    png_write_flush(desc->png);
+    free(row);
+    return 0;
+}
+
 void free_png_desc(png_descp desc)
 {
     // Close png handlers
@@ -136,5 +291,6 @@ void free_png_desc(png_descp desc)
             png_destroy_write_struct(&desc->png, &desc->info);
     }
     
+    free(desc->rows);
     free(desc);
 }
\ No newline at end of file
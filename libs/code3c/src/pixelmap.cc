@@ -1,28 +1,32 @@
 #include <stdexcept>
+#include <cstring>
+#include <algorithm>
+#include <exception>
+#include <vector>
 #include "code3c/pixelmap.hh"
 
 namespace code3c
 {
     PixelMap::PixelMap(int width, int height):
         m_width(width), m_height(height), m_size(width*height),
-        m_pixels(new Pixel[width*height])
+        m_pixels(new uint32_t[width*height]())
     {
-        for (int y(0); y < height; y++)
-        {
-            int _off_i(y*width);
-            for (int x(0); x < width; x++)
-            {
-                m_pixels[_off_i+x] = {x, y, 0};
-            }
-        }
     }
     
     PixelMap::PixelMap(const PixelMap &map):
         m_width(map.m_width), m_height(map.m_height), m_size(map.m_size),
-        m_pixels(new Pixel[map.m_size])
+        m_pixels(new uint32_t[map.m_size])
+    {
+        std::memcpy(m_pixels, map.m_pixels, m_size * sizeof(uint32_t));
+    }
+
+    PixelMap::PixelMap(PixelMap &&map) noexcept:
+        m_width(map.m_width), m_height(map.m_height), m_size(map.m_size),
+        m_pixels(map.m_pixels)
     {
-        for (uint32_t i(0); i < map.size(); i++)
-            m_pixels[i] = map.m_pixels[i];
+        map.m_width = map.m_height = 0;
+        map.m_size = 0;
+        map.m_pixels = nullptr;
     }
     
     PixelMap::~PixelMap()
@@ -45,122 +49,470 @@ namespace code3c
         return m_size;
     }
     
-    PixelMap PixelMap::resize(float scale) const
+    PixelMap PixelMap::resize(float scale, Filter filter) const
     {
         return resize(static_cast<int>(width()*scale),
-               static_cast<int>(height()*scale));
+               static_cast<int>(height()*scale), filter);
     }
     
-    PixelMap PixelMap::resize(int width, int height) const
+    PixelMap& PixelMap::operator=(const PixelMap &map)
     {
-        if (width <= 0)
-            width = this->width();
-        if (height <= 0)
-            height = this->height();
-        
-        PixelMap pixelMap(width, height);
-        for (int x = 0; x < width; x++)
+        if (this == &map)
+            return *this;
+
+        if (m_size != map.m_size)
         {
-            int srcX = (x*m_width)/width;
-            for (int y = 0; y < height; y++)
-            {
-                int srcY = (y*m_height)/height;
-                Pixel pixelSrc = (*this)[srcX, srcY];
-                pixelMap[x,y] = pixelSrc;
-            }
+            delete[] m_pixels;
+            m_pixels = new uint32_t[map.m_size];
         }
-        
-        return pixelMap;
-    }
-    
-    PixelMap& PixelMap::operator=(const PixelMap &map)
-    {
+
         m_width  = map.m_width;
-        m_height = map.m_width;
+        m_height = map.m_height;
         m_size   = map.m_size;
+        std::memcpy(m_pixels, map.m_pixels, m_size * sizeof(uint32_t));
         
-        delete[] m_pixels;
-        m_pixels = new Pixel[m_size];
-        
-        for (uint32_t i(0); i < m_size; i++)
-            m_pixels[i] = map.m_pixels[i];
-        
+        return *this;
+    }
+
+    PixelMap& PixelMap::operator=(PixelMap &&map) noexcept
+    {
+        if (this != &map)
+        {
+            delete[] m_pixels;
+            m_width  = map.m_width;
+            m_height = map.m_height;
+            m_size   = map.m_size;
+            m_pixels = map.m_pixels;
+
+            map.m_width = map.m_height = 0;
+            map.m_size = 0;
+            map.m_pixels = nullptr;
+        }
         return *this;
     }
     
-    Pixel& PixelMap::operator[](int i)
+    PixelMap::reference PixelMap::operator[](int i)
     {
-        return m_pixels[i];
+        return {m_pixels[i], i % m_width, i / m_width};
     }
     
-    Pixel& PixelMap::operator[](int x, int y)
+    PixelMap::reference PixelMap::operator[](int x, int y)
     {
-        return m_pixels[y*width()+x];
+        return {m_pixels[y*width()+x], x, y};
     }
     
     Pixel PixelMap::operator[](int i) const
     {
-        return m_pixels[i];
+        return {i % m_width, i / m_width,
+                rgba8_color(m_pixels[i]), rgba8_alpha(m_pixels[i])};
     }
     
     Pixel PixelMap::operator[](int x, int y) const
     {
-        return m_pixels[y*width()+x];
+        uint32_t px(m_pixels[y*width()+x]);
+        return {x, y, rgba8_color(px), rgba8_alpha(px)};
     }
     
+    namespace
+    {
+        /**
+         * Read the image of a descriptor opened with read_png_info() and
+         * release the descriptor.
+         */
+        PixelMap read_pixelmap(png_descp desc)
+        {
+            // Rows are expanded to RGBA8 by libpng and read straight into the
+            // pixel buffer, which has the same layout
+            PixelMap pixelMap(desc->width, desc->height);
+            int status(read_png_image(desc, (png_bytep) pixelMap.data(),
+                                      desc->width * sizeof(uint32_t)));
+            free_png_desc(desc);
+            if (status != 0)
+                throw std::runtime_error("Unable to read png image");
+            return pixelMap;
+        }
+
+        /**
+         * Reads png data from a memory span.
+         */
+        struct span_source
+        {
+            std::span<const uint8_t> data;
+            size_t offset;
+
+            static void read(png_structp png, png_bytep out, png_size_t len)
+            {
+                auto self = (span_source*) png_get_io_ptr(png);
+                if (len > self->data.size() - self->offset)
+                    png_error(png, "Truncated png data");
+                std::memcpy(out, self->data.data() + self->offset, len);
+                self->offset += len;
+            }
+        };
+
+        /**
+         * Appends png data to a growable vector.
+         */
+        struct vector_sink
+        {
+            std::vector<uint8_t>* out;
+
+            static void write(png_structp png, png_bytep data, png_size_t len)
+            {
+                auto self = (vector_sink*) png_get_io_ptr(png);
+                bool failed(false);
+                try
+                {
+                    self->out->insert(self->out->end(), data, data + len);
+                }
+                catch (const std::bad_alloc&)
+                {
+                    failed = true;
+                }
+                if (failed)
+                    png_error(png, "Out of memory");
+            }
+
+            static void flush(png_structp) {}
+        };
+
+        /**
+         * Writes png data into a caller-provided buffer.
+         */
+        struct span_sink
+        {
+            std::span<uint8_t> buffer;
+            size_t size;
+            bool overflow;
+
+            static void write(png_structp png, png_bytep data, png_size_t len)
+            {
+                auto self = (span_sink*) png_get_io_ptr(png);
+                if (len > self->buffer.size() - self->size)
+                {
+                    self->overflow = true;
+                    png_error(png, "Png buffer too small");
+                }
+                std::memcpy(self->buffer.data() + self->size, data, len);
+                self->size += len;
+            }
+
+            static void flush(png_structp) {}
+        };
+    }
+
     PixelMap PixelMap::loadFromPNG(const char *pngfile) noexcept(false)
     {
-        png_descp desc = open_png(fopen(pngfile, "rb"));
+        std::span<const uint8_t> embedded(resource_data(pngfile));
+        if (!embedded.empty())
+            return decodePNG(embedded);
+
+        FILE* file = fopen(pngfile, "rb");
+        png_descp desc = file ? read_png_info(file) : nullptr;
         if (!desc)
+        {
+            if (file) fclose(file);
             throw std::runtime_error("Unable to load png file");
+        }
         
-        PixelMap pixelMap(desc->width, desc->height);
-        for (int y = 0; y < desc->height; y++)
+        try
         {
-            for (int x = 0, i = 0; x < desc->width; x++, i+=4)
-            {
-                int r = 0xff & desc->rows[y][i];
-                int g = 0xff & desc->rows[y][i+1];
-                int b = 0xff & desc->rows[y][i+2];
-                png_byte a = 0xff & desc->rows[y][i+3];
-                unsigned long rgb = (r << 16) | (g << 8) | b;
-                pixelMap[x,y] = {x, y, rgb, a};
-            }
+            PixelMap pixelMap(read_pixelmap(desc));
+            fclose(file);
+            return pixelMap;
+        }
+        catch (...)
+        {
+            fclose(file);
+            throw;
         }
-        
-        free_png_desc(desc);
-        return pixelMap;
     }
     
-    void PixelMap::saveInPng(const PixelMap &map, FILE *dest)
+    PixelMap PixelMap::decodePNG(std::span<const uint8_t> data) noexcept(false)
     {
-        png_descp desc = create_png(dest, map.width(), map.height());
-        if (desc)
+        span_source source{data, 0};
+        png_io io{&source, span_source::read, nullptr};
+        png_descp desc = read_png_info_io(nullptr, &io);
+        if (!desc)
+            throw std::runtime_error("Unable to decode png data");
+        return read_pixelmap(desc);
+    }
+    
+    namespace
+    {
+        /**
+         * Palette of up to 256 packed RGBA8 colours, with a small open
+         * addressing hash table for the colour lookups.
+         */
+        class png_palette
+        {
+            static constexpr int SLOTS = 1024;
+
+            uint32_t m_keys[SLOTS];
+            int16_t  m_index[SLOTS];
+            uint32_t m_colors[256];
+            int m_count = 0;
+            uint32_t m_last = 0;
+            int m_lastIndex = -1;
+
+            static inline int slot_of(uint32_t px)
+            { return (int) ((px * 2654435761u) >> 22); }
+
+            inline int slot(uint32_t px) const
+            {
+                int slot(slot_of(px));
+                while (m_index[slot] >= 0 && m_keys[slot] != px)
+                    slot = (slot + 1) % SLOTS;
+                return slot;
+            }
+        public:
+            png_palette() { std::fill(std::begin(m_index), std::end(m_index), -1); }
+
+            /**
+             * @return the palette index of the colour (added if needed), or -1
+             * if the palette is full
+             */
+            int insert(uint32_t px)
+            {
+                int i(find(px));
+                if (i < 0 && m_count < 256)
+                {
+                    int s(slot(px));
+                    m_keys[s] = px;
+                    m_index[s] = (int16_t) m_count;
+                    m_colors[m_count] = px;
+                    i = m_count++;
+                }
+                return i;
+            }
+
+            /**
+             * @return the palette index of the colour, or -1 if missing
+             */
+            int find(uint32_t px)
+            {
+                if (m_lastIndex >= 0 && px == m_last)
+                    return m_lastIndex;
+
+                int i(m_index[slot(px)]);
+                if (i >= 0)
+                {
+                    m_last = px;
+                    m_lastIndex = i;
+                }
+                return i;
+            }
+
+            inline int size() const { return m_count; }
+            inline uint32_t operator[](int i) const { return m_colors[i]; }
+
+            /**
+             * @return the smallest png bit depth able to index the palette
+             */
+            int bit_depth() const
+            {
+                return m_count <= 2 ? 1 : m_count <= 4 ? 2 : m_count <= 16 ? 4 : 8;
+            }
+        };
+
+        /**
+         * Adapts a C++ row callback to write_png_rows(), keeping the first
+         * exception thrown to rethrow it once libpng is released.
+         */
+        struct row_writer
         {
-            auto buffer_rows = (png_bytepp) malloc(sizeof(png_bytep)*map.height());
-            for (int y = 0; y < map.height(); y++)
-                buffer_rows[y] = (png_bytep) malloc(sizeof(png_byte)*4*map.width());
-            
-            for (int y = 0; y < map.width(); y++)
+            std::function<png_const_bytep(int, png_bytep)> produce;
+            std::exception_ptr error;
+
+            static png_const_bytep call(int y, png_bytep row, void* user)
             {
-                for (int x = 0, i = 0; x < map.height(); x++, i+=4)
+                auto self = (row_writer*) user;
+                try
+                {
+                    return self->produce(y, row);
+                }
+                catch (...)
                 {
-                    buffer_rows[y][i+0] = (map[x,y].color & 0xff0000) >> 16; // red
-                    buffer_rows[y][i+1] = (map[x,y].color & 0x00ff00) >>  8; // green
-                    buffer_rows[y][i+2] = (map[x,y].color & 0x0000ff) >>  0; // blue
-                    buffer_rows[y][i+3]   = map[x,y].alpha; // alpha
+                    self->error = std::current_exception();
+                    return nullptr;
                 }
             }
-            
-            png_write_image(desc->png, buffer_rows);
-            png_write_end(desc->png, NULL);
-            png_write_flush(desc->png);
-            
-            // Free memory and close handlers
-            for (int y = 0; y < map.height(); y++)
-                free(buffer_rows[y]);
-            free(buffer_rows);
+        };
+
+        void write_rows(png_descp desc,
+                        std::function<png_const_bytep(int, png_bytep)> produce)
+        {
+            if (!desc)
+                throw std::runtime_error("Unable to create png file");
+
+            row_writer writer{std::move(produce), nullptr};
+            int status(write_png_rows(desc, row_writer::call, &writer));
             free_png_desc(desc);
+
+            if (writer.error)
+                std::rethrow_exception(writer.error);
+            if (status != 0)
+                throw std::runtime_error("Unable to write png file");
+        }
+
+        void save_rgba(FILE *dest, const png_io* io, int width, int height,
+                       const png_write_opts* opts,
+                       std::function<png_const_bytep(int, png_bytep)> produce)
+        {
+            write_rows(create_png_rgba_io(dest, io, width, height, opts),
+                       std::move(produce));
+        }
+
+        /**
+         * @param source returns the RGBA8 pixels of the row <code>y</code>
+         */
+        void save_indexed(FILE *dest, const png_io* io, int width, int height,
+                          png_palette& palette,
+                          const png_write_opts* opts,
+                          std::function<const uint32_t*(int)> source)
+        {
+            png_color colors[256];
+            png_byte alpha[256];
+            bool opaque(true);
+            for (int i(0); i < palette.size(); i++)
+            {
+                unsigned long color(rgba8_color(palette[i]));
+                colors[i] = {(png_byte) (color >> 16), (png_byte) (color >> 8),
+                             (png_byte) color};
+                alpha[i] = rgba8_alpha(palette[i]);
+                opaque &= alpha[i] == 0xff;
+            }
+
+            int bit_depth(palette.bit_depth());
+            png_descp desc = create_png_indexed_io(dest, io, width, height,
+                                                   bit_depth, colors,
+                                                   opaque ? nullptr : alpha,
+                                                   palette.size(), opts);
+
+            // Pack each row (MSB first) in the reusable png row buffer
+            int ppb(8 / bit_depth);
+            size_t rowbytes((width * bit_depth + 7) / 8);
+            write_rows(desc, [&](int y, png_bytep row) -> png_const_bytep {
+                const uint32_t* pixels(source(y));
+                std::memset(row, 0, rowbytes);
+                for (int x = 0; x < width; x++)
+                {
+                    int index(palette.find(pixels[x]));
+                    if (index < 0)
+                        throw std::runtime_error("Colour missing from the png palette");
+                    int shift(8 - bit_depth * (x % ppb + 1));
+                    row[x / ppb] |= (png_byte) (index << shift);
+                }
+                return row;
+            });
+        }
+
+        /**
+         * Save a whole image, indexed when the colours allow it.
+         */
+        void save_pixelmap(const PixelMap &map, FILE *dest, const png_io* io,
+                           const PixelMap::PNGOptions& opts)
+        {
+            if (opts.indexed)
+            {
+                // Collect the palette, giving up as soon as it exceeds 256 colours
+                png_palette palette;
+                bool indexed(true);
+                for (uint32_t px : opts.palette)
+                    indexed &= palette.insert(px) >= 0;
+                for (uint32_t i(0); indexed && i < map.size(); i++)
+                    indexed = palette.insert(map.data()[i]) >= 0;
+
+                if (indexed)
+                {
+                    save_indexed(dest, io, map.width(), map.height(), palette,
+                                 &opts.zlib,
+                                 [&](int y) { return map.row(y).data(); });
+                    return;
+                }
+            }
+
+            // Rows are directly handed from the pixel buffer to libpng
+            save_rgba(dest, io, map.width(), map.height(), &opts.zlib,
+                      [&](int y, png_bytep) {
+                return (png_const_bytep) map.row(y).data();
+            });
+        }
+    }
+
+    void PixelMap::saveInPng(const PixelMap &map, FILE *dest, const PNGOptions& opts)
+    {
+        save_pixelmap(map, dest, nullptr, opts);
+    }
+
+    void PixelMap::saveInPng(const PixelMap &map, FILE *dest)
+    {
+        saveInPng(map, dest, PNGOptions());
+    }
+
+    void PixelMap::saveInPng(FILE *dest, int width, int height,
+                             const RowProducer& producer, const PNGOptions& opts)
+    {
+        if (opts.indexed && !opts.palette.empty())
+        {
+            png_palette palette;
+            for (uint32_t px : opts.palette)
+                if (palette.insert(px) < 0)
+                    throw std::runtime_error("Png palette exceeds 256 colours");
+
+            std::vector<uint32_t> line(width);
+            save_indexed(dest, nullptr, width, height, palette, &opts.zlib,
+                         [&](int y) {
+                producer(y, line);
+                return line.data();
+            });
+        }
+        else
+        {
+            // Rows are rendered in place in the png row buffer
+            save_rgba(dest, nullptr, width, height, &opts.zlib,
+                      [&](int y, png_bytep row) {
+                producer(y, std::span<uint32_t>((uint32_t*) row, width));
+                return (png_const_bytep) row;
+            });
+        }
+    }
+
+    void PixelMap::saveInPng(FILE *dest, int width, int height,
+                             const RowProducer& producer)
+    {
+        saveInPng(dest, width, height, producer, PNGOptions());
+    }
+
+    std::vector<uint8_t> PixelMap::encodePNG(const PixelMap &map, const PNGOptions& opts)
+    {
+        std::vector<uint8_t> out;
+        vector_sink sink{&out};
+        png_io io{&sink, vector_sink::write, vector_sink::flush};
+        save_pixelmap(map, nullptr, &io, opts);
+        return out;
+    }
+
+    std::vector<uint8_t> PixelMap::encodePNG(const PixelMap &map)
+    {
+        return encodePNG(map, PNGOptions());
+    }
+
+    size_t PixelMap::encodePNG(const PixelMap &map, std::span<uint8_t> dest,
+                               const PNGOptions& opts)
+    {
+        span_sink sink{dest, 0, false};
+        png_io io{&sink, span_sink::write, span_sink::flush};
+        try
+        {
+            save_pixelmap(map, nullptr, &io, opts);
+        }
+        catch (const std::runtime_error&)
+        {
+            if (sink.overflow)
+                throw std::length_error("Png buffer too small");
+            throw;
         }
+        return sink.size;
     }
-}
\ No newline at end of file
+}
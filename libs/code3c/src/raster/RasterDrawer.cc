@@ -0,0 +1,526 @@
+#include "code3c/drawer.hh"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <stdexcept>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define CODE3C_AVX2_DISPATCH // AVX2 coverage kernel, selected at runtime
+#include <immintrin.h>
+#endif
+
+namespace code3c
+{
+    namespace
+    {
+        /**
+         * Extent of a sector of the unit circle (y axis pointing up): centre,
+         * arc ends and the axis extremes swept by the arc.
+         */
+        struct extent
+        {
+            double minX, maxX, minY, maxY;
+        };
+
+        extent sector_extent(double u0x, double u0y, double u1x, double u1y,
+                             int rotation, int degree)
+        {
+            extent e{std::min({0.0, u0x, u1x}), std::max({0.0, u0x, u1x}),
+                     std::min({0.0, u0y, u1y}), std::max({0.0, u0y, u1y})};
+            int start(((rotation % 360) + 360) % 360);
+            for (int axis(0); axis < 360; axis += 90)
+            {
+                if ((axis - start + 360) % 360 <= degree)
+                {
+                    double ax(axis == 0 ? 1 : axis == 180 ? -1 : 0);
+                    double ay(axis == 90 ? 1 : axis == 270 ? -1 : 0);
+                    e.minX = std::min(e.minX, ax); e.maxX = std::max(e.maxX, ax);
+                    e.minY = std::min(e.minY, ay); e.maxY = std::max(e.maxY, ay);
+                }
+            }
+            return e;
+        }
+
+        enum { SECTOR_DISC, SECTOR_CONVEX, SECTOR_REFLEX };
+
+        /**
+         * Filled sector in frame coordinates. Coverage terms of a pixel centre
+         * (dx, dy) from the centre, y axis pointing up:
+         * disc <code>r + 0.5 - |(dx, dy)|</code>, start edge
+         * <code>k0 + m0 dx</code> and end edge <code>k1 + m1 dx</code> (signed
+         * distances to the edges, offset by half a pixel), each clamped to
+         * [0, 1].
+         */
+        struct sector
+        {
+            float cx, cy, radius;
+            float u0x, u0y, u1x, u1y; /*< edge directions */
+            int shape;
+        };
+
+        inline float clamp01(float v)
+        {
+            return std::min(1.0f, std::max(0.0f, v));
+        }
+
+        // Coverage of the pixels [x0, x0+n) of row y
+        void coverage_scalar(const sector& s, int y, int x0, int n, float* out)
+        {
+            float dy(s.cy - ((float) y + 0.5f));
+            float k0(s.u0x * dy + 0.5f), m0(-s.u0y);
+            float k1(0.5f - dy * s.u1x), m1(s.u1y);
+            for (int i(0); i < n; i++)
+            {
+                float dx(((float) (x0 + i) - s.cx) + 0.5f);
+                float c(clamp01(s.radius + 0.5f - std::sqrt(dx * dx + dy * dy)));
+                if (s.shape != SECTOR_DISC)
+                {
+                    float a0(clamp01(k0 + m0 * dx)), a1(clamp01(k1 + m1 * dx));
+                    c *= s.shape == SECTOR_CONVEX ? std::min(a0, a1) : std::max(a0, a1);
+                }
+                out[i] = c;
+            }
+        }
+
+#if defined(CODE3C_AVX2_DISPATCH)
+        __attribute__((target("avx2")))
+        inline __m256 clamp01_avx2(__m256 v)
+        {
+            return _mm256_min_ps(_mm256_set1_ps(1.0f), _mm256_max_ps(_mm256_setzero_ps(), v));
+        }
+
+        // Same computation, eight pixels at a time
+        __attribute__((target("avx2")))
+        void coverage_avx2(const sector& s, int y, int x0, int n, float* out)
+        {
+            const __m256 lanes(_mm256_setr_ps(0.5f, 1.5f, 2.5f, 3.5f, 4.5f, 5.5f, 6.5f, 7.5f));
+            float dy(s.cy - ((float) y + 0.5f));
+            __m256 dy2(_mm256_set1_ps(dy * dy)), r(_mm256_set1_ps(s.radius + 0.5f));
+            __m256 k0(_mm256_set1_ps(s.u0x * dy + 0.5f)), m0(_mm256_set1_ps(-s.u0y));
+            __m256 k1(_mm256_set1_ps(0.5f - dy * s.u1x)), m1(_mm256_set1_ps(s.u1y));
+
+            int i(0);
+            for (; i + 8 <= n; i += 8)
+            {
+                __m256 dx(_mm256_add_ps(_mm256_set1_ps((float) (x0 + i) - s.cx), lanes));
+                __m256 d(_mm256_sqrt_ps(_mm256_add_ps(_mm256_mul_ps(dx, dx), dy2)));
+                __m256 c(clamp01_avx2(_mm256_sub_ps(r, d)));
+                if (s.shape != SECTOR_DISC)
+                {
+                    __m256 a0(clamp01_avx2(_mm256_add_ps(k0, _mm256_mul_ps(m0, dx))));
+                    __m256 a1(clamp01_avx2(_mm256_add_ps(k1, _mm256_mul_ps(m1, dx))));
+                    c = _mm256_mul_ps(c, s.shape == SECTOR_CONVEX ? _mm256_min_ps(a0, a1)
+                                                                  : _mm256_max_ps(a0, a1));
+                }
+                _mm256_storeu_ps(out + i, c);
+            }
+            coverage_scalar(s, y, x0 + i, n - i, out + i);
+        }
+#endif
+
+        typedef void (*coverage_kernel)(const sector&, int, int, int, float*);
+
+        /**
+         * Sector of a slice, and the extent of its arc on the unit circle.
+         */
+        sector slice_sector(const Slice& slice, extent& e)
+        {
+            sector s{(float) slice.x, (float) slice.y, (float) slice.radius,
+                     0, 0, 0, 0, SECTOR_DISC};
+            e = {-1, 1, -1, 1};
+            int degree(slice.degree), rotation(slice.rotation - slice.degree/2);
+            if (degree < 360 && degree > -360)
+            {
+                if (degree < 0)
+                {
+                    rotation += degree;
+                    degree = -degree;
+                }
+                double a0(rotation * M_PI / 180.0), a1((rotation + degree) * M_PI / 180.0);
+                double u0x(std::cos(a0)), u0y(std::sin(a0));
+                double u1x(std::cos(a1)), u1y(std::sin(a1));
+                s = {s.cx, s.cy, s.radius, (float) u0x, (float) u0y, (float) u1x, (float) u1y,
+                     degree <= 180 ? SECTOR_CONVEX : SECTOR_REFLEX};
+                e = sector_extent(u0x, u0y, u1x, u1y, rotation, degree);
+            }
+            return s;
+        }
+
+        coverage_kernel select_coverage()
+        {
+#if defined(CODE3C_AVX2_DISPATCH)
+            static const coverage_kernel kernel(__builtin_cpu_supports("avx2")
+                                                ? coverage_avx2 : coverage_scalar);
+            return kernel;
+#else
+            return coverage_scalar;
+#endif
+        }
+
+        /**
+         * Source over destination, per channel.
+         * @param alpha the source opacity
+         */
+        inline uint32_t blend(uint32_t dst, unsigned long color, unsigned alpha)
+        {
+            unsigned long d(rgba8_color(dst));
+            unsigned long out(0);
+            for (int shift(0); shift < 24; shift += 8)
+            {
+                unsigned sc((color >> shift) & 0xff), dc((d >> shift) & 0xff);
+                out |= (unsigned long) ((sc * alpha + dc * (255 - alpha) + 127) / 255)
+                       << shift;
+            }
+            unsigned da(rgba8_alpha(dst));
+            return rgba8(out, alpha + (da * (255 - alpha) + 127) / 255);
+        }
+    }
+
+    RasterDrawer::RasterDrawer(int width, int height, const mat8_t &data):
+            Drawer(width, height, data), m_frame(width, height),
+            m_foreground(rgba8(0)), m_antialiased(false)
+    {
+    }
+
+    RasterDrawer::RasterDrawer(const RasterDrawer &rasterDrawer):
+            Drawer(rasterDrawer), m_frame(rasterDrawer.m_frame),
+            m_foreground(rasterDrawer.m_foreground),
+            m_antialiased(rasterDrawer.m_antialiased)
+    {
+    }
+
+    void RasterDrawer::show(bool)
+    {
+    }
+
+    void RasterDrawer::setTitle(const char *)
+    {
+    }
+
+    void RasterDrawer::setHeigh(int height)
+    {
+        m_height = height;
+        m_frame = PixelMap(m_width, m_height);
+    }
+
+    void RasterDrawer::setWidth(int width)
+    {
+        m_width = width;
+        m_frame = PixelMap(m_width, m_height);
+    }
+
+    void RasterDrawer::run()
+    {
+        this->setup();
+        this->draw();
+    }
+
+    void RasterDrawer::exit()
+    {
+    }
+
+    void RasterDrawer::clear()
+    {
+        background(0xffffff);
+    }
+
+    unsigned long RasterDrawer::frameRate() const
+    {
+        return 0;
+    }
+
+    void RasterDrawer::savePNG(const char *name) const
+    {
+        FILE * dest = fopen(name, "wb");
+        if (dest)
+        {
+            std::vector<uint32_t> colors(palette());
+            PixelMap::PNGOptions opts;
+            opts.palette = colors;
+            PixelMap::saveInPng(m_frame, dest, opts);
+            fclose(dest);
+        }
+    }
+
+    std::vector<uint8_t> RasterDrawer::encodePNG() const
+    {
+        return encode(PixelMap::FORMAT_PNG);
+    }
+
+    std::vector<uint8_t> RasterDrawer::encode(PixelMap::Format format) const
+    {
+        std::vector<uint32_t> colors(palette());
+        PixelMap::PNGOptions opts;
+        opts.palette = colors;
+        return PixelMap::encode(m_frame, format, opts);
+    }
+
+    void RasterDrawer::setAntialiased(bool antialiased)
+    {
+        m_antialiased = antialiased;
+        if (!antialiased)
+        {
+            std::vector<float>().swap(m_coverage);
+            std::vector<float>().swap(m_line);
+            std::vector<uint32_t>().swap(m_touched);
+        }
+    }
+
+    bool RasterDrawer::coverage(const Slice& slice, int y, int x0, int n, float* out,
+                                bool vectorized)
+    {
+        extent e{};
+        sector s(slice_sector(slice, e));
+        coverage_kernel kernel(vectorized ? select_coverage() : coverage_scalar);
+        kernel(s, y, x0, n, out);
+        return kernel != coverage_scalar;
+    }
+
+    /* draw functions */
+
+    void RasterDrawer::cover_slice(const Slice &slice)
+    {
+        if (m_coverage.size() != m_frame.size())
+            m_coverage.assign(m_frame.size(), 0.0f);
+        if (m_line.size() != (size_t) m_width)
+            m_line.resize(m_width);
+
+        extent e{};
+        sector s(slice_sector(slice, e));
+
+        // Pixels of the slice extent, grown by one for the partial ones; the
+        // interior gets the colour at once, edges accumulate their coverage
+        coverage_kernel kernel(select_coverage());
+        double outer(slice.radius + 0.5);
+        int y0((int) std::floor(slice.y - e.maxY * slice.radius) - 1);
+        int y1((int) std::ceil(slice.y - e.minY * slice.radius) + 1);
+        for (int y(std::max(y0, 0)); y <= std::min(y1, m_height - 1); y++)
+        {
+            double dy(y + 0.5 - slice.y);
+            if (dy * dy >= outer * outer)
+                continue;
+            double half(std::sqrt(outer * outer - dy * dy));
+            int x0(std::max(0, (int) std::floor(std::max(slice.x - half,
+                                                          slice.x + e.minX * slice.radius - 1))));
+            int x1(std::min(m_width - 1, (int) std::ceil(std::min(slice.x + half,
+                                                                   slice.x + e.maxX * slice.radius + 1))));
+            if (x0 > x1)
+                continue;
+
+            kernel(s, y, x0, x1 - x0 + 1, m_line.data());
+            std::span<uint32_t> row(m_frame.row(y));
+            float* coverage(&m_coverage[(size_t) y * m_width]);
+            for (int x(x0); x <= x1; x++)
+            {
+                float c(m_line[x - x0]);
+                if (c >= 1.0f)
+                {
+                    row[x] = m_foreground;
+                }
+                else if (c > 0.0f)
+                {
+                    if (coverage[x] == 0.0f)
+                        m_touched.push_back((uint32_t) ((size_t) y * m_width + x));
+                    coverage[x] += c;
+                }
+            }
+        }
+    }
+
+    void RasterDrawer::flush_coverage()
+    {
+        uint32_t* frame(m_frame.data());
+        unsigned long color(rgba8_color(m_foreground));
+        unsigned opacity(rgba8_alpha(m_foreground));
+        for (uint32_t i : m_touched)
+        {
+            unsigned alpha((unsigned) std::lround(std::min(1.0f, m_coverage[i]) * opacity));
+            frame[i] = blend(frame[i], color, alpha);
+            m_coverage[i] = 0.0f;
+        }
+        m_touched.clear();
+    }
+
+    void RasterDrawer::fill_span(int y, int x0, int x1)
+    {
+        if (y < 0 || y >= m_height)
+            return;
+        x0 = std::max(x0, 0);
+        x1 = std::min(x1, m_width - 1);
+        if (x0 <= x1)
+        {
+            std::span<uint32_t> row(m_frame.row(y));
+            std::fill(row.begin() + x0, row.begin() + x1 + 1, m_foreground);
+        }
+    }
+
+    void RasterDrawer::background(unsigned long color)
+    {
+        uint32_t px(rgba8(color));
+        std::fill(m_frame.data(), m_frame.data() + m_frame.size(), px);
+    }
+
+    void RasterDrawer::foreground(unsigned long color)
+    {
+        m_foreground = rgba8(color);
+    }
+
+    void RasterDrawer::draw_pixel(unsigned long color, int x, int y)
+    {
+        if (x >= 0 && x < m_width && y >= 0 && y < m_height)
+            m_frame.set(x, y, color);
+    }
+
+    void RasterDrawer::draw_text(const char *, int, int)
+    {
+        throw std::runtime_error("RasterDrawer cannot draw text");
+    }
+
+    void RasterDrawer::draw_slice(
+            int origin_x, int origin_y, int radius, int degree, int rotation
+            )
+    {
+        if (m_antialiased)
+        {
+            cover_slice({origin_x, origin_y, radius, degree, rotation});
+            flush_coverage();
+            return;
+        }
+
+        // Same angles as XFillArc: counter-clockwise from 3 o'clock
+        rotation -= degree/2;
+        if (degree >= 360 || degree <= -360)
+        {
+            fill_circle(origin_x, origin_y, radius);
+            return;
+        }
+        if (degree < 0)
+        {
+            rotation += degree;
+            degree = -degree;
+        }
+
+        // Edge directions (y axis pointing up)
+        double a0(rotation * M_PI / 180.0), a1((rotation + degree) * M_PI / 180.0);
+        double u0x(std::cos(a0)), u0y(std::sin(a0));
+        double u1x(std::cos(a1)), u1y(std::sin(a1));
+        extent e(sector_extent(u0x, u0y, u1x, u1y, rotation, degree));
+
+        // A pixel belongs to the slice when its centre is in the disc and
+        // within the angular sector (half-plane tests)
+        bool convex(degree <= 180);
+        auto inside = [&](double px, double py) -> bool {
+            double c0(u0x * py - u0y * px), c1(px * u1y - py * u1x);
+            return convex ? (c0 >= 0 && c1 >= 0) : (c0 >= 0 || c1 >= 0);
+        };
+
+        int y0((int) std::floor(origin_y - e.maxY * radius));
+        int y1((int) std::ceil(origin_y - e.minY * radius));
+        double r2((double) radius * radius);
+        for (int y(std::max(y0, 0)); y <= std::min(y1, m_height - 1); y++)
+        {
+            double dy(y + 0.5 - origin_y);
+            if (dy * dy > r2)
+                continue;
+            double half(std::sqrt(r2 - dy * dy));
+            int x0((int) std::ceil(std::max(origin_x - half, origin_x + e.minX * radius) - 0.5));
+            int x1((int) std::floor(std::min(origin_x + half, origin_x + e.maxX * radius) - 0.5));
+
+            // Run of pixels inside the sector
+            int run(-1);
+            for (int x(std::max(x0, 0)); x <= std::min(x1, m_width - 1); x++)
+            {
+                if (inside(x + 0.5 - origin_x, origin_y - (y + 0.5)))
+                {
+                    if (run < 0) run = x;
+                }
+                else if (run >= 0)
+                {
+                    fill_span(y, run, x - 1);
+                    run = -1;
+                }
+            }
+            if (run >= 0)
+                fill_span(y, run, std::min(x1, m_width - 1));
+        }
+    }
+
+    void RasterDrawer::fill_slices(unsigned long color, std::span<const Slice> slices)
+    {
+        if (!m_antialiased)
+        {
+            Drawer::fill_slices(color, slices);
+            return;
+        }
+
+        foreground(color);
+        for (const Slice& slice : slices)
+            cover_slice(slice);
+        flush_coverage();
+    }
+
+    void RasterDrawer::fill_circle(int x, int y, int radius)
+    {
+        if (m_antialiased)
+        {
+            cover_slice({x, y, radius, 360, 0});
+            flush_coverage();
+            return;
+        }
+
+        double r2((double) radius * radius);
+        for (int py(std::max(y - radius, 0)); py <= std::min(y + radius, m_height - 1); py++)
+        {
+            double dy(py + 0.5 - y);
+            if (dy * dy > r2)
+                continue;
+            double half(std::sqrt(r2 - dy * dy));
+            fill_span(py, (int) std::ceil(x - half - 0.5),
+                      (int) std::floor(x + half - 0.5));
+        }
+    }
+
+    void RasterDrawer::draw_line(int x1, int y1, int x2, int y2)
+    {
+        // Bresenham
+        int dx(std::abs(x2 - x1)), dy(-std::abs(y2 - y1));
+        int sx(x1 < x2 ? 1 : -1), sy(y1 < y2 ? 1 : -1);
+        int err(dx + dy);
+        while (true)
+        {
+            fill_span(y1, x1, x1);
+            if (x1 == x2 && y1 == y2)
+                break;
+            int e2(2 * err);
+            if (e2 >= dy) { err += dy; x1 += sx; }
+            if (e2 <= dx) { err += dx; y1 += sy; }
+        }
+    }
+
+    void RasterDrawer::blit(const PixelMap &pixelMap, int x, int y, const Rect& clip)
+    {
+        // Source columns and rows within the clip area and the frame
+        int px0(std::max({0, -x, clip.x - x}));
+        int px1(std::min({pixelMap.width(), m_width - x, clip.x + clip.width - x}));
+        int py0(std::max({0, -y, clip.y - y}));
+        int py1(std::min({pixelMap.height(), m_height - y, clip.y + clip.height - y}));
+        for (int py(py0); py < py1; py++)
+        {
+            std::span<const uint32_t> src(pixelMap.row(py));
+            std::span<uint32_t> dst(m_frame.row(py + y));
+            for (int px(px0); px < px1; px++)
+            {
+                unsigned alpha(rgba8_alpha(src[px]));
+                if (alpha == 0xff)
+                {
+                    dst[px + x] = src[px];
+                }
+                else if (alpha != 0)
+                {
+                    dst[px + x] = blend(dst[px + x], rgba8_color(src[px]), alpha);
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,465 @@
+#include "code3c/tiledraster.hh"
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstring>
+#include <memory>
+#include <unordered_set>
+
+namespace code3c
+{
+    namespace
+    {
+        constexpr int TILE = CODE3C_TILE_SIZE;
+        constexpr float TILE_MARGIN = 2.0f; // anti-aliased edges and rounding
+
+        enum relation { DISJOINT, PARTIAL, COVERS };
+
+        inline float wrap(float degrees)
+        {
+            degrees = std::fmod(degrees, 360.0f);
+            return degrees < 0 ? degrees + 360.0f : degrees;
+        }
+
+        /**
+         * Tile rectangle (grown by TILE_MARGIN) seen from a centre: distance
+         * range and angular span (counter-clockwise, y axis pointing up),
+         * the whole circle when the centre lies within.
+         */
+        struct polar
+        {
+            float rmin, rmax;
+            float start, sweep;
+        };
+
+        polar polar_extent(const float rect[4], float cx, float cy)
+        {
+            polar p{std::hypot(std::clamp(cx, rect[0], rect[2]) - cx,
+                               std::clamp(cy, rect[1], rect[3]) - cy), 0, 0, 360};
+            float angles[4];
+            for (int i(0); i < 4; i++)
+            {
+                float x(rect[(i % 2) * 2]), y(rect[1 + (i / 2) * 2]);
+                p.rmax = std::max(p.rmax, std::hypot(x - cx, y - cy));
+                angles[i] = std::atan2(cy - y, x - cx) * (float) (180.0 / M_PI);
+            }
+            if (cx < rect[0] || cx > rect[2] || cy < rect[1] || cy > rect[3])
+            {
+                // Less than half a turn, relative to the first corner
+                float lo(0), hi(0);
+                for (int i(1); i < 4; i++)
+                {
+                    float d(wrap(angles[i] - angles[0] + 180.0f) - 180.0f);
+                    lo = std::min(lo, d);
+                    hi = std::max(hi, d);
+                }
+                p.start = wrap(angles[0] + lo);
+                p.sweep = hi - lo;
+            }
+            return p;
+        }
+
+        /**
+         * @return how a pie slice (or a disc, <code>sweep</code> >= 360)
+         * relates to the tile
+         */
+        relation relate(float radius, float start, float sweep, const polar& p)
+        {
+            if (p.rmin > radius)
+                return DISJOINT;
+            bool disc(sweep >= 360), around(p.sweep >= 360);
+            if (!disc && !around && wrap(p.start - start) > sweep && wrap(start - p.start) > p.sweep)
+                return DISJOINT;
+            if (p.rmax <= radius &&
+                (disc || (!around && sweep <= 180 && wrap(p.start - start) + p.sweep <= sweep)))
+                return COVERS;
+            return PARTIAL;
+        }
+
+        const mat8_t& no_data()
+        {
+            static const mat8_t data(1);
+            return data;
+        }
+
+        class TileDrawer : public RasterDrawer
+        {
+        public:
+            TileDrawer() : RasterDrawer(TILE, TILE, no_data()) {}
+
+            void setup() override {}
+            void draw() override {}
+        };
+
+        // Primitives touching the tile, in reverse order
+        struct tile_scratch
+        {
+            std::vector<uint32_t> operations, first, count;
+            std::vector<Slice> slices;
+        };
+    }
+
+    TiledRasterizer::TiledRasterizer(const DisplayList &list, double scale, bool antialiased):
+            m_list(list), m_scale(scale), m_antialiased(antialiased),
+            m_width(std::max(1, (int) std::lround(list.width() * scale))),
+            m_height(std::max(1, (int) std::lround(list.height() * scale))),
+            m_columns((m_width + TILE - 1) / TILE), m_rows((m_height + TILE - 1) / TILE),
+            m_uniform(0), m_rasterized(0)
+    {
+        auto px = [scale](int v) -> int { return (int) std::lround(v * scale); };
+        int margin((int) TILE_MARGIN);
+
+        for (const DisplayList::command& cmd : list.commands())
+        {
+            operation op{cmd.kind, cmd.color, {0, 0, 0, 0}, {0, 0, m_width, m_height},
+                         0, 0, 0, 0, 0, false};
+            switch (cmd.kind)
+            {
+                case DisplayList::DL_BACKGROUND:
+                    break;
+                case DisplayList::DL_SLICES:
+                {
+                    op.first = (uint32_t) m_wedges.size();
+                    op.count = cmd.count;
+                    op.bounds[0] = op.bounds[1] = INT_MAX;
+                    op.bounds[2] = op.bounds[3] = INT_MIN;
+                    op.centred = true;
+                    for (const Slice& s : list.slices().subspan(cmd.first, cmd.count))
+                    {
+                        Slice scaled{px(s.x), px(s.y), px(s.radius), s.degree, s.rotation};
+                        // Same angles as RasterDrawer::draw_slice()
+                        int rotation(s.rotation - s.degree/2), degree(s.degree);
+                        if (degree < 0)
+                        {
+                            rotation += degree;
+                            degree = -degree;
+                        }
+                        m_wedges.push_back({scaled, wrap((float) rotation),
+                                            (float) std::min(degree, 360)});
+
+                        if (m_wedges.size() == op.first + 1)
+                        {
+                            op.cx = scaled.x;
+                            op.cy = scaled.y;
+                        }
+                        op.centred &= scaled.x == op.cx && scaled.y == op.cy;
+                        op.radius = std::max(op.radius, scaled.radius);
+                        op.bounds[0] = std::min(op.bounds[0], scaled.x - scaled.radius - margin);
+                        op.bounds[1] = std::min(op.bounds[1], scaled.y - scaled.radius - margin);
+                        op.bounds[2] = std::max(op.bounds[2], scaled.x + scaled.radius + margin + 1);
+                        op.bounds[3] = std::max(op.bounds[3], scaled.y + scaled.radius + margin + 1);
+                    }
+                    break;
+                }
+                case DisplayList::DL_CIRCLE:
+                    op.cx = px(cmd.args[0]);
+                    op.cy = px(cmd.args[1]);
+                    op.radius = px(cmd.args[2]);
+                    op.centred = true;
+                    op.bounds[0] = op.cx - op.radius - margin;
+                    op.bounds[1] = op.cy - op.radius - margin;
+                    op.bounds[2] = op.cx + op.radius + margin + 1;
+                    op.bounds[3] = op.cy + op.radius + margin + 1;
+                    break;
+                case DisplayList::DL_LINE:
+                    for (int i(0); i < 4; i++)
+                        op.args[i] = px(cmd.args[i]);
+                    op.bounds[0] = std::min(op.args[0], op.args[2]) - margin;
+                    op.bounds[1] = std::min(op.args[1], op.args[3]) - margin;
+                    op.bounds[2] = std::max(op.args[0], op.args[2]) + margin + 1;
+                    op.bounds[3] = std::max(op.args[1], op.args[3]) + margin + 1;
+                    break;
+                case DisplayList::DL_BLIT:
+                {
+                    op.args[0] = px(cmd.args[0]);
+                    op.args[1] = px(cmd.args[1]);
+                    int width(std::max(1, px(cmd.args[2]))), height(std::max(1, px(cmd.args[3])));
+
+                    // One sampler per image and size (e.g. the marker of every
+                    // code of a sheet)
+                    const DisplayList::image& img(list.images()[cmd.first]);
+                    op.first = 0;
+                    for (; op.first < m_images.size(); op.first++)
+                    {
+                        const DisplayList::image& other(list.images()[m_imageSources[op.first]]);
+                        if (other.path == img.path && other.circular == img.circular &&
+                            m_images[op.first].width() == width &&
+                            m_images[op.first].height() == height)
+                            break;
+                    }
+                    if (op.first == m_images.size())
+                    {
+                        m_images.push_back(list.sampleImage(cmd.first, width, height, !m_antialiased));
+                        m_imageSources.push_back(cmd.first);
+                    }
+                    op.bounds[0] = op.args[0];
+                    op.bounds[1] = op.args[1];
+                    op.bounds[2] = op.args[0] + width;
+                    op.bounds[3] = op.args[1] + height;
+                    break;
+                }
+            }
+            m_operations.push_back(op);
+        }
+    }
+
+    void TiledRasterizer::render_tile(int column, int row, PixelMap &band, int y) const
+    {
+        thread_local tile_scratch scratch;
+        thread_local std::unique_ptr<TileDrawer> drawer;
+        thread_local PixelMap window(TILE, TILE);
+
+        int tx(column * TILE), ty(row * TILE);
+        int tw(std::min(TILE, m_width - tx)), th(std::min({TILE, m_height - ty, y + band.height() - ty}));
+        float rect[4] = {tx - TILE_MARGIN, ty - TILE_MARGIN,
+                         tx + tw + TILE_MARGIN, ty + th + TILE_MARGIN};
+
+        // Polar extent, computed once per centre
+        polar extent{};
+        int ecx(INT_MIN), ecy(INT_MIN);
+        auto seen_from = [&](int cx, int cy) -> const polar& {
+            if (cx != ecx || cy != ecy)
+            {
+                extent = polar_extent(rect, (float) cx, (float) cy);
+                ecx = cx;
+                ecy = cy;
+            }
+            return extent;
+        };
+
+        // From the last primitive backwards, up to the first covering the tile
+        int cover(-1);
+        scratch.operations.clear();
+        scratch.first.clear();
+        scratch.count.clear();
+        scratch.slices.clear();
+        for (size_t k(m_operations.size()); k-- > 0;)
+        {
+            const operation& op(m_operations[k]);
+            if (rect[2] <= op.bounds[0] || rect[0] >= op.bounds[2] ||
+                rect[3] <= op.bounds[1] || rect[1] >= op.bounds[3])
+                continue;
+
+            relation rel(PARTIAL);
+            size_t first(scratch.slices.size());
+            switch (op.kind)
+            {
+                case DisplayList::DL_BACKGROUND:
+                    rel = COVERS;
+                    break;
+                case DisplayList::DL_CIRCLE:
+                    rel = relate((float) op.radius, 0, 360, seen_from(op.cx, op.cy));
+                    break;
+                case DisplayList::DL_SLICES:
+                    if (op.centred && seen_from(op.cx, op.cy).rmin > (float) op.radius)
+                    {
+                        rel = DISJOINT;
+                        break;
+                    }
+                    rel = DISJOINT;
+                    for (uint32_t i(op.first); i < op.first + op.count && rel != COVERS; i++)
+                    {
+                        const wedge& w(m_wedges[i]);
+                        relation r(relate((float) w.slice.radius, w.start, w.sweep,
+                                          seen_from(w.slice.x, w.slice.y)));
+                        if (r == PARTIAL)
+                            scratch.slices.push_back({w.slice.x - tx, w.slice.y - ty, w.slice.radius,
+                                                      w.slice.degree, w.slice.rotation});
+                        rel = std::max(rel, r);
+                    }
+                    break;
+                case DisplayList::DL_BLIT:
+                    rel = m_images[op.first].transparent(tx - op.args[0], ty - op.args[1], tw, th)
+                          ? DISJOINT : PARTIAL;
+                    break;
+                case DisplayList::DL_LINE:
+                    break;
+            }
+
+            if (rel == COVERS)
+            {
+                cover = (int) k;
+                scratch.slices.resize(first);
+                break;
+            }
+            if (rel == PARTIAL)
+            {
+                scratch.operations.push_back((uint32_t) k);
+                scratch.first.push_back((uint32_t) first);
+                scratch.count.push_back((uint32_t) (scratch.slices.size() - first));
+            }
+        }
+
+        if (cover >= 0 && scratch.operations.empty())
+        {
+            // Single colour
+            uint32_t px(rgba8(m_operations[cover].color));
+            for (int py(0); py < th; py++)
+            {
+                std::span<uint32_t> dst(band.row(ty - y + py));
+                std::fill(dst.begin() + tx, dst.begin() + tx + tw, px);
+            }
+            m_uniform++;
+            return;
+        }
+
+        // Nothing below: a blank frame, as a new RasterDrawer
+        if (!drawer || cover < 0)
+            drawer = std::make_unique<TileDrawer>();
+        drawer->setAntialiased(m_antialiased);
+        if (cover >= 0)
+            drawer->background(m_operations[cover].color);
+        for (size_t i(scratch.operations.size()); i-- > 0;)
+        {
+            const operation& op(m_operations[scratch.operations[i]]);
+            switch (op.kind)
+            {
+                case DisplayList::DL_SLICES:
+                    drawer->fill_slices(op.color, std::span<const Slice>(
+                            scratch.slices.data() + scratch.first[i], scratch.count[i]));
+                    break;
+                case DisplayList::DL_CIRCLE:
+                    drawer->foreground(op.color);
+                    drawer->fill_circle(op.cx - tx, op.cy - ty, op.radius);
+                    break;
+                case DisplayList::DL_LINE:
+                    drawer->foreground(op.color);
+                    drawer->draw_line(op.args[0] - tx, op.args[1] - ty,
+                                      op.args[2] - tx, op.args[3] - ty);
+                    break;
+                case DisplayList::DL_BLIT:
+                    m_images[op.first].sample(tx - op.args[0], ty - op.args[1], window);
+                    drawer->blit(window, 0, 0, {0, 0, TILE, TILE});
+                    break;
+                case DisplayList::DL_BACKGROUND:
+                    break;
+            }
+        }
+        for (int py(0); py < th; py++)
+            std::memcpy(band.row(ty - y + py).data() + tx, drawer->frame().row(py).data(),
+                        tw * sizeof(uint32_t));
+        m_rasterized++;
+    }
+
+    void TiledRasterizer::render(int y, PixelMap &band, WorkPool& pool) const
+    {
+        int row0(y / TILE);
+        int rows(std::min((band.height() + TILE - 1) / TILE, m_rows - row0));
+        pool.run(rows * m_columns, [this, &band, row0, y](int i) {
+            render_tile(i % m_columns, row0 + i / m_columns, band, y);
+        });
+    }
+
+    PixelMap TiledRasterizer::render(WorkPool& pool) const
+    {
+        PixelMap frame(m_width, m_height);
+        render(0, frame, pool);
+        return frame;
+    }
+
+    std::vector<uint32_t> TiledRasterizer::colors() const
+    {
+        if (m_antialiased)
+            return {};
+
+        std::unordered_set<uint32_t> found;
+        std::vector<uint32_t> colors;
+        auto add = [&](uint32_t px) -> bool {
+            if (found.insert(px).second)
+                colors.push_back(px);
+            return colors.size() <= 256;
+        };
+        for (const operation& op : m_operations)
+            if (op.kind != DisplayList::DL_BLIT && !add(rgba8(op.color)))
+                return {};
+        for (size_t i(0); i < m_images.size(); i++)
+        {
+            const PixelMap& image(m_images[i].source());
+            // Resized tile by tile, snapped to the colours of the source
+            if (image.width() != m_images[i].width() || image.height() != m_images[i].height())
+            {
+                std::vector<uint32_t> palette(m_list.imagePalette(m_imageSources[i]));
+                if (palette.empty())
+                    return {};
+                for (uint32_t px : palette)
+                    if (!add(px))
+                        return {};
+                continue;
+            }
+            bool circular(m_list.images()[m_imageSources[i]].circular);
+            for (size_t k(0); k < image.size(); k++)
+            {
+                uint32_t px(image.data()[k]);
+                unsigned alpha(rgba8_alpha(px));
+                if (circular)
+                {
+                    // Made opaque within the disc
+                    if (!add(rgba8(rgba8_color(px))))
+                        return {};
+                }
+                // Blended pixels depend on what lies below
+                else if ((alpha != 0 && alpha != 0xff) || (alpha == 0xff && !add(px)))
+                    return {};
+            }
+        }
+        return colors;
+    }
+
+    void TiledRasterizer::save(FILE *dest, PixelMap::Format format,
+                               const PixelMap::PNGOptions &opts, WorkPool& pool) const
+    {
+        // Indexed only when every colour is known
+        PixelMap::PNGOptions o(opts);
+        std::vector<uint32_t> palette(opts.palette.begin(), opts.palette.end());
+        std::vector<uint32_t> found(opts.indexed && format == PixelMap::FORMAT_PNG
+                                    ? colors() : std::vector<uint32_t>());
+        for (uint32_t px : found)
+            if (std::find(palette.begin(), palette.end(), px) == palette.end())
+                palette.push_back(px);
+        o.indexed = !found.empty() && palette.size() <= 256;
+        o.palette = palette;
+
+        // Double-buffered bands: the next one renders during encoding
+        PixelMap bands[2] = {PixelMap(m_width, TILE), PixelMap(m_width, TILE)};
+        WorkPool::Batch pending[2];
+        auto start = [&](int row) {
+            PixelMap& band(bands[row % 2]);
+            pending[row % 2] = pool.submit(m_columns, [this, &band, row](int column) {
+                render_tile(column, row, band, row * TILE);
+            });
+        };
+        auto drain = [&]() {
+            for (WorkPool::Batch& batch : pending)
+            {
+                if (batch)
+                    pool.wait(batch);
+                batch.reset();
+            }
+        };
+
+        start(0);
+        try
+        {
+            PixelMap::save(dest, m_width, m_height, format, [&](int y, std::span<uint32_t> row) {
+                int band(y / TILE);
+                if (y % TILE == 0)
+                {
+                    WorkPool::Batch current(std::move(pending[band % 2]));
+                    pool.wait(current);
+                    if (band + 1 < m_rows)
+                        start(band + 1);
+                }
+                std::memcpy(row.data(), bands[band % 2].row(y % TILE).data(),
+                            m_width * sizeof(uint32_t));
+            }, o);
+        }
+        catch (...)
+        {
+            // The bands must outlive the tasks still running
+            try { drain(); } catch (...) {}
+            throw;
+        }
+        drain();
+    }
+}
@@ -0,0 +1,395 @@
+#include "code3c/pixelmap.hh"
+#include "code3c/parallel.hh"
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <vector>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace code3c
+{
+    namespace
+    {
+        constexpr int RESAMPLE_GRAIN = 16; // minimal rows per thread band
+
+        /**
+         * Pre-computed filter weights of one axis: the destination index i is
+         * computed from source indices [first[i], first[i]+count[i]) weighted
+         * by weights[i*stride...].
+         */
+        struct contributions
+        {
+            int stride;
+            std::vector<int> first, count;
+            std::vector<float> weights;
+        };
+
+        double filter_support(PixelMap::Filter filter)
+        {
+            switch (filter)
+            {
+                case PixelMap::FILTER_BOX:      return 0.5;
+                case PixelMap::FILTER_BILINEAR: return 1.0;
+                case PixelMap::FILTER_LANCZOS3: return 3.0;
+                default:                        return 0.0;
+            }
+        }
+
+        double filter_weight(PixelMap::Filter filter, double x)
+        {
+            x = std::fabs(x);
+            switch (filter)
+            {
+                case PixelMap::FILTER_BOX:
+                    return x <= 0.5 ? 1.0 : 0.0;
+                case PixelMap::FILTER_BILINEAR:
+                    return x < 1.0 ? 1.0 - x : 0.0;
+                case PixelMap::FILTER_LANCZOS3:
+                {
+                    if (x < 1e-8)
+                        return 1.0;
+                    if (x >= 3.0)
+                        return 0.0;
+                    double px(M_PI * x);
+                    return 3.0 * std::sin(px) * std::sin(px / 3.0) / (px * px);
+                }
+                default:
+                    return 0.0;
+            }
+        }
+
+        contributions compute_contributions(int src, int dst, PixelMap::Filter filter)
+        {
+            double scale((double) dst / src);
+            // Widen the filter when downscaling (area coverage)
+            double fscale(scale < 1.0 ? scale : 1.0);
+            double support(filter_support(filter) / fscale);
+
+            contributions contrib;
+            contrib.stride = (int) std::ceil(2.0 * support) + 1;
+            contrib.first.resize(dst);
+            contrib.count.resize(dst);
+            contrib.weights.assign((size_t) dst * contrib.stride, 0.0f);
+
+            for (int i(0); i < dst; i++)
+            {
+                double center((i + 0.5) / scale);
+                int lo(std::max(0, (int) std::floor(center - support)));
+                int hi(std::min(src, (int) std::ceil(center + support)));
+                if (hi - lo > contrib.stride)
+                    hi = lo + contrib.stride;
+
+                float* weights(&contrib.weights[(size_t) i * contrib.stride]);
+                double total(0.0);
+                for (int k(lo); k < hi; k++)
+                {
+                    weights[k-lo] = (float) filter_weight(filter,
+                                                          (k + 0.5 - center) * fscale);
+                    total += weights[k-lo];
+                }
+
+                if (total == 0.0)
+                {
+                    // Degenerated filter: pick the nearest source pixel
+                    lo = std::min(src - 1, (int) center);
+                    hi = lo + 1;
+                    weights[0] = 1.0f;
+                    total = 1.0;
+                }
+                for (int k(0); k < hi - lo; k++)
+                    weights[k] = (float) (weights[k] / total);
+
+                contrib.first[i] = lo;
+                contrib.count[i] = hi - lo;
+            }
+            return contrib;
+        }
+
+#if defined(__SSE2__)
+        // Packed RGBA8 pixel to premultiplied float lanes {r, g, b, a}
+        inline __m128 load_premultiplied(uint32_t px)
+        {
+            __m128i zero(_mm_setzero_si128());
+            __m128i v(_mm_cvtsi32_si128((int) px));
+            v = _mm_unpacklo_epi16(_mm_unpacklo_epi8(v, zero), zero);
+            __m128 f(_mm_cvtepi32_ps(v));
+            float a((float) rgba8_alpha(px) * (1.0f / 255.0f));
+            return _mm_mul_ps(f, _mm_set_ps(1.0f, a, a, a));
+        }
+
+        inline uint32_t store_unpremultiplied(__m128 f)
+        {
+            float a(_mm_cvtss_f32(_mm_shuffle_ps(f, f, _MM_SHUFFLE(3, 3, 3, 3))));
+            float inv(a > 0.0f ? 255.0f / a : 0.0f);
+            f = _mm_mul_ps(f, _mm_set_ps(1.0f, inv, inv, inv));
+            f = _mm_min_ps(_mm_max_ps(f, _mm_setzero_ps()), _mm_set1_ps(255.0f));
+            __m128i v(_mm_cvtps_epi32(f));
+            v = _mm_packs_epi32(v, v);
+            v = _mm_packus_epi16(v, v);
+            return (uint32_t) _mm_cvtsi128_si32(v);
+        }
+#else
+        inline void load_premultiplied(uint32_t px, float* out)
+        {
+            unsigned long color(rgba8_color(px));
+            float a((float) rgba8_alpha(px));
+            float k(a / 255.0f);
+            out[0] = (float) ((color >> 16) & 0xff) * k;
+            out[1] = (float) ((color >> 8) & 0xff) * k;
+            out[2] = (float) (color & 0xff) * k;
+            out[3] = a;
+        }
+
+        inline uint32_t store_unpremultiplied(const float* in)
+        {
+            float inv(in[3] > 0.0f ? 255.0f / in[3] : 0.0f);
+            auto channel = [](float v) -> unsigned long {
+                return (unsigned long) std::lround(std::min(255.0f, std::max(0.0f, v)));
+            };
+            return rgba8((channel(in[0]*inv) << 16) | (channel(in[1]*inv) << 8)
+                         | channel(in[2]*inv),
+                         (unsigned char) channel(in[3]));
+        }
+#endif
+
+        // Source columns [lo, hi) contributing to the destination columns [x0, x1)
+        void source_span(const contributions& c, int x0, int x1, int& lo, int& hi)
+        {
+            lo = INT_MAX;
+            hi = INT_MIN;
+            for (int x(x0); x < x1; x++)
+            {
+                lo = std::min(lo, c.first[x]);
+                hi = std::max(hi, c.first[x] + c.count[x]);
+            }
+        }
+
+        // First pass: source rows [y0, y1) resampled horizontally into tmp,
+        // destination columns [x0, x1) only (row y at tmp row y - y0)
+        void resample_rows(const PixelMap& src, const contributions& cx, float* tmp,
+                           int x0, int x1, int y0, int y1)
+        {
+            // Source row converted once to premultiplied float lanes
+            int lo, hi;
+            source_span(cx, x0, x1, lo, hi);
+            std::vector<float> line((size_t) (hi - lo) * 4);
+            for (int y(y0); y < y1; y++)
+            {
+                std::span<const uint32_t> row(src.row(y));
+                float* out(&tmp[(size_t) (y - y0) * (x1 - x0) * 4]);
+#if defined(__SSE2__)
+                for (int x(lo); x < hi; x++)
+                    _mm_storeu_ps(&line[(x-lo)*4], load_premultiplied(row[x]));
+
+                for (int x(x0); x < x1; x++)
+                {
+                    const float* weights(&cx.weights[(size_t) x * cx.stride]);
+                    const float* in(&line[(cx.first[x] - lo) * 4]);
+                    __m128 acc(_mm_setzero_ps());
+                    for (int k(0); k < cx.count[x]; k++)
+                        acc = _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(&in[k*4]),
+                                                         _mm_set1_ps(weights[k])));
+                    _mm_storeu_ps(&out[(x-x0)*4], acc);
+                }
+#else
+                for (int x(lo); x < hi; x++)
+                    load_premultiplied(row[x], &line[(x-lo)*4]);
+
+                for (int x(x0); x < x1; x++)
+                {
+                    const float* weights(&cx.weights[(size_t) x * cx.stride]);
+                    const float* in(&line[(cx.first[x] - lo) * 4]);
+                    float acc[4] = {0, 0, 0, 0};
+                    for (int k(0); k < cx.count[x]; k++)
+                        for (int c(0); c < 4; c++)
+                            acc[c] += in[k*4+c] * weights[k];
+                    for (int c(0); c < 4; c++)
+                        out[(x-x0)*4+c] = acc[c];
+                }
+#endif
+            }
+        }
+
+        // Second pass: destination rows [y0, y1) resampled vertically from tmp
+        // (width columns, first row being the source row ty), written to dst
+        // from (dx, y - dy)
+        void resample_columns(const float* tmp, int ty, int width, const contributions& cy,
+                              PixelMap& dst, int dx, int dy, int y0, int y1)
+        {
+            int n(width * 4);
+            std::vector<float> acc(n);
+            for (int y(y0); y < y1; y++)
+            {
+                std::fill(acc.begin(), acc.end(), 0.0f);
+                const float* weights(&cy.weights[(size_t) y * cy.stride]);
+                for (int k(0); k < cy.count[y]; k++)
+                {
+                    const float* in(&tmp[(size_t) (cy.first[y] + k - ty) * n]);
+                    int i(0);
+#if defined(__SSE2__)
+                    __m128 w(_mm_set1_ps(weights[k]));
+                    for (; i + 4 <= n; i += 4)
+                        _mm_storeu_ps(&acc[i], _mm_add_ps(_mm_loadu_ps(&acc[i]),
+                                                          _mm_mul_ps(_mm_loadu_ps(&in[i]), w)));
+#endif
+                    for (; i < n; i++)
+                        acc[i] += in[i] * weights[k];
+                }
+
+                std::span<uint32_t> row(dst.row(y - dy).subspan(dx, width));
+                for (int x(0); x < width; x++)
+                {
+#if defined(__SSE2__)
+                    row[x] = store_unpremultiplied(_mm_loadu_ps(&acc[x*4]));
+#else
+                    row[x] = store_unpremultiplied(&acc[x*4]);
+#endif
+                }
+            }
+        }
+    }
+
+    PixelMap PixelMap::resize(int width, int height, Filter filter) const
+    {
+        if (width <= 0)
+            width = this->width();
+        if (height <= 0)
+            height = this->height();
+
+        // An empty source resizes to a blank (transparent) map
+        PixelMap pixelMap(width, height);
+        if (m_size == 0)
+            return pixelMap;
+
+        if (filter == FILTER_NEAREST)
+        {
+            // Source column of each destination column (computed once)
+            std::vector<int> srcX(width);
+            for (int x = 0; x < width; x++)
+                srcX[x] = (x*m_width)/width;
+
+            for (int y = 0; y < height; y++)
+            {
+                std::span<const uint32_t> src(row((y*m_height)/height));
+                std::span<uint32_t> dst(pixelMap.row(y));
+                for (int x = 0; x < width; x++)
+                    dst[x] = src[srcX[x]];
+            }
+            return pixelMap;
+        }
+
+        // Two-pass separable resampling: horizontal then vertical
+        contributions cx(compute_contributions(m_width, width, filter));
+        contributions cy(compute_contributions(m_height, height, filter));
+        std::vector<float> tmp((size_t) m_height * width * 4);
+
+        parallel_for(0, m_height, RESAMPLE_GRAIN, [&](int y0, int y1) {
+            resample_rows(*this, cx, &tmp[(size_t) y0 * width * 4], 0, width, y0, y1);
+        });
+        parallel_for(0, height, RESAMPLE_GRAIN, [&](int y0, int y1) {
+            resample_columns(tmp.data(), 0, width, cy, pixelMap, 0, 0, y0, y1);
+        });
+
+        return pixelMap;
+    }
+
+    struct Resampler::axes
+    {
+        contributions x, y;
+    };
+
+    Resampler::Resampler(std::shared_ptr<const PixelMap> source, int width, int height,
+                         PixelMap::Filter filter, Finisher finish):
+            m_source(std::move(source)), m_width(width), m_height(height),
+            m_filter(m_source->size() == 0 ? PixelMap::FILTER_NEAREST : filter),
+            m_finish(std::move(finish))
+    {
+        int sw(m_source->width()), sh(m_source->height());
+        if (m_filter != PixelMap::FILTER_NEAREST && (sw != width || sh != height))
+            m_axes = std::make_unique<const axes>(axes{compute_contributions(sw, width, m_filter),
+                                                       compute_contributions(sh, height, m_filter)});
+
+        m_opaque.assign((size_t) (sw + 1) * (sh + 1), 0);
+        for (int y(0); y < sh; y++)
+        {
+            std::span<const uint32_t> row(m_source->row(y));
+            uint32_t count(0);
+            for (int x(0); x < sw; x++)
+            {
+                count += rgba8_alpha(row[x]) != 0;
+                m_opaque[(size_t) (y + 1) * (sw + 1) + x + 1] =
+                        m_opaque[(size_t) y * (sw + 1) + x + 1] + count;
+            }
+        }
+    }
+
+    Resampler::Resampler(Resampler &&resampler) noexcept = default;
+
+    Resampler::~Resampler() = default;
+
+    void Resampler::sample(int x, int y, PixelMap &window) const
+    {
+        std::fill(window.data(), window.data() + window.size(), 0u);
+        int x0(std::max(0, x)), x1(std::min(m_width, x + window.width()));
+        int y0(std::max(0, y)), y1(std::min(m_height, y + window.height()));
+        const PixelMap& src(*m_source);
+
+        if (x0 < x1 && y0 < y1 && src.size() != 0)
+        {
+            if (m_axes)
+            {
+                // Only the source rows and columns under the window
+                int sy0, sy1;
+                source_span(m_axes->y, y0, y1, sy0, sy1);
+                std::vector<float> tmp((size_t) (sy1 - sy0) * (x1 - x0) * 4);
+                resample_rows(src, m_axes->x, tmp.data(), x0, x1, sy0, sy1);
+                resample_columns(tmp.data(), sy0, x1 - x0, m_axes->y, window,
+                                 x0 - x, y, y0, y1);
+            }
+            else
+            {
+                // Same size (copy) or nearest neighbour
+                for (int py(y0); py < y1; py++)
+                {
+                    std::span<const uint32_t> in(src.row((py * src.height()) / m_height));
+                    std::span<uint32_t> out(window.row(py - y));
+                    for (int px(x0); px < x1; px++)
+                        out[px - x] = in[(px * src.width()) / m_width];
+                }
+            }
+        }
+        if (m_finish)
+            m_finish(window, x, y);
+    }
+
+    bool Resampler::transparent(int x, int y, int width, int height) const
+    {
+        int x0(std::max(0, x)), x1(std::min(m_width, x + width));
+        int y0(std::max(0, y)), y1(std::min(m_height, y + height));
+        if (x0 >= x1 || y0 >= y1)
+            return true;
+
+        // Source pixels contributing to the window
+        int sx0, sx1, sy0, sy1;
+        if (m_axes)
+        {
+            source_span(m_axes->x, x0, x1, sx0, sx1);
+            source_span(m_axes->y, y0, y1, sy0, sy1);
+        }
+        else
+        {
+            const PixelMap& src(*m_source);
+            sx0 = (x0 * src.width()) / m_width;
+            sx1 = ((x1 - 1) * src.width()) / m_width + 1;
+            sy0 = (y0 * src.height()) / m_height;
+            sy1 = ((y1 - 1) * src.height()) / m_height + 1;
+        }
+
+        size_t stride((size_t) m_source->width() + 1);
+        return m_opaque[sy1 * stride + sx1] - m_opaque[sy0 * stride + sx1]
+               - m_opaque[sy1 * stride + sx0] + m_opaque[sy0 * stride + sx0] == 0;
+    }
+}
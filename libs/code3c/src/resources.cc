@@ -0,0 +1,95 @@
+#include "code3c/resources.hh"
+#include "code3c/3ccodelib.hh"
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace code3c
+{
+    // Generated by cmake/EmbedResources.cmake
+    extern const embedded_resource code3c_embedded_resources[];
+    extern const size_t code3c_embedded_resources_count;
+
+    namespace
+    {
+        const embedded_resource* find_embedded(const char* name)
+        {
+            for (const embedded_resource& res : embedded_resources())
+                if (strcmp(res.name, name) == 0)
+                    return &res;
+            return nullptr;
+        }
+
+        std::string search(const char* name)
+        {
+            static const char* const directories[] = {
+#ifdef CODE3C_UNIX
+                    "/usr/share/code3c/",
+                    "/usr/local/share/code3c/",
+#endif
+                    "resources/"
+            };
+
+            for (const char* directory : directories)
+            {
+                std::string path(std::string(directory) + name);
+                std::error_code error;
+                if (std::filesystem::exists(path, error))
+                {
+                    cDebug("ressources: %s\n", path.c_str());
+                    return path;
+                }
+            }
+            fprintf(stderr, "unable to find resources '%s'\n", name);
+            return name;
+        }
+    }
+
+    std::span<const embedded_resource> embedded_resources()
+    {
+        return {code3c_embedded_resources, code3c_embedded_resources_count};
+    }
+
+    const char* resource_path(const char* name)
+    {
+        static std::mutex mutex;
+        // Node-based: the strings never move once inserted
+        static std::unordered_map<std::string, std::string> resolved;
+
+        std::lock_guard<std::mutex> lock(mutex);
+        auto found(resolved.find(name));
+        if (found == resolved.end())
+        {
+            std::string path(find_embedded(name)
+                             ? std::string(CODE3C_RESOURCE_PREFIX) + name
+                             : search(name));
+            found = resolved.emplace(name, std::move(path)).first;
+        }
+        return found->second.c_str();
+    }
+
+    std::span<const uint8_t> resource_data(const char* path)
+    {
+        size_t prefix(strlen(CODE3C_RESOURCE_PREFIX));
+        if (strncmp(path, CODE3C_RESOURCE_PREFIX, prefix) != 0)
+            return {};
+        const embedded_resource* res(find_embedded(path + prefix));
+        return res ? std::span<const uint8_t>(res->data, res->size)
+                   : std::span<const uint8_t>();
+    }
+
+    bool has_extension(const char* fname, const char* ext)
+    {
+        size_t len(strlen(fname)), extlen(strlen(ext));
+        if (len < extlen)
+            return false;
+        for (size_t i(0); i < extlen; i++)
+            if (tolower(fname[len - extlen + i]) != tolower(ext[i]))
+                return false;
+        return true;
+    }
+}
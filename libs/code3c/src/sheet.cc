@@ -0,0 +1,133 @@
+#include "code3c/sheet.hh"
+#include "code3c/tiledraster.hh"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace code3c
+{
+    namespace
+    {
+        // Replays the sheet at scale 1
+        class SheetSVGDrawer : public SVGDrawer
+        {
+            const DisplayList& m_list;
+
+            static const mat8_t& no_data()
+            {
+                static const mat8_t data(1);
+                return data;
+            }
+        public:
+            explicit SheetSVGDrawer(const DisplayList& list) :
+                    SVGDrawer(list.width(), list.height(), no_data()), m_list(list) {}
+
+            void setup() override {}
+            void draw() override { m_list.replay(*this, 1.0); }
+        };
+    }
+
+    Code3CSheet::Code3CSheet(int columns):
+            m_columns(columns)
+    {
+        if (columns < 1)
+            throw std::runtime_error("A sheet needs at least one column");
+    }
+
+    Code3C& Code3CSheet::add(const char *utf8buf, size_t buflen)
+    {
+        m_display.reset();
+        m_codes.push_back(std::make_unique<Code3C>(utf8buf, buflen));
+        return *m_codes.back();
+    }
+
+    void Code3CSheet::setAntialiased(bool antialiased)
+    {
+        m_antialiased = antialiased;
+    }
+
+    bool Code3CSheet::generate(WorkPool &pool)
+    {
+        m_display.reset();
+        std::vector<char> generated(m_codes.size());
+        pool.run((int) m_codes.size(), [this, &generated](int i) {
+            generated[i] = m_codes[i]->generate();
+        });
+        return std::all_of(generated.begin(), generated.end(), [](char ok) { return ok; });
+    }
+
+    std::shared_ptr<const DisplayList> Code3CSheet::displayList() const
+    {
+        if (m_codes.empty())
+            throw std::runtime_error("3C-Code sheet is empty");
+        if (m_display)
+            return m_display;
+
+        // Codes laid out in parallel, then placed in reading order
+        std::vector<std::shared_ptr<const DisplayList>> lists(m_codes.size());
+        WorkPool::instance().run((int) m_codes.size(), [this, &lists](int i) {
+            lists[i] = m_codes[i]->displayList();
+        });
+
+        int cell(0);
+        for (const auto& list : lists)
+            cell = std::max({cell, list->width(), list->height()});
+
+        int columns((int) std::min<size_t>(m_columns, m_codes.size()));
+        DisplayList sheet(columns * cell, rows() * cell);
+        sheet.background(0xffffff);
+        for (size_t i(0); i < lists.size(); i++)
+        {
+            int column((int) (i % m_columns)), row((int) (i / m_columns));
+            sheet.append(*lists[i], column * cell + (cell - lists[i]->width()) / 2,
+                         row * cell + (cell - lists[i]->height()) / 2);
+        }
+        m_display = std::make_shared<const DisplayList>(std::move(sheet));
+        return m_display;
+    }
+
+    std::vector<uint8_t> Code3CSheet::render(PixelMap::Format format) const
+    {
+        std::shared_ptr<const DisplayList> list(displayList());
+        TiledRasterizer raster(*list, 1.0, m_antialiased);
+        return PixelMap::encode(raster.render(), format);
+    }
+
+    std::string Code3CSheet::renderSVG() const
+    {
+        std::shared_ptr<const DisplayList> list(displayList());
+        SheetSVGDrawer svg(*list);
+        svg.run();
+        return svg.svg();
+    }
+
+    void Code3CSheet::save(const char *fname) const
+    {
+        std::shared_ptr<const DisplayList> list(displayList());
+        FILE* dest = fopen(fname, "wb");
+        if (!dest)
+            throw std::runtime_error("Unable to open output file");
+        try
+        {
+            if (has_extension(fname, ".svg"))
+            {
+                std::string document(renderSVG());
+                if (fwrite(document.data(), 1, document.size(), dest) != document.size())
+                    throw std::runtime_error("Unable to write output file");
+            }
+            else
+            {
+                TiledRasterizer raster(*list, 1.0, m_antialiased);
+                raster.save(dest, PixelMap::formatOf(fname), PixelMap::PNGOptions());
+            }
+        }
+        catch (...)
+        {
+            fclose(dest);
+            throw;
+        }
+        // Buffered data is only written on close
+        if (fclose(dest) != 0)
+            throw std::runtime_error("Unable to write output file");
+    }
+}
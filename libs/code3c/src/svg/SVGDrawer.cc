@@ -0,0 +1,547 @@
+#include "code3c/drawer.hh"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdarg>
+#include <cstdio>
+#include <map>
+#include <stdexcept>
+#include <tuple>
+#include <unordered_map>
+
+namespace code3c
+{
+    namespace
+    {
+        void append(std::string& out, const char* format, ...)
+            __attribute__((format(printf, 2, 3)));
+
+        void append(std::string& out, const char* format, ...)
+        {
+            char buffer[256];
+            va_list args;
+            va_start(args, format);
+            int len(vsnprintf(buffer, sizeof(buffer), format, args));
+            va_end(args);
+            out.append(buffer, std::min(len, (int) sizeof(buffer) - 1));
+        }
+
+        void append_base64(std::string& out, const std::vector<uint8_t>& data)
+        {
+            static const char table[] =
+                    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+            size_t i(0);
+            for (; i + 2 < data.size(); i += 3)
+            {
+                uint32_t v((data[i] << 16) | (data[i+1] << 8) | data[i+2]);
+                out += table[(v >> 18) & 63];
+                out += table[(v >> 12) & 63];
+                out += table[(v >> 6) & 63];
+                out += table[v & 63];
+            }
+            if (i < data.size())
+            {
+                uint32_t v(data[i] << 16);
+                if (i + 1 < data.size())
+                    v |= data[i+1] << 8;
+                out += table[(v >> 18) & 63];
+                out += table[(v >> 12) & 63];
+                out += i + 1 < data.size() ? table[(v >> 6) & 63] : '=';
+                out += '=';
+            }
+        }
+
+        // FNV-1a of the pixels
+        uint64_t pixel_hash(const PixelMap& map)
+        {
+            uint64_t hash(0xcbf29ce484222325ull);
+            for (uint32_t i(0); i < map.size(); i++)
+                hash = (hash ^ map.data()[i]) * 0x100000001b3ull;
+            return hash;
+        }
+
+        /**
+         * Outline, as one path per colour, of the pixels in [x0, x1[ x [y0, y1[
+         * of the map, moved by (dx, dy). Edges of the pixels are merged along
+         * the rows and columns, outlines turning clockwise around the pixels
+         * and anti-clockwise around the holes (nonzero fill rule).
+         *
+         * @return false, nothing being written, if a pixel is partially
+         * transparent or if there are more than CODE3C_SVG_TRACED colours
+         */
+        bool trace(std::string& out, const PixelMap& map, int x0, int y0, int x1, int y1,
+                   int dx, int dy)
+        {
+            int width(x1 - x0), height(y1 - y0);
+            std::vector<uint32_t> colors;
+            std::vector<int8_t> index((size_t) width * height, -1);
+            for (int y(0); y < height; y++)
+            {
+                std::span<const uint32_t> row(map.row(y0 + y));
+                for (int x(0); x < width; x++)
+                {
+                    uint32_t px(row[x0 + x]);
+                    if (rgba8_alpha(px) == 0)
+                        continue;
+                    if (rgba8_alpha(px) != 0xff)
+                        return false;
+                    auto color(std::find(colors.begin(), colors.end(), px));
+                    if (color == colors.end())
+                    {
+                        if (colors.size() == CODE3C_SVG_TRACED)
+                            return false;
+                        color = colors.insert(colors.end(), px);
+                    }
+                    index[(size_t) y * width + x] = (int8_t) (color - colors.begin());
+                }
+            }
+
+            struct edge
+            {
+                int x0, y0, x1, y1;
+            };
+            for (size_t c(0); c < colors.size(); c++)
+            {
+                auto in = [&](int x, int y) {
+                    return x >= 0 && y >= 0 && x < width && y < height &&
+                           index[(size_t) y * width + x] == (int8_t) c;
+                };
+
+                // Runs of exposed sides: top and bottom along the rows, left
+                // and right along the columns
+                std::vector<edge> edges;
+                for (int y(0); y < height; y++)
+                    for (int side : {-1, 1})
+                        for (int x(0); x < width;)
+                        {
+                            if (!in(x, y) || in(x, y + side))
+                            {
+                                x++;
+                                continue;
+                            }
+                            int start(x);
+                            while (x < width && in(x, y) && !in(x, y + side))
+                                x++;
+                            edges.push_back(side < 0 ? edge{start, y, x, y}
+                                                     : edge{x, y + 1, start, y + 1});
+                        }
+                for (int x(0); x < width; x++)
+                    for (int side : {-1, 1})
+                        for (int y(0); y < height;)
+                        {
+                            if (!in(x, y) || in(x + side, y))
+                            {
+                                y++;
+                                continue;
+                            }
+                            int start(y);
+                            while (y < height && in(x, y) && !in(x + side, y))
+                                y++;
+                            edges.push_back(side > 0 ? edge{x + 1, start, x + 1, y}
+                                                     : edge{x, y, x, start});
+                        }
+
+                // Runs only meet at their ends: chain them into closed outlines
+                auto key = [](int x, int y) { return ((uint64_t) (uint32_t) x << 32) | (uint32_t) y; };
+                std::unordered_map<uint64_t, std::vector<uint32_t>> from;
+                for (uint32_t e(0); e < edges.size(); e++)
+                    from[key(edges[e].x0, edges[e].y0)].push_back(e);
+                std::vector<bool> used(edges.size(), false);
+
+                append(out, "<path fill=\"#%06lx\" d=\"", (unsigned long) (colors[c] & 0xffffff));
+                for (uint32_t first(0); first < edges.size(); first++)
+                {
+                    if (used[first])
+                        continue;
+                    append(out, "M%d %d", edges[first].x0 + x0 + dx, edges[first].y0 + y0 + dy);
+                    for (uint32_t e(first); !used[e];)
+                    {
+                        used[e] = true;
+                        const edge& run(edges[e]);
+                        if (run.y0 == run.y1)
+                            append(out, "h%d", run.x1 - run.x0);
+                        else
+                            append(out, "v%d", run.y1 - run.y0);
+                        for (uint32_t next : from[key(run.x1, run.y1)])
+                            if (!used[next])
+                            {
+                                e = next;
+                                break;
+                            }
+                    }
+                    out += 'Z';
+                }
+                out += "\"/>\n";
+            }
+            return true;
+        }
+
+        /**
+         * @return true if the two angular ranges (degrees) intersect
+         */
+        bool overlap(int start1, int degree1, int start2, int degree2)
+        {
+            return ((start2 - start1) % 360 + 360) % 360 < degree1 ||
+                   ((start1 - start2) % 360 + 360) % 360 < degree2;
+        }
+    }
+
+    SVGDrawer::SVGDrawer(int width, int height, const mat8_t &data):
+            Drawer(width, height, data), m_foreground(0)
+    {
+    }
+
+    SVGDrawer::SVGDrawer(const SVGDrawer &svgDrawer):
+            Drawer(svgDrawer), m_body(svgDrawer.m_body),
+            m_slices(svgDrawer.m_slices), m_images(svgDrawer.m_images),
+            m_foreground(svgDrawer.m_foreground)
+    {
+    }
+
+    void SVGDrawer::show(bool)
+    {
+    }
+
+    void SVGDrawer::setTitle(const char *)
+    {
+    }
+
+    void SVGDrawer::setHeigh(int height)
+    {
+        m_height = height;
+    }
+
+    void SVGDrawer::setWidth(int width)
+    {
+        m_width = width;
+    }
+
+    void SVGDrawer::run()
+    {
+        this->setup();
+        this->draw();
+        flush_slices();
+    }
+
+    void SVGDrawer::exit()
+    {
+    }
+
+    void SVGDrawer::clear()
+    {
+        m_body.clear();
+        m_slices.clear();
+        m_images.clear();
+    }
+
+    unsigned long SVGDrawer::frameRate() const
+    {
+        return 0;
+    }
+
+    void SVGDrawer::savePNG(const char *) const
+    {
+        throw std::runtime_error("SVGDrawer cannot save png files");
+    }
+
+    std::string SVGDrawer::svg() const
+    {
+        std::string out;
+        append(out, "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+                    "<svg xmlns=\"http://www.w3.org/2000/svg\" "
+                    "width=\"%d\" height=\"%d\" viewBox=\"0 0 %d %d\">\n",
+               m_width, m_height, m_width, m_height);
+        out += m_body;
+        write_slices(out);
+        out += "</svg>\n";
+        return out;
+    }
+
+    void SVGDrawer::saveSVG(const char *name) const
+    {
+        FILE * dest = fopen(name, "wb");
+        if (dest)
+        {
+            std::string document(svg());
+            fwrite(document.data(), 1, document.size(), dest);
+            fclose(dest);
+        }
+    }
+
+    /* draw functions */
+
+    void SVGDrawer::flush_slices()
+    {
+        write_slices(m_body);
+        m_slices.clear();
+    }
+
+    void SVGDrawer::write_slices(std::string& out) const
+    {
+        // Pending slices never overlap a later, larger one (see draw_slice),
+        // so they can be painted from the outer radius inwards, each one
+        // down to the inner ring hiding the rest of it
+        std::vector<const slice*> order;
+        order.reserve(m_slices.size());
+        for (const slice& s : m_slices)
+            order.push_back(&s);
+        std::stable_sort(order.begin(), order.end(), [](auto a, auto b) {
+            return a->radius > b->radius;
+        });
+
+        // Angular ranges covered by each ring, merged, over two turns so that
+        // a range crossing 0 degree is found whole
+        std::map<std::tuple<int, int, int>, std::vector<std::pair<int, int>>> rings;
+        for (const slice& s : m_slices)
+        {
+            auto& ranges(rings[{s.x, s.y, s.radius}]);
+            if (s.degree >= 360)
+                ranges.emplace_back(0, 720);
+            else
+            {
+                ranges.emplace_back(s.start, s.start + s.degree);
+                ranges.emplace_back(s.start + 360, s.start + 360 + s.degree);
+            }
+        }
+        for (auto& [ring, ranges] : rings)
+        {
+            std::sort(ranges.begin(), ranges.end());
+            std::vector<std::pair<int, int>> merged;
+            for (const auto& range : ranges)
+            {
+                if (!merged.empty() && range.first <= merged.back().second)
+                    merged.back().second = std::max(merged.back().second, range.second);
+                else
+                    merged.push_back(range);
+            }
+            ranges = std::move(merged);
+        }
+
+        for (const slice* s : order)
+        {
+            // The inner rings are painted next: the slice stops at the largest
+            // one covering its whole angular range (0 for a pie)
+            int inner(0), degree(std::min(360, s->degree));
+            for (auto it(rings.lower_bound({s->x, s->y, s->radius})); inner == 0 &&
+                 it != rings.begin() && std::get<0>(std::prev(it)->first) == s->x &&
+                 std::get<1>(std::prev(it)->first) == s->y; it--)
+            {
+                for (const auto& range : std::prev(it)->second)
+                    if ((range.first <= s->start && range.second >= s->start + degree) ||
+                        (range.first <= s->start + 360 && range.second >= s->start + 360 + degree))
+                        inner = std::get<2>(std::prev(it)->first);
+            }
+
+            if (s->degree >= 360)
+            {
+                if (inner == 0)
+                {
+                    append(out, "<circle cx=\"%d\" cy=\"%d\" r=\"%d\" fill=\"#%06lx\"/>\n",
+                           s->x, s->y, s->radius, s->color & 0xffffff);
+                    continue;
+                }
+                // Two half turns each way: the inner circle is a hole
+                append(out, "<path d=\"M%d %dA%d %d 0 1 0 %d %dA%d %d 0 1 0 %d %dZ",
+                       s->x + s->radius, s->y, s->radius, s->radius, s->x - s->radius, s->y,
+                       s->radius, s->radius, s->x + s->radius, s->y);
+                append(out, "M%d %dA%d %d 0 1 1 %d %dA%d %d 0 1 1 %d %dZ\" fill=\"#%06lx\"/>\n",
+                       s->x + inner, s->y, inner, inner, s->x - inner, s->y,
+                       inner, inner, s->x + inner, s->y, s->color & 0xffffff);
+                continue;
+            }
+
+            double a0(s->start * M_PI / 180.0);
+            double a1((s->start + s->degree) * M_PI / 180.0);
+            if (inner == 0)
+            {
+                append(out, "<path d=\"M%d %dL%.2f %.2fA%d %d 0 %d 0 %.2f %.2fZ\" "
+                            "fill=\"#%06lx\"/>\n",
+                       s->x, s->y,
+                       s->x + s->radius * std::cos(a0), s->y - s->radius * std::sin(a0),
+                       s->radius, s->radius, s->degree > 180 ? 1 : 0,
+                       s->x + s->radius * std::cos(a1), s->y - s->radius * std::sin(a1),
+                       s->color & 0xffffff);
+                continue;
+            }
+
+            // Annular sector: outer arc anti-clockwise, inner arc back
+            append(out, "<path d=\"M%.2f %.2fA%d %d 0 %d 0 %.2f %.2f",
+                   s->x + s->radius * std::cos(a0), s->y - s->radius * std::sin(a0),
+                   s->radius, s->radius, s->degree > 180 ? 1 : 0,
+                   s->x + s->radius * std::cos(a1), s->y - s->radius * std::sin(a1));
+            append(out, "L%.2f %.2fA%d %d 0 %d 1 %.2f %.2fZ\" fill=\"#%06lx\"/>\n",
+                   s->x + inner * std::cos(a1), s->y - inner * std::sin(a1),
+                   inner, inner, s->degree > 180 ? 1 : 0,
+                   s->x + inner * std::cos(a0), s->y - inner * std::sin(a0),
+                   s->color & 0xffffff);
+        }
+    }
+
+    void SVGDrawer::background(unsigned long color)
+    {
+        // Everything drawn before is hidden
+        m_body.clear();
+        m_slices.clear();
+        m_images.clear();
+        append(m_body, "<rect width=\"100%%\" height=\"100%%\" fill=\"#%06lx\"/>\n",
+               color & 0xffffff);
+    }
+
+    void SVGDrawer::foreground(unsigned long color)
+    {
+        m_foreground = color;
+    }
+
+    void SVGDrawer::draw_pixel(unsigned long color, int x, int y)
+    {
+        flush_slices();
+        append(m_body, "<rect x=\"%d\" y=\"%d\" width=\"1\" height=\"1\" "
+                       "fill=\"#%06lx\"/>\n", x, y, color & 0xffffff);
+    }
+
+    void SVGDrawer::draw_text(const char *str, int x, int y)
+    {
+        flush_slices();
+        append(m_body, "<text x=\"%d\" y=\"%d\" fill=\"#%06lx\">", x, y,
+               m_foreground & 0xffffff);
+        for (const char* c(str); *c; c++)
+        {
+            switch (*c)
+            {
+                case '<': m_body += "&lt;"; break;
+                case '>': m_body += "&gt;"; break;
+                case '&': m_body += "&amp;"; break;
+                default:  m_body += *c;
+            }
+        }
+        m_body += "</text>\n";
+    }
+
+    void SVGDrawer::draw_slice(
+            int origin_x, int origin_y, int radius, int degree, int rotation
+            )
+    {
+        // Same angles as XFillArc: counter-clockwise from 3 o'clock
+        slice next{origin_x, origin_y, radius, rotation - degree/2, degree,
+                   m_foreground};
+        if (next.degree < 0)
+        {
+            next.start += next.degree;
+            next.degree = -next.degree;
+        }
+        next.start = (next.start % 360 + 360) % 360;
+
+        // Extend the last run of the ring when contiguous and of the same
+        // colour, unless a slice drawn since then would be painted over
+        for (auto it(m_slices.rbegin()); it != m_slices.rend(); it++)
+        {
+            bool sameOrigin(it->x == origin_x && it->y == origin_y);
+            if (sameOrigin && it->radius == radius)
+            {
+                int offset(((next.start - it->start) % 360 + 360) % 360);
+                if (it->color == next.color && offset <= it->degree)
+                {
+                    it->degree = std::min(360, std::max(it->degree,
+                                                        offset + next.degree));
+                    return;
+                }
+                break;
+            }
+            if (!sameOrigin || (it->radius < radius &&
+                overlap(it->start, it->degree, next.start, next.degree)))
+                break;
+        }
+
+        // Pending slices are painted from the outer radius inwards: a smaller
+        // slice drawn before and covered by this one must be written first
+        for (const slice& s : m_slices)
+        {
+            if (s.radius < radius && (s.x != origin_x || s.y != origin_y ||
+                overlap(s.start, s.degree, next.start, next.degree)))
+            {
+                flush_slices();
+                break;
+            }
+        }
+        m_slices.push_back(next);
+    }
+
+    void SVGDrawer::fill_circle(int x, int y, int radius)
+    {
+        flush_slices();
+        append(m_body, "<circle cx=\"%d\" cy=\"%d\" r=\"%d\" fill=\"#%06lx\"/>\n",
+               x, y, radius, m_foreground & 0xffffff);
+    }
+
+    void SVGDrawer::draw_line(int x1, int y1, int x2, int y2)
+    {
+        flush_slices();
+        append(m_body, "<line x1=\"%d\" y1=\"%d\" x2=\"%d\" y2=\"%d\" "
+                       "stroke=\"#%06lx\"/>\n",
+               x1, y1, x2, y2, m_foreground & 0xffffff);
+    }
+
+    void SVGDrawer::blit(const PixelMap &pixelMap, int x, int y, const Rect& clip)
+    {
+        int x0(std::max({clip.x, 0, x})), y0(std::max({clip.y, 0, y}));
+        int x1(std::min({clip.x + clip.width, m_width, x + pixelMap.width()}));
+        int y1(std::min({clip.y + clip.height, m_height, y + pixelMap.height()}));
+        if (x0 >= x1 || y0 >= y1)
+            return;
+
+        flush_slices();
+        bool whole(x1 - x0 == pixelMap.width() && y1 - y0 == pixelMap.height());
+        if (whole)
+        {
+            uint64_t hash(pixel_hash(pixelMap));
+            auto same(std::find_if(m_images.begin(), m_images.end(), [&](const image& img) {
+                return img.width == pixelMap.width() && img.height == pixelMap.height() &&
+                       img.hash == hash;
+            }));
+            if (same != m_images.end())
+            {
+                append(m_body, "<use href=\"#img%d\" x=\"%d\" y=\"%d\"/>\n",
+                       (int) (same - m_images.begin()), x - same->x, y - same->y);
+                return;
+            }
+
+            // Few opaque colours (e.g. the marker): outlined
+            std::string outline;
+            if (trace(outline, pixelMap, 0, 0, pixelMap.width(), pixelMap.height(), x, y))
+            {
+                append(m_body, "<g id=\"img%d\">\n", (int) m_images.size());
+                m_body += outline;
+                m_body += "</g>\n";
+                m_images.push_back({pixelMap.width(), pixelMap.height(), hash, x, y});
+                return;
+            }
+            append(m_body, "<image id=\"img%d\" ", (int) m_images.size());
+            m_images.push_back({pixelMap.width(), pixelMap.height(), hash, x, y});
+        }
+        else
+        {
+            if (trace(m_body, pixelMap, x0 - x, y0 - y, x1 - x, y1 - y, x, y))
+                return;
+            m_body += "<image ";
+        }
+        append(m_body, "x=\"%d\" y=\"%d\" width=\"%d\" height=\"%d\" "
+                       "href=\"data:image/png;base64,", x0, y0, x1 - x0, y1 - y0);
+        if (whole)
+        {
+            append_base64(m_body, PixelMap::encodePNG(pixelMap));
+        }
+        else
+        {
+            // Only the visible part is embedded
+            PixelMap part(x1 - x0, y1 - y0);
+            for (int py(y0); py < y1; py++)
+            {
+                std::span<const uint32_t> src(pixelMap.row(py - y));
+                std::copy(src.begin() + (x0 - x), src.begin() + (x1 - x),
+                          part.row(py - y0).begin());
+            }
+            append_base64(m_body, PixelMap::encodePNG(part));
+        }
+        m_body += "\"/>\n";
+    }
+}
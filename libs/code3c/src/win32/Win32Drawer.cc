@@ -286,17 +286,17 @@ namespace code3c
             for (int y(0); y < height(); y++)
             {
                 COLORREF color(GetPixel(m_hdc, x, y));
-                pixelMap[x,y] = {
-                        x, y,
-                        rgb(GetRValue(color), GetGValue(color), GetBValue(color)),
-                        0xff
-                };
+                pixelMap.set(x, y, rgb(GetRValue(color), GetGValue(color),
+                                       GetBValue(color)));
             }
         }
         FILE * dest = fopen(name, "wb");
         if (dest)
         {
-            PixelMap::saveInPng(pixelMap, dest);
+            std::vector<uint32_t> colors(palette());
+            PixelMap::PNGOptions opts;
+            opts.palette = colors;
+            PixelMap::saveInPng(pixelMap, dest, opts);
             fclose(dest);
         }
     }
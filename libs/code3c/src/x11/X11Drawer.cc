@@ -1,17 +1,187 @@
 #include "code3c/drawer.hh"
 
 #include <unistd.h>
-#include <ctime>
+#include <poll.h>
+#ifdef __linux__
+#include <sys/timerfd.h>
+#endif // __linux__
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <cstdlib>
 #include <cstring>
+#include <mutex>
 #include <stdexcept>
+#include <vector>
+
+#ifdef CODE3C_XSHM
+#include <sys/ipc.h>
+#include <sys/shm.h>
+#include <X11/extensions/XShm.h>
+#endif // CODE3C_XSHM
 
 namespace code3c
 {
+    namespace
+    {
+        /**
+         * @return the position of an 8 bits wide channel mask, -1 otherwise
+         */
+        int channel_shift(unsigned long mask)
+        {
+            int shift(std::countr_zero(mask));
+            return mask && (mask >> shift) == 0xff ? shift : -1;
+        }
+
+        /**
+         * Convert a ZPixmap image into the packed pixels of a PixelMap. 32 bits
+         * TrueColor images (depth 24 or 32) are converted straight from the
+         * image data, row after row; other visuals go through XGetPixel.
+         */
+        void convert_zpixmap(XImage* img, PixelMap& map)
+        {
+            int rs(channel_shift(img->red_mask)), gs(channel_shift(img->green_mask));
+            int bs(channel_shift(img->blue_mask));
+            bool swap((img->byte_order == LSBFirst) !=
+                      (std::endian::native == std::endian::little));
+
+            if (img->format != ZPixmap || img->bits_per_pixel != 32 ||
+                rs < 0 || gs < 0 || bs < 0)
+            {
+                for (int y(0); y < map.height(); y++)
+                {
+                    std::span<uint32_t> row(map.row(y));
+                    for (int x(0); x < map.width(); x++)
+                        row[x] = rgba8(XGetPixel(img, x, y));
+                }
+                return;
+            }
+
+            for (int y(0); y < map.height(); y++)
+            {
+                auto src = (const uint32_t*) (img->data + (size_t) y * img->bytes_per_line);
+                std::span<uint32_t> row(map.row(y));
+                for (int x(0); x < map.width(); x++)
+                {
+                    uint32_t px(swap ? __builtin_bswap32(src[x]) : src[x]);
+                    row[x] = rgba8(((px >> rs) & 0xff) << 16 | ((px >> gs) & 0xff) << 8 |
+                                   ((px >> bs) & 0xff));
+                }
+            }
+        }
+
+#ifdef CODE3C_XSHM
+        /**
+         * Errors caught on one display from a request serial onwards. While a
+         * trap is set, the errors of the other displays (and threads) go to
+         * the previous handler.
+         */
+        struct error_trap
+        {
+            Display* display;
+            unsigned long serial;
+            bool failed;
+        };
+
+        std::mutex trap_mutex;
+        std::vector<error_trap*> traps;
+        XErrorHandler trap_previous;
+
+        int trap_handler(Display* display, XErrorEvent* ev)
+        {
+            XErrorHandler previous;
+            {
+                std::lock_guard<std::mutex> lock(trap_mutex);
+                for (error_trap* trap : traps)
+                {
+                    if (trap->display == display && ev->serial >= trap->serial)
+                    {
+                        trap->failed = true;
+                        return 0;
+                    }
+                }
+                previous = trap_previous;
+            }
+            return previous ? previous(display, ev) : 0;
+        }
+
+        void trap_errors(error_trap& trap)
+        {
+            std::lock_guard<std::mutex> lock(trap_mutex);
+            if (traps.empty())
+                trap_previous = XSetErrorHandler(trap_handler);
+            traps.push_back(&trap);
+        }
+
+        void untrap_errors(error_trap& trap)
+        {
+            std::lock_guard<std::mutex> lock(trap_mutex);
+            traps.erase(std::find(traps.begin(), traps.end(), &trap));
+            if (traps.empty())
+                XSetErrorHandler(trap_previous);
+        }
+
+        /**
+         * Read a drawable through a shared memory segment.
+         * @return false if MIT-SHM is unavailable (e.g. remote display)
+         */
+        bool shm_capture(Display* display, int screen, Drawable drawable,
+                         PixelMap& map)
+        {
+            if (!XShmQueryExtension(display))
+                return false;
+
+            XShmSegmentInfo info{};
+            XImage* img(XShmCreateImage(display, DefaultVisual(display, screen),
+                                        DefaultDepth(display, screen), ZPixmap,
+                                        nullptr, &info, map.width(), map.height()));
+            if (!img)
+                return false;
+            info.shmid = shmget(IPC_PRIVATE, (size_t) img->bytes_per_line * img->height,
+                                IPC_CREAT | 0600);
+            if (info.shmid < 0)
+            {
+                XDestroyImage(img);
+                return false;
+            }
+            info.shmaddr = img->data = (char*) shmat(info.shmid, nullptr, 0);
+            info.readOnly = False;
+
+            bool done(false);
+            if (info.shmaddr != (char*) -1)
+            {
+                // Attach errors are asynchronous: synchronise to catch them
+                XSync(display, False);
+                error_trap trap{display, NextRequest(display), false};
+                trap_errors(trap);
+                bool attached(XShmAttach(display, &info));
+                XSync(display, False);
+                untrap_errors(trap);
+
+                if (attached && !trap.failed)
+                {
+                    done = XShmGetImage(display, drawable, img, 0, 0, AllPlanes);
+                    if (done)
+                        convert_zpixmap(img, map);
+                    XShmDetach(display, &info);
+                    XSync(display, False);
+                }
+                shmdt(info.shmaddr);
+            }
+            shmctl(info.shmid, IPC_RMID, nullptr);
+            img->data = nullptr;
+            XDestroyImage(img);
+            return done;
+        }
+#endif // CODE3C_XSHM
+    }
+
     X11Drawer::X11Drawer(int width, int height, const code3c::mat8_t &data):
-            Drawer(width, height, data), m_frameRate(fps()),
+            Drawer(width, height, data),
             m_gcvalues(), m_attributes()
     {
         m_display = XOpenDisplay(NULL);
+        if (!m_display) throw std::runtime_error("Unable to open X11 display");
         m_screen = DefaultScreen(m_display);
         m_attributes.background_pixel = WhitePixel(m_display, DefaultScreen(m_display));
         m_window = XCreateSimpleWindow(m_display, RootWindow(m_display,m_screen),
@@ -116,125 +286,215 @@ namespace code3c
     
     unsigned long X11Drawer::frameRate() const
     {
-        return m_frameRate;
+        FrameStats stats(frameStats());
+        return stats.frames && stats.avg > 0 ? (unsigned long) (1000.0 / stats.avg + 0.5) : 0;
     }
     
     void X11Drawer::setup()
     {
     }
     
+    void X11Drawer::process_event(XEvent& event, bool& done, bool& exposed)
+    {
+        switch (event.type)
+        {
+            case KeyPress:
+            case KeyRelease:
+            {
+                keyCode = event.xkey.keycode;
+                XLookupString(&event.xkey, &key, 1, NULL, NULL);
+                // XkbLookupKeySym(m_display, keyCode, 0, &keyMod, &keySym);
+                keySym = XkbKeycodeToKeysym(m_display, keyCode, 0, 0);
+                if (event.type == KeyPress)
+                {
+                    key_binding(true);
+                    onKeyPressed();
+                }
+                if (event.type == KeyRelease)
+                {
+                    onKeyReleased();
+                    key_binding(false);
+                }
+                break;
+            }
+            case MotionNotify:
+            {
+                mouseEvent.pmouseX = mouseEvent.mouseX - event.xbutton.x;
+                mouseEvent.pmouseY = mouseEvent.mouseY - event.xbutton.y;
+                mouseEvent.mouseX = event.xbutton.x;
+                mouseEvent.mouseY = event.xbutton.y;
+                onMouseMoved();
+                if (mouseEvent.button1Pressed)
+                    onMouseDragged();
+                break;
+            }
+            case ButtonRelease:
+            {
+                keyCode = event.xbutton.button;
+                switch (keyCode)
+                {
+                    case 1:
+                        mouseEvent.button1Pressed = false;
+                        break;
+                    case 2:
+                        mouseEvent.button2Pressed = false;
+                        break;
+                }
+                onMouseReleased();
+                break;
+            }
+            case ButtonPress:
+            {
+                mouseEvent.mouseButton = event.xbutton.button;
+                switch (keyCode)
+                {
+                    case 1:
+                        mouseEvent.button1Pressed = true;
+                        break;
+                    case 2:
+                        mouseEvent.button2Pressed = true;
+                        break;
+                }
+                if (mouseEvent.mouseButton < 4)
+                {
+                    onMousePressed();
+                }
+                else if (mouseEvent.mouseButton == 4
+                    || mouseEvent.mouseButton == 5)
+                {
+                    mouseEvent.wheelCount = (keyCode == 4 ? -1 : 1);
+                    onMouseWheel();
+                }
+                break;
+            }
+            case Expose:
+            {
+                if (event.xexpose.count == 0)
+                    exposed = true;
+                break;
+            }
+            case ConfigureNotify:
+            {
+                exposed = true;
+                break;
+            }
+            case ClientMessage:
+            {
+                if (event.xclient.data.l[0] == wmDeleteWindow)
+                    done = true;
+                break;
+            }
+            default:
+                break;
+        }
+    }
+
     void X11Drawer::run()
     {
-        bool done(false);
+        typedef std::chrono::steady_clock clock;
+        bool done(false), exposed(true);
         XEvent event;
         
         this->show(true);
         this->setup();
-        do
+        m_valid = false;
+        reset_frame_stats();
+
+        // Frame tick, armed only when drawing continuously
+        int xfd(ConnectionNumber(m_display));
+        unsigned long armed(0);
+        clock::duration period(0);
+        clock::time_point tick, last;
+        bool drawn(false);
+        // Without a timer descriptor, poll() times out at the next tick
+#ifdef __linux__
+        int tfd(timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC));
+#else
+        int tfd(-1);
+#endif // __linux__
+
+        while (!done)
         {
-            clock_t begin(clock());
-            /* run */ {
-                // Waiting for event
-                while (XPending(m_display))
+            unsigned long rate(m_retained ? 0 : fps());
+            if (rate != armed)
+            {
+                armed = rate;
+                period = armed ? std::chrono::duration_cast<clock::duration>(
+                        std::chrono::nanoseconds(1000000000 / armed)) : clock::duration(0);
+                tick = clock::now() + period;
+#ifdef __linux__
+                long ns(std::chrono::duration_cast<std::chrono::nanoseconds>(period).count());
+                itimerspec spec{{ns / 1000000000, ns % 1000000000},
+                                {ns / 1000000000, ns % 1000000000}};
+                if (tfd >= 0 && timerfd_settime(tfd, 0, &spec, nullptr) < 0)
                 {
-                    XNextEvent(m_display, &event);
-                    switch (event.type)
-                    {
-                        case KeyPress:
-                        case KeyRelease:
-                        {
-                            keyCode = event.xkey.keycode;
-                            XLookupString(&event.xkey, &key, 1, NULL, NULL);
-                            // XkbLookupKeySym(m_display, keyCode, 0, &keyMod, &keySym);
-                            keySym = XkbKeycodeToKeysym(m_display, keyCode, 0, 0);
-                            if (event.type == KeyPress)
-                            {
-                                key_binding(true);
-                                onKeyPressed();
-                            }
-                            if (event.type == KeyRelease)
-                            {
-                                onKeyReleased();
-                                key_binding(false);
-                            }
-                            break;
-                        }
-                        case MotionNotify:
-                        {
-                            mouseEvent.pmouseX = mouseEvent.mouseX - event.xbutton.x;
-                            mouseEvent.pmouseY = mouseEvent.mouseY - event.xbutton.y;
-                            mouseEvent.mouseX = event.xbutton.x;
-                            mouseEvent.mouseY = event.xbutton.y;
-                            onMouseMoved();
-                            if (mouseEvent.button1Pressed)
-                                onMouseDragged();
-                            break;
-                        }
-                        case ButtonRelease:
-                        {
-                            keyCode = event.xbutton.button;
-                            switch (keyCode)
-                            {
-                                case 1:
-                                    mouseEvent.button1Pressed = false;
-                                    break;
-                                case 2:
-                                    mouseEvent.button2Pressed = false;
-                                    break;
-                            }
-                            onMouseReleased();
-                            break;
-                        }
-                        case ButtonPress:
-                        {
-                            mouseEvent.mouseButton = event.xbutton.button;
-                            switch (keyCode)
-                            {
-                                case 1:
-                                    mouseEvent.button1Pressed = true;
-                                    break;
-                                case 2:
-                                    mouseEvent.button2Pressed = true;
-                                    break;
-                            }
-                            if (mouseEvent.mouseButton < 4)
-                            {
-                                onMousePressed();
-                            }
-                            else if (mouseEvent.mouseButton == 4
-                                || mouseEvent.mouseButton == 5)
-                            {
-                                mouseEvent.wheelCount = (keyCode == 4 ? -1 : 1);
-                                onMouseWheel();
-                            }
-                            break;
-                        }
-                        case ClientMessage:
-                        {
-                            if (event.xclient.data.l[0] == wmDeleteWindow)
-                                done = true;
-                            break;
-                        }
-                        default:
-                            break;
-                    }
+                    close(tfd);
+                    tfd = -1;
+                }
+#endif // __linux__
+            }
+
+            // Events already received
+            while (!done && XPending(m_display))
+            {
+                XNextEvent(m_display, &event);
+                process_event(event, done, exposed);
+            }
+            if (done)
+                break;
+
+            // Elapsed ticks
+            bool ticked(false);
+            if (armed && tfd >= 0)
+            {
+                uint64_t expirations;
+                ticked = read(tfd, &expirations, sizeof(expirations)) > 0;
+            }
+            else if (armed)
+            {
+                clock::time_point now(clock::now());
+                if (now >= tick)
+                {
+                    ticked = true;
+                    tick = std::max(tick + period, now);
                 }
+            }
+
+            // Retained mode: the back buffer is only redrawn when invalid
+            if (!m_valid || (!m_retained && ticked))
+            {
+                clock::time_point now(clock::now());
+                if (drawn && !m_retained)
+                    record_frame(std::chrono::duration<double, std::milli>(now - last).count());
                 this->draw();
-                
-                XCopyArea(m_display, m_db, m_window, m_gc, 0, 0, width(), height(),0, 0);
-                XFlush(m_display);
+                m_valid = true;
+                exposed = true;
+                drawn = true;
+                last = now;
             }
-            
-            unsigned long millis((clock()-begin)*1000/CLOCKS_PER_SEC);
-            if ((1000/fps() > millis))
+
+            if (exposed)
             {
-                usleep((1000 / fps() - millis) * 1000);
-                millis += (1000/fps() - millis);
+                XCopyArea(m_display, m_db, m_window, m_gc, 0, 0, width(), height(),0, 0);
+                exposed = false;
             }
-            
-            double _frameRate(1000.0/ (double)millis);
-            m_frameRate = (unsigned long) _frameRate;
-        } while (!done);
+            XFlush(m_display);
+            if (XPending(m_display) || !m_valid)
+                continue;
+
+            // Sleep until an event or the next tick
+            pollfd fds[2] = {{xfd, POLLIN, 0}, {-1, POLLIN, 0}};
+            int timeout(-1);
+            if (armed && tfd >= 0)
+                fds[1].fd = tfd;
+            else if (armed)
+                timeout = (int) std::max<long long>(0, std::chrono::ceil<std::chrono::milliseconds>(
+                        tick - clock::now()).count());
+            poll(fds, 2, timeout);
+        }
+
+        if (tfd >= 0)
+            close(tfd);
     }
     
     void X11Drawer::exit()
@@ -254,30 +514,33 @@ namespace code3c
         foreground(0);
     }
     
+    PixelMap X11Drawer::capture() const
+    {
+        PixelMap pixelMap(width(), height());
+#ifdef CODE3C_XSHM
+        if (shm_capture(m_display, m_screen, m_db, pixelMap))
+            return pixelMap;
+#endif // CODE3C_XSHM
+
+        XImage * img = XGetImage(m_display, m_db, 0, 0, m_width, m_height, AllPlanes, ZPixmap);
+        if (!img)
+            throw std::runtime_error("Unable to read the X11 frame");
+        convert_zpixmap(img, pixelMap);
+        XDestroyImage(img);
+        return pixelMap;
+    }
+
     void X11Drawer::savePNG(const char *name) const
     {
-        XImage * img = XGetImage(m_display, m_db, 0, 0, m_width, m_height, AllPlanes, XYPixmap);
-        if (img)
+        PixelMap pixelMap(capture());
+        FILE * dest = fopen(name, "wb");
+        if (dest)
         {
-            PixelMap pixelMap(width(), height());
-            for (int x(0); x < width(); x++)
-            {
-                for (int y(0); y < height(); y++)
-                {
-                    pixelMap[x,y] = {
-                            x, y,
-                            XGetPixel(img, x, y),
-                            0xff
-                    };
-                }
-            }
-            FILE * dest = fopen(name, "wb");
-            if (dest)
-            {
-                PixelMap::saveInPng(pixelMap, dest);
-                fclose(dest);
-            }
-            XFree(img);
+            std::vector<uint32_t> colors(palette());
+            PixelMap::PNGOptions opts;
+            opts.palette = colors;
+            PixelMap::saveInPng(pixelMap, dest, opts);
+            fclose(dest);
         }
     }
     
@@ -315,6 +578,26 @@ namespace code3c
                  64*rotation, 64*degree);
     }
 
+    void X11Drawer::fill_slices(unsigned long color, std::span<const Slice> slices)
+    {
+        foreground(color);
+        XArc arcs[CODE3C_X11_ARCS];
+        for (size_t i(0); i < slices.size(); i += CODE3C_X11_ARCS)
+        {
+            int count((int) std::min<size_t>(CODE3C_X11_ARCS, slices.size() - i));
+            for (int j(0); j < count; j++)
+            {
+                const Slice& slice(slices[i + j]);
+                arcs[j].x = (short) (slice.x - slice.radius);
+                arcs[j].y = (short) (slice.y - slice.radius);
+                arcs[j].width = arcs[j].height = (unsigned short) (slice.radius * 2);
+                arcs[j].angle1 = (short) (64 * (slice.rotation - slice.degree/2));
+                arcs[j].angle2 = (short) (64 * slice.degree);
+            }
+            XFillArcs(m_display, m_db, m_gc, arcs, count);
+        }
+    }
+
     void X11Drawer::fill_circle(int x, int y, int radius)
     {
         XFillArc(m_display, m_db, m_gc, x-radius, y-radius, radius*2, radius*2, 0,
@@ -325,4 +608,77 @@ namespace code3c
     {
         XDrawLine(m_display, m_db, m_gc, x1, y1, x2, y2);
     }
-}
\ No newline at end of file
+
+    void X11Drawer::blit(const PixelMap &pixelMap, int x, int y, const Rect& clip)
+    {
+        int x0(std::max({clip.x, 0, x})), y0(std::max({clip.y, 0, y}));
+        int x1(std::min({clip.x + clip.width, m_width, x + pixelMap.width()}));
+        int y1(std::min({clip.y + clip.height, m_height, y + pixelMap.height()}));
+        if (x0 >= x1 || y0 >= y1)
+            return;
+        int w(x1 - x0), h(y1 - y0);
+
+        XImage* img(XCreateImage(m_display, DefaultVisual(m_display, m_screen),
+                                 DefaultDepth(m_display, m_screen), ZPixmap, 0,
+                                 nullptr, w, h, 32, 0));
+        int rs(img ? channel_shift(img->red_mask) : -1);
+        int gs(img ? channel_shift(img->green_mask) : -1);
+        int bs(img ? channel_shift(img->blue_mask) : -1);
+        if (!img || img->bits_per_pixel != 32 || rs < 0 || gs < 0 || bs < 0)
+        {
+            // Not a 32 bits TrueColor visual
+            if (img)
+                XDestroyImage(img);
+            Drawer::blit(pixelMap, x, y, clip);
+            return;
+        }
+        img->data = (char*) malloc((size_t) img->bytes_per_line * h);
+        bool swap((img->byte_order == LSBFirst) !=
+                  (std::endian::native == std::endian::little));
+
+        // Pixels in the server format, and the XBM clip mask (LSB first)
+        int maskStride((w + 7) / 8);
+        std::vector<unsigned char> mask((size_t) maskStride * h, 0);
+        bool transparent(false), visible(false);
+        for (int py(0); py < h; py++)
+        {
+            std::span<const uint32_t> src(pixelMap.row(py + y0 - y));
+            auto dst = (uint32_t*) (img->data + (size_t) py * img->bytes_per_line);
+            unsigned char* bits(&mask[(size_t) py * maskStride]);
+            for (int px(0); px < w; px++)
+            {
+                uint32_t pixel(src[px + x0 - x]);
+                unsigned long color(rgba8_color(pixel));
+                uint32_t value(((color >> 16) & 0xff) << rs | ((color >> 8) & 0xff) << gs |
+                               (color & 0xff) << bs);
+                dst[px] = swap ? __builtin_bswap32(value) : value;
+                if (rgba8_alpha(pixel) >= 0x80)
+                {
+                    bits[px / 8] |= 1 << (px % 8);
+                    visible = true;
+                }
+                else
+                    transparent = true;
+            }
+        }
+
+        if (visible)
+        {
+            Pixmap clipMask(None);
+            if (transparent)
+            {
+                clipMask = XCreateBitmapFromData(m_display, m_db, (const char*) mask.data(),
+                                                 w, h);
+                XSetClipMask(m_display, m_gc, clipMask);
+                XSetClipOrigin(m_display, m_gc, x0, y0);
+            }
+            XPutImage(m_display, m_db, m_gc, img, 0, 0, x0, y0, w, h);
+            if (transparent)
+            {
+                XSetClipMask(m_display, m_gc, None);
+                XFreePixmap(m_display, clipMask);
+            }
+        }
+        XDestroyImage(img);
+    }
+}
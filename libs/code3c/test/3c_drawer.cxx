@@ -1,4 +1,6 @@
+#include <cmath>
 #include <iostream>
+#include <vector>
 #include <code3c/3ccode.hh>
 #include <code3c/drawer.hh>
 
@@ -61,6 +63,9 @@ int test_create_data();
 int test_draw_pixel();
 int test_key_binding();
 int test_create_data_with_huffman();
+int test_capture();
+int test_frame_stats();
+int test_antialiasing();
 
 
 typedef int (*TestFunction)(void); /* NOLINT */
@@ -98,8 +103,23 @@ static testFunctionMapEntry registeredFunctionEntries[] = {
             "key_binding",
             test_key_binding,
             4, 0
-        }
+        },
+        {
+            "capture",
+            test_capture,
+            5, 0
+        },
 #endif
+        {
+            "frame_stats",
+            test_frame_stats,
+            6, 0
+        },
+        {
+            "antialiasing",
+            test_antialiasing,
+            7, 0
+        }
 };
 
 int test_3c_drawer(int argc [[maybe_unused]], char** argv [[maybe_unused]])
@@ -267,4 +287,168 @@ int test_key_binding()
     } keyBindingDrawer;
     keyBindingDrawer.run();
     return 0;
-}
\ No newline at end of file
+}
+int test_capture()
+{
+    class CaptureDrawer : public SimpleDrawer
+    {
+    public:
+        CaptureDrawer() : SimpleDrawer(301, 97, code3c::mat8_t(10))
+        {
+        }
+
+        void setup() override
+        {
+        }
+
+        void draw() override
+        {
+            // Vertical stripes, one colour per channel
+            const unsigned long colors[4] = {0xff0000, 0x00ff00, 0x0000ff, 0x123456};
+            for (int x = 0; x < width(); x += 8)
+            {
+                foreground(colors[(x / 8) % 4]);
+                draw_line(x, 0, x, height() - 1);
+            }
+        }
+    } captureDrawer;
+
+    // Drawn into the double buffer and read back, without any event loop
+    captureDrawer.background(0xffffff);
+    captureDrawer.draw();
+    code3c::PixelMap frame(captureDrawer.capture());
+    if (frame.width() != 301 || frame.height() != 97)
+        return 1;
+    const unsigned long colors[4] = {0xff0000, 0x00ff00, 0x0000ff, 0x123456};
+    for (int y = 0; y < frame.height(); y++)
+        for (int x = 0; x < frame.width(); x++)
+            if (frame.color(x, y) != (x % 8 ? 0xffffff : colors[(x / 8) % 4]))
+                return 2;
+    return 0;
+}
+
+int test_frame_stats()
+{
+    class StatsDrawer : public code3c::RasterDrawer
+    {
+    public:
+        StatsDrawer() : RasterDrawer(10, 10, code3c::mat8_t(1)) {}
+
+        void setup() override {}
+        void draw() override {}
+
+        void frame(double millis)
+        { record_frame(millis); }
+    } drawer;
+
+    code3c::FrameStats stats(drawer.frameStats());
+    if (stats.frames != 0 || stats.avg != 0)
+        return 1;
+
+    // 1..100 ms: p99 is the 99th value
+    for (int i(100); i > 0; i--)
+        drawer.frame(i);
+    stats = drawer.frameStats();
+    if (stats.frames != 100 || stats.min != 1 || stats.avg != 50.5 || stats.p99 != 99)
+        return 2;
+
+    // Only the last CODE3C_FRAME_STATS frames are kept
+    for (int i(0); i < CODE3C_FRAME_STATS; i++)
+        drawer.frame(10);
+    stats = drawer.frameStats();
+    if (stats.frames != 100 + CODE3C_FRAME_STATS || stats.min != 10 || stats.p99 != 10)
+        return 3;
+    return 0;
+}
+
+int test_antialiasing()
+{
+    class AADrawer : public code3c::RasterDrawer
+    {
+    public:
+        AADrawer() : RasterDrawer(200, 200, code3c::mat8_t(1)) {}
+
+        void setup() override {}
+        void draw() override {}
+
+        // Covered area, from the darkness of the pixels
+        double coverage() const
+        {
+            double area(0);
+            for (size_t i(0); i < frame().size(); i++)
+                area += (255 - (frame().data()[i] & 0xff)) / 255.0;
+            return area;
+        }
+    } drawer;
+    drawer.setAntialiased(true);
+
+    // Quarter of a disc: exact area, soft edges
+    drawer.background(0xffffff);
+    drawer.foreground(0);
+    drawer.draw_slice(100, 100, 60, 90, 45);
+    if (std::abs(drawer.coverage() - M_PI * 60 * 60 / 4) > M_PI * 60 * 60 / 400)
+        return 1;
+    size_t partial(0);
+    for (size_t i(0); i < drawer.frame().size(); i++)
+    {
+        unsigned v(drawer.frame().data()[i] & 0xff);
+        partial += v != 0 && v != 0xff;
+    }
+    if (partial == 0 || partial > 4 * 60 * 2)
+        return 2;
+
+    // Ring of adjacent cells in one batch: no seam between them (apart from
+    // the apex, where thin cells are narrower than a pixel)
+    std::vector<code3c::Slice> ring;
+    for (int t(0); t < 60; t++)
+        ring.push_back({100, 100, 60, 6, t * 6});
+    drawer.background(0xffffff);
+    drawer.fill_slices(0, ring);
+    for (int y(0); y < 200; y++)
+    {
+        for (int x(0); x < 200; x++)
+        {
+            double d(std::hypot(x + 0.5 - 100, y + 0.5 - 100));
+            uint32_t color(drawer.frame().color(x, y));
+            if ((d > 10 && d < 59 && color != 0) || (d > 61 && color != 0xffffff))
+                return 3;
+        }
+    }
+    if (std::abs(drawer.coverage() - M_PI * 60 * 60) > M_PI * 60 * 60 / 100)
+        return 4;
+
+    // Same disc as fill_circle
+    drawer.background(0xffffff);
+    drawer.fill_circle(100, 100, 60);
+    if (std::abs(drawer.coverage() - M_PI * 60 * 60) > M_PI * 60 * 60 / 1000)
+        return 5;
+
+    // Same coverage with the AVX2 and the scalar kernels, tails included
+    if (code3c::RasterDrawer::coverage(ring[0], 0, 0, 1, std::vector<float>(1).data()))
+    {
+        std::vector<float> simd(203), scalar(203);
+        for (code3c::Slice slice : {code3c::Slice{100, 100, 60, 6, 42}, {100, 100, 60, 90, 45},
+                                    {100, 100, 60, 270, 200}, {100, 100, 60, 360, 0},
+                                    {100, 100, 60, -30, 10}})
+            for (int y(35); y < 166; y += 3)
+                for (int x0 : {0, 37})
+                {
+                    int n(203 - x0 - y % 8);
+                    code3c::RasterDrawer::coverage(slice, y, x0, n, simd.data(), true);
+                    code3c::RasterDrawer::coverage(slice, y, x0, n, scalar.data(), false);
+                    for (int i(0); i < n; i++)
+                        if (std::abs(simd[i] - scalar[i]) > 1e-6f)
+                            return 6;
+                }
+    }
+
+    // Aliased output keeps the drawing colours only
+    drawer.setAntialiased(false);
+    drawer.background(0xffffff);
+    drawer.fill_slices(0, ring);
+    for (size_t i(0); i < drawer.frame().size(); i++)
+        if ((drawer.frame().data()[i] & 0xffffff) != 0 &&
+            (drawer.frame().data()[i] & 0xffffff) != 0xffffff)
+            return 7;
+    return 0;
+}
@@ -1,4 +1,27 @@
+#include <algorithm>
+#include <atomic>
+#include <cmath>
 #include <iostream>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <unistd.h>
+#include <code3c/3ccode.hh>
+#include <code3c/pixelmap.hh>
+#include <code3c/sheet.hh>
+#include <code3c/tiledraster.hh>
+
+using namespace code3c;
+
+int test_render_png();
+int test_render_svg();
+int test_blit();
+int test_display_list();
+int test_tiled_raster();
+int test_streamed_output();
+int test_sheet();
+int test_binary_payload();
+int test_indexed_png();
 
 typedef int (*TestFunction)(void); /* NOLINT */
 typedef struct /* NOLINT */
@@ -10,7 +33,51 @@ typedef struct /* NOLINT */
 } testFunctionMapEntry;
 
 static testFunctionMapEntry registeredFunctionEntries[] = {
-
+        {
+            "render_png",
+            test_render_png,
+            0, 0
+        },
+        {
+            "render_svg",
+            test_render_svg,
+            1, 0
+        },
+        {
+            "blit",
+            test_blit,
+            2, 0
+        },
+        {
+            "display_list",
+            test_display_list,
+            3, 0
+        },
+        {
+            "tiled_raster",
+            test_tiled_raster,
+            4, 0
+        },
+        {
+            "streamed_output",
+            test_streamed_output,
+            5, 0
+        },
+        {
+            "sheet",
+            test_sheet,
+            6, 0
+        },
+        {
+            "binary_payload",
+            test_binary_payload,
+            7, 0
+        },
+        {
+            "indexed_png",
+            test_indexed_png,
+            8, 0
+        }
 };
 
 int test_3c_generation(int argc [[maybe_unused]], char** argv [[maybe_unused]])
@@ -38,5 +105,633 @@ int test_3c_generation(int argc [[maybe_unused]], char** argv [[maybe_unused]])
     }
     
     std::cout << pass << "/" << found << " test(s) passed" << std::endl;
-    return (int) status;
+    // Exit statuses keep 8 bits: fold the upper ids on the lower ones
+    return (int) ((status | (status >> 8)) & 0xff);
+}
+
+int test_render_png()
+{
+    Code3C code3C("https://gitlab.isima.fr/rinbaudelet/uca-l3_graphicalprot");
+    code3C.setModel(CODE3C_MODEL_WB2C);
+    code3C.setErrorModel(CODE3C_ERRLVL_A);
+
+    // Nothing to render before generation
+    try
+    {
+        code3C.renderPNG();
+        return 1;
+    }
+    catch (const std::runtime_error&)
+    {
+    }
+
+    if (!code3C.generate())
+        return 2;
+    std::vector<uint8_t> png(code3C.renderPNG());
+    if (png.size() < 8 || png[1] != 'P' || png[2] != 'N' || png[3] != 'G')
+        return 3;
+
+    PixelMap map(PixelMap::decodePNG(png));
+    int size(Code3CPainter::size(code3C.dimension()));
+    if (map.width() != size || map.height() != size)
+        return 4;
+
+    // White background in the corners (the top-left one holds the landmark
+    // line of the debug builds)
+    if (map.color(map.width() - 3, 2) != 0xffffff)
+        return 5;
+
+    // Re-encoding into a caller buffer gives the same image
+    std::vector<uint8_t> buffer(png.size() * 2);
+    size_t len(PixelMap::encodePNG(map, buffer, PixelMap::PNGOptions()));
+    PixelMap copy(PixelMap::decodePNG(std::span<const uint8_t>(buffer.data(), len)));
+    if (copy.width() != map.width() ||
+        std::memcmp(copy.data(), map.data(), map.size() * sizeof(uint32_t)) != 0)
+        return 6;
+
+    // Too small buffers and truncated data are reported
+    try
+    {
+        PixelMap::encodePNG(map, std::span<uint8_t>(buffer.data(), 64),
+                            PixelMap::PNGOptions());
+        return 7;
+    }
+    catch (const std::length_error&)
+    {
+    }
+    try
+    {
+        PixelMap::decodePNG(std::span<const uint8_t>(png.data(), png.size() / 2));
+        return 8;
+    }
+    catch (const std::runtime_error&)
+    {
+    }
+
+    // Marker and logo come from the asset cache on the next renders
+    size_t misses(AssetCache::instance().misses());
+    if (code3C.renderPNG() != png || AssetCache::instance().misses() != misses)
+        return 9;
+    return 0;
+}
+
+static size_t count(const std::string& str, const char* pattern)
+{
+    size_t n(0);
+    for (size_t pos(str.find(pattern)); pos != std::string::npos;
+         pos = str.find(pattern, pos + 1))
+        n++;
+    return n;
+}
+
+int test_render_svg()
+{
+    // Adjacent slices of a ring with the same colour are merged
+    class RingDrawer : public SVGDrawer
+    {
+    public:
+        RingDrawer() : SVGDrawer(100, 100, code3c::mat8_t(1)) {}
+
+        void setup() override {}
+        void draw() override
+        {
+            background(0xffffff);
+            for (int t(0); t < 60; t++)
+            {
+                foreground(t < 30 ? 0xff0000 : 0x00ffff);
+                draw_slice(50, 50, 40, 6, t * 6);
+                foreground(0);
+                draw_slice(50, 50, 20, 6, t * 6);
+            }
+        }
+    } ring;
+    ring.run();
+    std::string document(ring.svg());
+    if (count(document, "<path") != 2 || count(document, "<circle") != 1)
+        return 1;
+    if (document.find("#ff0000") == std::string::npos ||
+        document.find("#00ffff") == std::string::npos)
+        return 2;
+    // Outer ring painted before the inner disc, as annular sectors stopping
+    // at its edge
+    if (document.find("#ff0000") > document.find("<circle") ||
+        count(document, "A20 20 ") != 2)
+        return 3;
+
+    Code3C code3C("https://gitlab.isima.fr/rinbaudelet/uca-l3_graphicalprot");
+    code3C.setModel(CODE3C_MODEL_WB6C);
+    if (!code3C.generate())
+        return 4;
+    document = code3C.renderSVG();
+    if (document.rfind("<?xml", 0) != 0 || document.find("</svg>") == std::string::npos)
+        return 5;
+
+    // Fewer paths than cells, marker outlined and logo embedded
+    size_t cells(code3C.dimension().axis_t * code3C.dimension().axis_r);
+    size_t paths(count(document, "<path"));
+    if (paths == 0 || paths >= cells)
+        return 6;
+    if (count(document, "href=\"data:image/png;base64,") != 1 ||
+        count(document, "<g id=\"img") != 1)
+        return 7;
+    return 0;
+}
+
+int test_blit()
+{
+    // Generic per-pixel path, over the same frame buffer
+    class PixelBlitDrawer : public RasterDrawer
+    {
+    public:
+        PixelBlitDrawer() : RasterDrawer(64, 48, code3c::mat8_t(1)) {}
+
+        void setup() override {}
+        void draw() override {}
+
+        void blit(const PixelMap& pixelMap, int x, int y, const Rect& clip) override
+        { Drawer::blit(pixelMap, x, y, clip); }
+    };
+    class BlitDrawer : public RasterDrawer
+    {
+    public:
+        BlitDrawer() : RasterDrawer(64, 48, code3c::mat8_t(1)) {}
+
+        void setup() override {}
+        void draw() override {}
+    };
+
+    // Opaque disc on a transparent square (as the clipped logo)
+    PixelMap disc(40, 40);
+    for (int y(0); y < 40; y++)
+        for (int x(0); x < 40; x++)
+            disc.set(x, y, (unsigned long) (x * 0x60000 + y * 0x600 + 0x7f),
+                     (x - 20) * (x - 20) + (y - 20) * (y - 20) < 400 ? 0xff : 0);
+
+    PixelBlitDrawer pixels;
+    BlitDrawer bulk;
+    const Rect clips[] = {{0, 0, 64, 48}, {10, 5, 30, 20}, {-10, -10, 30, 30}, {50, 40, 40, 40}};
+    const int origins[][2] = {{12, 4}, {-15, -8}, {40, 30}};
+    for (const Rect& clip : clips)
+    {
+        for (const auto& origin : origins)
+        {
+            pixels.background(0xffffff);
+            bulk.background(0xffffff);
+            pixels.blit(disc, origin[0], origin[1], clip);
+            bulk.blit(disc, origin[0], origin[1], clip);
+            if (std::memcmp(pixels.frame().data(), bulk.frame().data(),
+                            pixels.frame().size() * sizeof(uint32_t)) != 0)
+                return 1;
+
+            // Nothing outside the clip area
+            for (int y(0); y < 48; y++)
+                for (int x(0); x < 64; x++)
+                    if ((x < clip.x || x >= clip.x + clip.width ||
+                         y < clip.y || y >= clip.y + clip.height) &&
+                        bulk.frame().color(x, y) != 0xffffff)
+                        return 2;
+        }
+    }
+
+    // Transparent pixels left out, opaque ones copied
+    bulk.background(0xffffff);
+    bulk.draw_pixelmap(disc, 0, 0);
+    if (bulk.frame().color(0, 0) != 0xffffff || bulk.frame().color(20, 20) != disc.color(20, 20))
+        return 3;
+    return 0;
+}
+
+int test_display_list()
+{
+    // Replays a display list on a raster of any size
+    class ReplayDrawer : public RasterDrawer
+    {
+        const DisplayList& list;
+    public:
+        ReplayDrawer(const DisplayList& list, int size) :
+                RasterDrawer(size, size, code3c::mat8_t(1)), list(list) {}
+
+        void setup() override {}
+        void draw() override { list.replay(*this); }
+    };
+
+    Code3C code3C("https://gitlab.isima.fr/rinbaudelet/uca-l3_graphicalprot");
+    code3C.setModel(CODE3C_MODEL_WB2C);
+    if (!code3C.generate())
+        return 1;
+
+    // Laid out once, shared by every render
+    std::shared_ptr<const DisplayList> list(code3C.displayList());
+    std::vector<uint8_t> png(code3C.renderPNG());
+    std::string svg(code3C.renderSVG());
+    if (code3C.displayList() != list)
+        return 2;
+
+    // Compact: one run per colour and ring, marker and logo blits
+    size_t runs(0), blits(0);
+    for (const DisplayList::command& cmd : list->commands())
+    {
+        runs += cmd.kind == DisplayList::DL_SLICES;
+        blits += cmd.kind == DisplayList::DL_BLIT;
+    }
+    size_t cells(code3C.dimension().axis_t * code3C.dimension().axis_r);
+    if (blits != 2 || runs == 0 || runs >= cells / 4 || list->images().size() != 2)
+        return 3;
+
+    // Identical to the code's own renders at scale 1
+    int size(list->width());
+    ReplayDrawer same(*list, size);
+    same.run();
+    PixelMap expected(PixelMap::decodePNG(png));
+    if (std::memcmp(same.frame().data(), expected.data(),
+                    expected.size() * sizeof(uint32_t)) != 0)
+        return 4;
+
+    class ReplaySVG : public SVGDrawer
+    {
+        const DisplayList& list;
+    public:
+        ReplaySVG(const DisplayList& list) :
+                SVGDrawer(list.width(), list.height(), code3c::mat8_t(1)), list(list) {}
+
+        void setup() override {}
+        void draw() override { list.replay(*this); }
+    } vector(*list);
+    vector.run();
+    if (vector.svg() != svg)
+        return 5;
+
+    // Twice the size: same picture, up to the edges and the resampled images
+    ReplayDrawer twice(*list, size * 2);
+    twice.run();
+    auto distance = [](uint32_t a, uint32_t b) -> int {
+        int d(0);
+        for (int shift(0); shift < 24; shift += 8)
+            d = std::max(d, std::abs((int) ((a >> shift) & 0xff) - (int) ((b >> shift) & 0xff)));
+        return d;
+    };
+    size_t same_pixels(0);
+    for (int y(0); y < size; y++)
+        for (int x(0); x < size; x++)
+        {
+            int d(0xff);
+            for (int i(0); i < 4; i++)
+                d = std::min(d, distance(twice.frame().color(2 * x + i % 2, 2 * y + i / 2),
+                                         expected.color(x, y)));
+            same_pixels += d < 0x40;
+        }
+    if (same_pixels < expected.size() * 98 / 100)
+        return 6;
+
+    // Laid out again when the logo or the model changes
+    code3C.setLogo(C3CRC("3ccode-wb6c.png"));
+    std::shared_ptr<const DisplayList> logo(code3C.displayList());
+    if (logo == list || logo->images().back().path != C3CRC("3ccode-wb6c.png"))
+        return 7;
+    // A new model discards the generated code
+    code3C.setModel(CODE3C_MODEL_WB6C);
+    try
+    {
+        code3C.displayList();
+        return 8;
+    }
+    catch (const std::runtime_error&)
+    {
+    }
+    if (!code3C.generate() || code3C.displayList() == logo)
+        return 8;
+    return 0;
+}
+
+int test_tiled_raster()
+{
+    class ReplayDrawer : public RasterDrawer
+    {
+        const DisplayList& list;
+        double scale;
+    public:
+        ReplayDrawer(const DisplayList& list, double scale, bool antialiased) :
+                RasterDrawer((int) std::lround(list.width() * scale),
+                             (int) std::lround(list.height() * scale), code3c::mat8_t(1)),
+                list(list), scale(scale)
+        { setAntialiased(antialiased); }
+
+        void setup() override {}
+        void draw() override { list.replay(*this, scale); }
+    };
+
+    Code3C code3C("https://gitlab.isima.fr/rinbaudelet/uca-l3_graphicalprot");
+    code3C.setModel(CODE3C_MODEL_WB2C);
+    if (!code3C.generate())
+        return 1;
+    std::shared_ptr<const DisplayList> list(code3C.displayList());
+
+    // Same pixels as a single RasterDrawer, whatever the scale and threads
+    WorkPool pool(3);
+    for (double scale : {1.0, 2.5})
+        for (bool antialiased : {false, true})
+        {
+            TiledRasterizer tiled(*list, scale, antialiased);
+            ReplayDrawer whole(*list, scale, antialiased);
+            whole.run();
+            PixelMap frame(tiled.render(pool));
+            if (frame.width() != whole.frame().width() || frame.height() != whole.frame().height())
+                return 2;
+            if (std::memcmp(frame.data(), whole.frame().data(), frame.size() * sizeof(uint32_t)) != 0)
+                return 3;
+            // Inside the cells and the background, tiles are filled at once
+            if (tiled.uniformTiles() == 0 || tiled.rasterizedTiles() == 0 ||
+                tiled.uniformTiles() + tiled.rasterizedTiles() != (size_t)
+                    (((frame.width() + 63) / 64) * ((frame.height() + 63) / 64)))
+                return 4;
+        }
+
+    // Streamed band by band: the resampled images are snapped to their
+    // palette, the code and a list of plain primitives are both indexed
+    DisplayList plain(300, 200);
+    plain.background(0xffffff);
+    std::vector<Slice> slices{{150, 100, 90, 90, 45}, {150, 100, 60, 120, 200}};
+    plain.slices(0x3050a0, slices);
+    plain.circle(0xbe55ab, 150, 100, 20);
+    plain.line(0x000000, 0, 199, 299, 0);
+    for (const DisplayList* source : {list.get(), (const DisplayList*) &plain})
+    {
+        TiledRasterizer tiled(*source, 2.5);
+        std::vector<uint32_t> colors(tiled.colors());
+        if (colors.empty() || colors.size() > 256)
+            return 5;
+        FILE* tmp(tmpfile());
+        if (!tmp)
+            return 6;
+        tiled.savePNG(tmp, PixelMap::PNGOptions(), pool);
+        std::vector<uint8_t> png((size_t) ftell(tmp));
+        rewind(tmp);
+        size_t read(fread(png.data(), 1, png.size(), tmp));
+        fclose(tmp);
+        PixelMap decoded(PixelMap::decodePNG(std::span<const uint8_t>(png.data(), read)));
+        PixelMap frame(tiled.render(pool));
+        if (decoded.width() != frame.width() || decoded.height() != frame.height() ||
+            std::memcmp(decoded.data(), frame.data(), frame.size() * sizeof(uint32_t)) != 0)
+            return 7;
+    }
+
+    // Every task runs once, errors reach the waiting thread
+    std::vector<std::atomic<int>> runs(1000);
+    pool.run((int) runs.size(), [&runs](int i) { runs[i]++; });
+    if (std::any_of(runs.begin(), runs.end(), [](const std::atomic<int>& n) { return n != 1; }))
+        return 8;
+    try
+    {
+        pool.run(100, [](int i) {
+            if (i == 42)
+                throw std::runtime_error("task");
+        });
+        return 9;
+    }
+    catch (const std::runtime_error&) {}
+    return 0;
+}
+
+/**
+ * @param reset restart the measure from the current resident memory
+ * @return the peak resident memory (KiB) since the last reset, -1 if not
+ * available
+ */
+static long peak_rss(bool reset)
+{
+#if defined(__linux__)
+    if (reset)
+    {
+        FILE* refs(fopen("/proc/self/clear_refs", "w"));
+        if (!refs)
+            return -1;
+        bool cleared(fputs("5", refs) >= 0);
+        if (fclose(refs) != 0 || !cleared)
+            return -1;
+    }
+    FILE* status(fopen("/proc/self/status", "r"));
+    if (!status)
+        return -1;
+    char line[256];
+    long peak(-1);
+    while (fgets(line, sizeof(line), status))
+        if (sscanf(line, "VmHWM: %ld kB", &peak) == 1)
+            break;
+    fclose(status);
+    return peak;
+#else
+    return -1;
+#endif
+}
+
+int test_streamed_output()
+{
+    Code3C code3C("https://gitlab.isima.fr/rinbaudelet/uca-l3_graphicalprot");
+    code3C.setModel(CODE3C_MODEL_WB2C);
+    if (!code3C.generate())
+        return 1;
+
+    // The pixel unit and margin set the output size
+    code3C.setPixelUnit(5, 8);
+    std::vector<uint8_t> png(code3C.renderPNG());
+    int size(Code3CPainter::size(code3C.dimension(), 5, 8));
+    PixelMap small(PixelMap::decodePNG(png));
+    if (small.width() != size || small.width() != 2 * 8 + 2 * code3C.dimension().absRad * 5)
+        return 2;
+    code3C.setPixelUnit(0, -1); // ignored
+    if (code3C.pixelUnit() != 5 || code3C.margin() != 8)
+        return 3;
+
+    // Peak memory independent of the output size: a 4 times larger (16 times
+    // more pixels) image is streamed in the same memory
+    long peaks[2];
+    const int units[2] = {11, 44};
+    for (int i(0); i < 2; i++)
+    {
+        code3C.setPixelUnit(units[i]);
+        if (peak_rss(true) < 0)
+        {
+            std::cout << "(peak memory not measurable) ";
+            return 0;
+        }
+        code3C.save("streamed_output.png");
+        peaks[i] = peak_rss(false);
+
+        // Size in the PNG header
+        FILE* saved(fopen("streamed_output.png", "rb"));
+        uint8_t header[24];
+        if (!saved || fread(header, 1, sizeof(header), saved) != sizeof(header))
+            return 4;
+        fclose(saved);
+        int width((header[16] << 24) | (header[17] << 16) | (header[18] << 8) | header[19]);
+        if (width != Code3CPainter::size(code3C.dimension(), units[i]))
+            return 5;
+    }
+    long frame((long) Code3CPainter::size(code3C.dimension(), units[1]) *
+               Code3CPainter::size(code3C.dimension(), units[1]) * 4 / 1024);
+    std::cout << "(peak " << peaks[0] << " KiB, then " << peaks[1] << " KiB for a "
+              << frame << " KiB frame) ";
+    if (frame < 64 * 1024 || peaks[1] - peaks[0] > 16 * 1024)
+        return 6;
+    return 0;
+}
+
+int test_sheet()
+{
+    // Five labels of the same length on three columns, two logos
+    const char* payloads[] = {"label-0001", "label-0002", "label-0003", "label-0004", "label-0005"};
+    Code3CSheet sheet(3);
+    for (size_t i(0); i < 5; i++)
+    {
+        Code3C& code(sheet.add(payloads[i], strlen(payloads[i])));
+        code.setModel(CODE3C_MODEL_WB2C);
+        if (i % 2)
+            code.setLogo(C3CRC("3ccode-wb.png"));
+    }
+    if (!sheet.generate() || sheet.rows() != 2)
+        return 1;
+
+    // Every cell holds the same pixels as the code rendered alone
+    std::shared_ptr<const DisplayList> list(sheet.displayList());
+    int cell(sheet[0].displayList()->width());
+    if (list->width() != 3 * cell || list->height() != 2 * cell)
+        return 2;
+    PixelMap image(PixelMap::decodePNG(sheet.render(PixelMap::FORMAT_PNG)));
+    for (size_t i(0); i < 5; i++)
+    {
+        PixelMap alone(PixelMap::decodePNG(sheet[i].renderPNG()));
+        if (alone.width() != cell)
+            return 3;
+        int x0((int) (i % 3) * cell), y0((int) (i / 3) * cell);
+        for (int y(0); y < cell; y++)
+            if (std::memcmp(image.row(y0 + y).data() + x0, alone.row(y).data(),
+                            cell * sizeof(uint32_t)) != 0)
+                return 4;
+    }
+    // Empty cells are left blank
+    if (image.color(3 * cell - 1, 2 * cell - 1) != 0xffffff)
+        return 5;
+
+    // Streamed file, same pixels
+    sheet.save("sheet.png");
+    PixelMap saved(PixelMap::loadFromPNG("sheet.png"));
+    if (saved.width() != image.width() ||
+        std::memcmp(saved.data(), image.data(), image.size() * sizeof(uint32_t)) != 0)
+        return 6;
+
+    // Single SVG document, each image written once: the marker outlined and
+    // the two logos embedded
+    std::string document(sheet.renderSVG());
+    if (count(document, "base64,") != 2 || count(document, "<g id=") != 1 ||
+        count(document, "<use ") != 7)
+        return 7;
+
+    // Laid out again once a code is changed through the sheet
+    list = sheet.displayList();
+    sheet[1].setLogo(C3CRC("3ccode-wb6c.png"));
+    if (sheet.displayList() == list)
+        return 8;
+    return 0;
+}
+
+int test_binary_payload()
+{
+    // Embedded NULs, no terminator
+    std::byte payload[48];
+    for (size_t i(0); i < sizeof(payload); i++)
+        payload[i] = (std::byte) (i % 3 ? 0xa0 + i : 0);
+
+    // Borrowed, copied and copy-constructed codes hold every byte
+    Code3C borrowed{std::span<const std::byte>(payload)};
+    Code3C copied((const char*) payload, sizeof(payload));
+    Code3C copy(borrowed);
+    if (borrowed.rawdata() != (const char8_t*) payload || borrowed.rawSize() != sizeof(payload))
+        return 1;
+    if (copied.rawdata() == (const char8_t*) payload || copied.rawSize() != sizeof(payload) ||
+        std::memcmp(copied.rawdata(), payload, sizeof(payload)) != 0)
+        return 2;
+    if (copy.rawdata() == borrowed.rawdata() || copy.rawSize() != sizeof(payload) ||
+        std::memcmp(copy.rawdata(), payload, sizeof(payload)) != 0)
+        return 3;
+
+    // Same code whatever the storage, the bytes after a NUL being encoded
+    if (!borrowed.generate() || !copied.generate() || !copy.generate())
+        return 4;
+    std::vector<uint8_t> png(borrowed.renderPNG());
+    if (copied.renderPNG() != png || copy.renderPNG() != png)
+        return 5;
+    payload[sizeof(payload) - 1] ^= (std::byte) 0xff;
+    Code3C altered{std::span<const std::byte>(payload)};
+    if (!altered.generate() || altered.renderPNG() == png)
+        return 6;
+
+    // UTF-8 view
+    Code3C text(std::u8string_view(u8"3C-Code \u00e9t\u00e9"));
+    Code3C ctext("3C-Code \u00e9t\u00e9");
+    if (!text.generate() || !ctext.generate() || text.renderPNG() != ctext.renderPNG())
+        return 7;
+    return 0;
+}
+
+/**
+ * @return the colour type and the bit depth of a PNG image (IHDR), -1 if
+ * not a PNG image
+ */
+static std::pair<int, int> png_format(const std::vector<uint8_t>& png)
+{
+    if (png.size() < 26 || png[1] != 'P' || png[12] != 'I' || png[15] != 'R')
+        return {-1, -1};
+    return {png[25], png[24]};
+}
+
+int test_indexed_png()
+{
+    // Every model is written as a palette image, the colours of the logo
+    // being snapped to its own
+    for (uint8_t model : {CODE3C_MODEL_WB, CODE3C_MODEL_WB2C, CODE3C_MODEL_WB6C})
+    {
+        Code3C code3C("https://gitlab.isima.fr/rinbaudelet/uca-l3_graphicalprot");
+        code3C.setModel(model);
+        if (!code3C.generate())
+            return 1;
+        std::vector<uint8_t> png(code3C.renderPNG());
+        if (png_format(png) != std::pair<int, int>(3, 8))
+            return 2;
+
+        // Anti-aliased edges need truecolor
+        code3C.setAntialiased(true);
+        if (png_format(code3C.renderPNG()).first == 3)
+            return 3;
+    }
+
+    // A two colours logo on the white and black model: 4 colours at most
+    char path[] = "/tmp/code3c-logo-XXXXXX";
+    int fd(mkstemp(path));
+    if (fd < 0)
+        return 4;
+    FILE* logo(fdopen(fd, "wb"));
+    if (!logo)
+    {
+        close(fd);
+        unlink(path);
+        return 4;
+    }
+    PixelMap disc(64, 64);
+    for (int y(0); y < disc.height(); y++)
+        for (int x(0); x < disc.width(); x++)
+            disc.data()[y * disc.width() + x] = rgba8((x / 8 + y / 8) % 2 ? 0xffffff : 0);
+    PixelMap::saveInPng(disc, logo);
+    fclose(logo);
+
+    Code3C code3C("https://gitlab.isima.fr/rinbaudelet/uca-l3_graphicalprot");
+    code3C.setModel(CODE3C_MODEL_WB);
+    code3C.setLogo(path);
+    bool generated(code3C.generate());
+    std::vector<uint8_t> png(generated ? code3C.renderPNG() : std::vector<uint8_t>());
+    unlink(path);
+    if (!generated)
+        return 5;
+    if (png_format(png) != std::pair<int, int>(3, 2))
+        return 6;
+    return 0;
 }
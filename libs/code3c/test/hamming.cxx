@@ -28,6 +28,7 @@ int hamm743_test_HG();
 int hamm_detect_err();
 int hamm_detect_err_743();
 int hamm_detect_err_313();
+int hamm_codewords();
 
 // Utils functions
 uint32_t hdiff(char w1, char w2)
@@ -91,6 +92,11 @@ static testFunctionMapEntry registeredFunctionEntries[] = {
             "hamming_error_detection_313",
             hamm_detect_err_313,
             3, 0
+        },
+        {
+            "hamming_codewords",
+            hamm_codewords,
+            4, 0
         }
 };
 
@@ -185,4 +191,24 @@ int hamm_detect_err_743()
         }
     }
     return 0;
-}
\ No newline at end of file
+}
+
+int hamm_codewords()
+{
+    // The compile-time tables match the dynamic G*x product
+    Hamming743 h743;
+    for (char x(0); x < 16; x++)
+        if (h743.codeword(x) != h743.Hamming::codeword(x))
+            return 1;
+    Hamming313 h313;
+    for (char x(0); x < 2; x++)
+        if (h313.codeword(x) != h313.Hamming::codeword(x))
+            return 2;
+
+    // Encoded words hold the codeword bits in their vector
+    h743.set_buffer("codeword", 8);
+    for (Hamming743::hword *hword: h743)
+        if (Hamming743::hword::mtow(hword->getVector()) != hword->m() || hword->err() != 0)
+            return 3;
+    return 0;
+}
@@ -6,6 +6,8 @@ using namespace code3c;
 int test_mat_multiply();
 int test_mat_addition();
 int test_mat_substraction();
+int test_fixed_mat();
+int test_mat_view();
 
 typedef int (*TestFunction)(void); /* NOLINT */
 typedef struct /* NOLINT */
@@ -31,6 +33,16 @@ static testFunctionMapEntry registeredFunctionEntries[] = {
             "mat::multiply",
             test_mat_multiply,
             2, 0
+        },
+        {
+            "fixed_mat::operations",
+            test_fixed_mat,
+            3, 0
+        },
+        {
+            "mat_view::strided",
+            test_mat_view,
+            4, 0
         }
 };
 
@@ -166,3 +178,68 @@ int test_mat_multiply()
     
     return nbErrors;
 }
+
+
+int test_fixed_mat()
+{
+    int nbErrors(0);
+    {
+        constexpr fixed_mat<int, 3, 3> m1 {{
+            {10, 15, 20},
+            {20,  5,  6},
+            { 1,  3,  5}
+        }};
+        constexpr fixed_mat<int, 3, 3> m2 {{
+            {5, 2, 13},
+            {2, 7,  6},
+            {3, 1,  1}
+        }};
+        constexpr fixed_mat<int, 3, 3> r12 {{
+            {140,145,240},
+            {128, 81,296},
+            { 26, 28, 36}
+        }};
+        static_assert(m1 * m2 == r12);
+        static_assert(m1 * matI3<int>() == m1);
+        static_assert((m1 + m2) - m2 == m1);
+        static_assert(m1.transposed().transposed() == m1);
+
+        // Interoperability with dynamic matrices
+        matd d1(m1), d2(m2);
+        nbErrors += (d1 * d2) != matd(r12);
+        nbErrors += (m1 * d2) != matd(r12);
+        nbErrors += fixed_mat<int, 3, 3>(d1 * d2) != r12;
+        nbErrors += matd(matI4<int>()) != matIn<int>(4);
+    }
+
+    return nbErrors;
+}
+
+int test_mat_view()
+{
+    int nbErrors(0);
+    {
+        matd m1(4, 6);
+        for (int i(0); i < m1.n(); i++)
+            for (int j(0); j < m1.m(); j++)
+                m1[i, j] = 10*i + j;
+
+        // Rows and columns
+        std::span<int> row2(m1.row(2));
+        nbErrors += row2.size() != 6 || row2[5] != 25;
+        mat_view<int> col3(m1.column(3));
+        nbErrors += col3.n() != 4 || col3[1] != 13 || col3[3] != 33;
+
+        // Strided submatrix and nested view
+        mat_view<const int> sub(static_cast<const matd&>(m1).view(1, 0, 2, 3, 2, 2));
+        nbErrors += sub[0, 0] != 10 || sub[0, 2] != 14 || sub[1, 1] != 32;
+        nbErrors += sub.row(1)[2] != 34;
+
+        // Views are not copies
+        col3[0] = -1;
+        nbErrors += m1[0, 3] != -1;
+        nbErrors += sub.copy() != m1.view(1, 0, 2, 3, 2, 2).copy();
+    }
+
+    return nbErrors;
+}
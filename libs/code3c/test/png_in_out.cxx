@@ -1,5 +1,14 @@
+#include <algorithm>
 #include <iostream>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <code3c/assetcache.hh>
 #include <code3c/drawer.hh>
+#include <code3c/huffman.hh>
 #include <code3c/pixelmap.hh>
 
 using namespace code3c;
@@ -7,6 +16,14 @@ using namespace code3c;
 int test_png_read();
 int test_png_resize();
 int test_png_save();
+int test_png_round_trip();
+int test_png_resize_filters();
+int test_png_indexed();
+int test_png_streaming();
+int test_raw_formats();
+int test_asset_cache();
+int test_resources();
+int test_resampler();
 
 typedef int (*TestFunction)(void); /* NOLINT */
 typedef struct /* NOLINT */
@@ -33,8 +50,48 @@ static testFunctionMapEntry registeredFunctionEntries[] = {
             "png_save",
             test_png_save,
             2, 0
-        }
+        },
 #endif
+        {
+            "png_round_trip",
+            test_png_round_trip,
+            3, 0
+        },
+        {
+            "png_resize_filters",
+            test_png_resize_filters,
+            4, 0
+        },
+        {
+            "png_indexed",
+            test_png_indexed,
+            5, 0
+        },
+        {
+            "png_streaming",
+            test_png_streaming,
+            6, 0
+        },
+        {
+            "raw_formats",
+            test_raw_formats,
+            7, 0
+        },
+        {
+            "asset_cache",
+            test_asset_cache,
+            8, 0
+        },
+        {
+            "resources",
+            test_resources,
+            9, 0
+        },
+        {
+            "resampler",
+            test_resampler,
+            10, 0
+        }
 };
 
 int test_png_in_out(int argc [[maybe_unused]], char** argv [[maybe_unused]])
@@ -62,7 +119,8 @@ int test_png_in_out(int argc [[maybe_unused]], char** argv [[maybe_unused]])
     }
     
     std::cout << pass << "/" << found << " test(s) passed" << std::endl;
-    return (int) status;
+    // Exit codes keep 8 bits: the failures of the later ids are folded in
+    return (int) ((status | (status >> 8)) & 0xff);
 }
 
 int test_png_read()
@@ -91,8 +149,8 @@ int test_png_read()
             {
                 for (int y = 0; y < map.height(); y++)
                 {
-                    if (map[x,y].alpha != 0)
-                        draw_pixel(map[x,y].color, x, y);
+                    if (map.alpha(x, y) != 0)
+                        draw_pixel(map.color(x, y), x, y);
                 }
             }
         }
@@ -125,8 +183,8 @@ int test_png_resize()
             {
                 for (int y = 0; y < map.height(); y++)
                 {
-                    if (map[x,y].alpha != 0)
-                        draw_pixel(map[x,y].color, x, y);
+                    if (map.alpha(x, y) != 0)
+                        draw_pixel(map.color(x, y), x, y);
                 }
             }
         }
@@ -151,4 +209,568 @@ int test_png_save()
     } else return 1;
     
     return 0;
-}
\ No newline at end of file
+}
+int test_png_round_trip()
+{
+    PixelMap map(PixelMap::loadFromPNG("resources/3ccode-wb2c.png"));
+    if (map.width() != 256 || map.height() != 256)
+        return 1;
+
+    // Non-square image
+    PixelMap crop(map.resize(200, 120));
+    crop.set(0, 0, 0x123456, 0x7f);
+
+    FILE* dest = fopen("round_trip.png", "wb");
+    if (!dest)
+        return 2;
+    PixelMap::saveInPng(crop, dest);
+    fclose(dest);
+
+    PixelMap loaded(PixelMap::loadFromPNG("round_trip.png"));
+    if (loaded.width() != crop.width() || loaded.height() != crop.height())
+        return 3;
+    if (loaded.color(0, 0) != 0x123456 || loaded.alpha(0, 0) != 0x7f)
+        return 4;
+    if (std::memcmp(loaded.data(), crop.data(), crop.size()*sizeof(uint32_t)) != 0)
+        return 5;
+    return 0;
+}
+
+int test_png_resize_filters()
+{
+    // 2x2 black/white checkerboard pattern
+    PixelMap checker(64, 48);
+    for (int y(0); y < checker.height(); y++)
+        for (int x(0); x < checker.width(); x++)
+            checker.set(x, y, ((x/2 + y/2) % 2) ? 0xffffff : 0x000000);
+
+    // Box downscale: every destination pixel covers a full 2x2 tile
+    PixelMap box(checker.resize(32, 24, PixelMap::FILTER_BOX));
+    for (int y(0); y < box.height(); y++)
+        for (int x(0); x < box.width(); x++)
+            if (box.color(x, y) != ((x + y) % 2 ? 0xffffff : 0x000000))
+                return 1;
+
+    // Averaging over 4x4 blocks gives mid-gray
+    PixelMap gray(checker.resize(16, 12, PixelMap::FILTER_BOX).resize(
+            4, 3, PixelMap::FILTER_BILINEAR));
+    for (uint32_t px : std::span<const uint32_t>(gray.data(), gray.size()))
+    {
+        if (std::abs((int) (rgba8_color(px) & 0xff) - 0x80) > 2 || rgba8_alpha(px) != 0xff)
+            return 2;
+    }
+
+    // Same size keeps the image unchanged, whatever the filter
+    for (auto filter : {PixelMap::FILTER_NEAREST, PixelMap::FILTER_BOX,
+                        PixelMap::FILTER_BILINEAR, PixelMap::FILTER_LANCZOS3})
+    {
+        PixelMap same(checker.resize(0, 0, filter));
+        if (std::memcmp(same.data(), checker.data(), checker.size()*4) != 0)
+            return 3;
+    }
+
+    // Fully transparent pixels don't bleed their colour
+    PixelMap alpha(8, 8);
+    for (int y(0); y < 8; y++)
+        for (int x(0); x < 8; x++)
+            alpha.set(x, y, x < 4 ? 0xff0000 : 0x00ff00, x < 4 ? 0xff : 0x00);
+    PixelMap halved(alpha.resize(4, 4, PixelMap::FILTER_LANCZOS3));
+    if (halved.color(1, 1) != 0xff0000 || halved.color(2, 2) != 0xff0000)
+        return 4;
+
+    // An empty source gives a blank map, whatever the filter
+    for (auto filter : {PixelMap::FILTER_NEAREST, PixelMap::FILTER_BOX,
+                        PixelMap::FILTER_BILINEAR, PixelMap::FILTER_LANCZOS3})
+    {
+        PixelMap blank(PixelMap(0, 0).resize(5, 3, filter));
+        if (blank.width() != 5 || blank.height() != 3 ||
+            std::any_of(blank.data(), blank.data() + blank.size(),
+                        [](uint32_t px) { return px != 0; }))
+            return 5;
+    }
+    return 0;
+}
+
+/**
+ * @return the (bit depth, colour type) pair from the IHDR chunk of a png file
+ */
+static std::pair<int, int> png_format(const char* name)
+{
+    unsigned char header[26] = {};
+    FILE* fin = fopen(name, "rb");
+    if (fin)
+    {
+        fread(header, 1, sizeof(header), fin);
+        fclose(fin);
+    }
+    return {header[24], header[25]};
+}
+
+static int save_and_reload(const PixelMap& map, const char* name,
+                           const PixelMap::PNGOptions& opts, PixelMap& loaded)
+{
+    FILE* dest = fopen(name, "wb");
+    if (!dest)
+        return 1;
+    PixelMap::saveInPng(map, dest, opts);
+    fclose(dest);
+
+    loaded = PixelMap::loadFromPNG(name);
+    if (loaded.width() != map.width() || loaded.height() != map.height())
+        return 2;
+    if (std::memcmp(loaded.data(), map.data(), map.size()*sizeof(uint32_t)) != 0)
+        return 3;
+    return 0;
+}
+
+int test_png_indexed()
+{
+    const uint32_t colors[] = {
+            rgba8(0xffffff), rgba8(0x00ffff), rgba8(0xff0000), rgba8(0, 0)
+    };
+
+    // Odd width so that the packed rows end on a partial byte
+    PixelMap map(37, 11);
+    for (int y(0); y < map.height(); y++)
+        for (int x(0); x < map.width(); x++)
+            map[x, y] = {x, y, rgba8_color(colors[(x*y) % 4]),
+                         rgba8_alpha(colors[(x*y) % 4])};
+
+    PixelMap loaded(1, 1);
+    PixelMap::PNGOptions opts;
+    opts.zlib.compression_level = 9;
+    if (save_and_reload(map, "indexed.png", opts, loaded) != 0)
+        return 1;
+    if (png_format("indexed.png") != std::pair<int, int>(2, PNG_COLOR_TYPE_PALETTE))
+        return 2;
+
+    // Preferred palette entries count in the bit depth even when unused
+    const uint32_t extra[] = {rgba8(0x123456), rgba8(0xabcdef)};
+    opts.palette = extra;
+    if (save_and_reload(map, "indexed.png", opts, loaded) != 0)
+        return 3;
+    if (png_format("indexed.png") != std::pair<int, int>(4, PNG_COLOR_TYPE_PALETTE))
+        return 4;
+
+    // Two colours fit in one bit per pixel
+    PixelMap mono(9, 3);
+    mono.set(4, 1, 0xffffff);
+    if (save_and_reload(mono, "indexed.png", {}, loaded) != 0)
+        return 5;
+    if (png_format("indexed.png") != std::pair<int, int>(1, PNG_COLOR_TYPE_PALETTE))
+        return 6;
+
+    // More than 256 colours falls back to RGBA
+    PixelMap full(32, 16);
+    for (int y(0); y < full.height(); y++)
+        for (int x(0); x < full.width(); x++)
+            full.set(x, y, (unsigned long) (y*full.width() + x) * 0x010203);
+    if (save_and_reload(full, "indexed.png", {}, loaded) != 0)
+        return 7;
+    if (png_format("indexed.png") != std::pair<int, int>(8, PNG_COLOR_TYPE_RGBA))
+        return 8;
+
+    // Indexed output can be disabled
+    opts = {};
+    opts.indexed = false;
+    if (save_and_reload(map, "indexed.png", opts, loaded) != 0)
+        return 9;
+    if (png_format("indexed.png") != std::pair<int, int>(8, PNG_COLOR_TYPE_RGBA))
+        return 10;
+    return 0;
+}
+
+int test_png_streaming()
+{
+    // Non-square gradient produced row by row
+    const int width(301), height(97);
+    auto gradient = [](int y, std::span<uint32_t> row) {
+        for (int x(0); x < (int) row.size(); x++)
+            row[x] = rgba8((unsigned long) (x * 0x10101 + y * 0x100), (x + y) & 0xff);
+    };
+
+    FILE* dest = fopen("streaming.png", "wb");
+    if (!dest)
+        return 1;
+    PixelMap::saveInPng(dest, width, height, gradient);
+    fclose(dest);
+
+    PixelMap loaded(PixelMap::loadFromPNG("streaming.png"));
+    if (loaded.width() != width || loaded.height() != height)
+        return 2;
+    std::vector<uint32_t> expected(width);
+    for (int y(0); y < height; y++)
+    {
+        gradient(y, expected);
+        if (std::memcmp(loaded.row(y).data(), expected.data(), width*sizeof(uint32_t)) != 0)
+            return 3;
+    }
+
+    // Indexed streaming with a known palette
+    const uint32_t colors[] = {rgba8(0xffffff), rgba8(0x000000), rgba8(0xff0000)};
+    auto stripes = [&](int y, std::span<uint32_t> row) {
+        for (int x(0); x < (int) row.size(); x++)
+            row[x] = colors[(x / 3 + y) % 3];
+    };
+    PixelMap::PNGOptions opts;
+    opts.palette = colors;
+    dest = fopen("streaming.png", "wb");
+    if (!dest)
+        return 4;
+    PixelMap::saveInPng(dest, width, height, stripes, opts);
+    fclose(dest);
+
+    if (png_format("streaming.png") != std::pair<int, int>(2, PNG_COLOR_TYPE_PALETTE))
+        return 5;
+    loaded = PixelMap::loadFromPNG("streaming.png");
+    for (int y(0); y < height; y++)
+    {
+        stripes(y, expected);
+        if (std::memcmp(loaded.row(y).data(), expected.data(), width*sizeof(uint32_t)) != 0)
+            return 6;
+    }
+
+    // A colour missing from the palette aborts the writing
+    bool thrown(false);
+    dest = fopen("streaming.png", "wb");
+    if (!dest)
+        return 7;
+    try
+    {
+        PixelMap::saveInPng(dest, width, height, gradient, opts);
+    }
+    catch (const std::runtime_error&)
+    {
+        thrown = true;
+    }
+    fclose(dest);
+    return thrown ? 0 : 8;
+}
+
+namespace
+{
+    /**
+     * Minimal QOI decoder (RGBA output), for the round trip checks.
+     */
+    bool decode_qoi(const std::vector<uint8_t>& in, PixelMap& out)
+    {
+        if (in.size() < 22 || std::memcmp(in.data(), "qoif", 4) != 0)
+            return false;
+        auto be32 = [&](size_t i) {
+            return (int) ((uint32_t) in[i] << 24 | in[i+1] << 16 | in[i+2] << 8 | in[i+3]);
+        };
+        out = PixelMap(be32(4), be32(8));
+
+        uint8_t index[64][4] = {}, px[4] = {0, 0, 0, 255};
+        size_t p(14), end(in.size() - 8);
+        int run(0);
+        for (uint32_t i(0); i < out.size(); i++)
+        {
+            if (run > 0)
+                run--;
+            else if (p < end)
+            {
+                uint8_t b(in[p++]);
+                if (b == 0xfe)
+                {
+                    px[0] = in[p++]; px[1] = in[p++]; px[2] = in[p++];
+                }
+                else if (b == 0xff)
+                {
+                    px[0] = in[p++]; px[1] = in[p++]; px[2] = in[p++]; px[3] = in[p++];
+                }
+                else if ((b & 0xc0) == 0x00)
+                    std::memcpy(px, index[b], 4);
+                else if ((b & 0xc0) == 0x40)
+                {
+                    px[0] += ((b >> 4) & 3) - 2;
+                    px[1] += ((b >> 2) & 3) - 2;
+                    px[2] += (b & 3) - 2;
+                }
+                else if ((b & 0xc0) == 0x80)
+                {
+                    uint8_t b2(in[p++]);
+                    int vg((b & 0x3f) - 32);
+                    px[0] += vg - 8 + ((b2 >> 4) & 0x0f);
+                    px[1] += vg;
+                    px[2] += vg - 8 + (b2 & 0x0f);
+                }
+                else
+                    run = b & 0x3f;
+                std::memcpy(index[(px[0]*3 + px[1]*5 + px[2]*7 + px[3]*11) % 64], px, 4);
+            }
+            std::memcpy(&out.data()[i], px, 4);
+        }
+        static const uint8_t padding[8] = {0, 0, 0, 0, 0, 0, 0, 1};
+        return p == end && std::memcmp(&in[end], padding, 8) == 0;
+    }
+}
+
+int test_raw_formats()
+{
+    // Flat areas, gradients and translucent pixels
+    PixelMap map(257, 131);
+    for (int y(0); y < map.height(); y++)
+        for (int x(0); x < map.width(); x++)
+            map.set(x, y, x < 64 ? 0xffffff : (unsigned long) (x * 0x10203 + y * 7),
+                    y < 100 ? 0xff : (x * 3) & 0xff);
+
+    if (PixelMap::formatOf("a.QOI") != PixelMap::FORMAT_QOI ||
+        PixelMap::formatOf("a.pam") != PixelMap::FORMAT_PAM ||
+        PixelMap::formatOf("a.ppm") != PixelMap::FORMAT_PPM ||
+        PixelMap::formatOf("a.png") != PixelMap::FORMAT_PNG ||
+        PixelMap::formatOf("a") != PixelMap::FORMAT_PNG)
+        return 1;
+
+    // PAM is the header followed by the pixel buffer
+    const char pamHeader[] = "P7\nWIDTH 257\nHEIGHT 131\nDEPTH 4\nMAXVAL 255\n"
+                             "TUPLTYPE RGB_ALPHA\nENDHDR\n";
+    std::vector<uint8_t> pam(PixelMap::encode(map, PixelMap::FORMAT_PAM));
+    size_t headerLen(sizeof(pamHeader) - 1);
+    if (pam.size() != headerLen + map.size() * 4 ||
+        std::memcmp(pam.data(), pamHeader, headerLen) != 0 ||
+        std::memcmp(&pam[headerLen], map.data(), map.size() * 4) != 0)
+        return 2;
+
+    // PPM drops the alpha channel
+    const char ppmHeader[] = "P6\n257 131\n255\n";
+    std::vector<uint8_t> ppm(PixelMap::encode(map, PixelMap::FORMAT_PPM));
+    headerLen = sizeof(ppmHeader) - 1;
+    if (ppm.size() != headerLen + map.size() * 3 ||
+        std::memcmp(ppm.data(), ppmHeader, headerLen) != 0)
+        return 3;
+    for (uint32_t i(0); i < map.size(); i++)
+        if (std::memcmp(&ppm[headerLen + i*3], &map.data()[i], 3) != 0)
+            return 4;
+
+    // QOI round trip, in memory and through a file
+    PixelMap decoded(1, 1);
+    std::vector<uint8_t> qoi(PixelMap::encode(map, PixelMap::FORMAT_QOI));
+    if (!decode_qoi(qoi, decoded) || decoded.width() != map.width() ||
+        decoded.height() != map.height() ||
+        std::memcmp(decoded.data(), map.data(), map.size() * 4) != 0)
+        return 5;
+
+    FILE* dest = fopen("raw_formats.qoi", "wb");
+    if (!dest)
+        return 6;
+    PixelMap::save(map, dest, PixelMap::FORMAT_QOI);
+    fclose(dest);
+    FILE* src = fopen("raw_formats.qoi", "rb");
+    if (!src)
+        return 7;
+    std::vector<uint8_t> saved(qoi.size() + 1);
+    saved.resize(fread(saved.data(), 1, saved.size(), src));
+    fclose(src);
+    if (saved != qoi)
+        return 8;
+
+    // Same files written row by row, whatever the format
+    for (PixelMap::Format format : {PixelMap::FORMAT_PAM, PixelMap::FORMAT_PPM,
+                                    PixelMap::FORMAT_QOI})
+    {
+        dest = fopen("raw_formats.out", "wb");
+        if (!dest)
+            return 9;
+        PixelMap::save(dest, map.width(), map.height(), format,
+                       [&map](int y, std::span<uint32_t> row) {
+                           std::copy(map.row(y).begin(), map.row(y).end(), row.begin());
+                       }, PixelMap::PNGOptions());
+        fclose(dest);
+        src = fopen("raw_formats.out", "rb");
+        if (!src)
+            return 9;
+        std::vector<uint8_t> expected(PixelMap::encode(map, format));
+        saved.resize(expected.size() + 1);
+        saved.resize(fread(saved.data(), 1, saved.size(), src));
+        fclose(src);
+        if (saved != expected)
+            return 10;
+    }
+
+    // Throughput report (not a pass/fail criterion)
+    PixelMap large(map.resize(2048, 2048));
+    auto report = [&](const char* name, PixelMap::Format format, int level) {
+        PixelMap::PNGOptions opts;
+        opts.zlib.compression_level = level;
+        opts.indexed = false;
+        auto start(std::chrono::steady_clock::now());
+        size_t size(PixelMap::encode(large, format, opts).size());
+        std::chrono::duration<double> elapsed(std::chrono::steady_clock::now() - start);
+        std::cout << "  " << name << ": " << size / 1024 << " KiB, "
+                  << large.size() * 4 / elapsed.count() / 1e6 << " MB/s" << std::endl;
+    };
+    std::cout << "Encoding a 2048x2048 RGBA image:" << std::endl;
+    report("ppm", PixelMap::FORMAT_PPM, -1);
+    report("pam", PixelMap::FORMAT_PAM, -1);
+    report("qoi", PixelMap::FORMAT_QOI, -1);
+    report("png (zlib 1)", PixelMap::FORMAT_PNG, 1);
+    report("png (zlib 6)", PixelMap::FORMAT_PNG, 6);
+    report("png (zlib 9)", PixelMap::FORMAT_PNG, 9);
+    return 0;
+}
+
+int test_asset_cache()
+{
+    PixelMap map(64, 48);
+    for (int y(0); y < map.height(); y++)
+        for (int x(0); x < map.width(); x++)
+            map.set(x, y, (unsigned long) (x * 0x40400 + y * 5));
+    FILE* dest = fopen("asset_cache.png", "wb");
+    if (!dest)
+        return 1;
+    PixelMap::saveInPng(map, dest);
+    fclose(dest);
+
+    AssetCache cache(1 << 20);
+    AssetCache::asset first(cache.load("asset_cache.png", 32, 32));
+    AssetCache::asset second(cache.load("./asset_cache.png", 32, 32));
+    if (first != second || cache.hits() != 1 || cache.misses() != 1 ||
+        first->width() != 32 || cache.memory() != 32 * 32 * 4)
+        return 2;
+
+    // Size and post-processing are part of the key
+    AssetCache::asset other(cache.load("asset_cache.png", 16, 16));
+    int calls(0);
+    auto finish = [&](PixelMap& m) { calls++; m.set(0, 0, 0, 0); };
+    AssetCache::asset finished(cache.load("asset_cache.png", 32, 32, 1, finish));
+    cache.load("asset_cache.png", 32, 32, 1, finish);
+    if (other == first || finished == first || calls != 1 ||
+        rgba8_alpha(finished->row(0)[0]) != 0 || rgba8_alpha(first->row(0)[0]) != 0xff ||
+        cache.misses() != 3 || cache.hits() != 2)
+        return 3;
+
+    // A file modified on disk is decoded again
+    std::filesystem::last_write_time("asset_cache.png",
+            std::filesystem::last_write_time("asset_cache.png") + std::chrono::seconds(2));
+    if (cache.load("asset_cache.png", 32, 32) == first || cache.misses() != 4)
+        return 4;
+
+    // Least recently used entries are evicted under the memory cap, images
+    // stay valid for their holders
+    cache.setCapacity(32 * 32 * 4 * 2);
+    if (cache.memory() > cache.capacity() || first->width() != 32)
+        return 5;
+    cache.load("asset_cache.png", 100, 100);
+    if (cache.memory() > cache.capacity())
+        return 6;
+
+    // Concurrent users share the same images
+    cache.clear();
+    cache.setCapacity(1 << 20);
+    std::vector<std::thread> threads;
+    std::vector<AssetCache::asset> results(8);
+    for (int i(0); i < 8; i++)
+        threads.emplace_back([&, i]() {
+            for (int n(0); n < 50; n++)
+                results[i] = cache.load("asset_cache.png", 24 + n % 2, 24);
+        });
+    for (std::thread& thread : threads)
+        thread.join();
+    for (const AssetCache::asset& result : results)
+        if (result != cache.load("asset_cache.png", 25, 24))
+            return 7;
+    if (cache.hits() + cache.misses() != 8 * 50 + 8 || cache.misses() > 16)
+        return 8;
+
+    // Missing files are reported by the decoder and never cached
+    try
+    {
+        cache.load("asset_cache_missing.png", 8, 8);
+        return 9;
+    }
+    catch (const std::runtime_error&)
+    {
+    }
+    return 0;
+}
+
+int test_resources()
+{
+    // Resolved once: the same path for every call
+    const char* marker(resource_path("code3c-marker.png"));
+    if (marker != resource_path("code3c-marker.png"))
+        return 1;
+
+    for (const embedded_resource& res : embedded_resources())
+    {
+        std::string path(std::string(CODE3C_RESOURCE_PREFIX) + res.name);
+        if (path != resource_path(res.name) ||
+            resource_data(path.c_str()).data() != res.data)
+            return 2;
+    }
+    if (!embedded_resources().empty())
+    {
+        std::span<const uint8_t> png(resource_data(marker));
+        if (png.size() < 8 || png[1] != 'P' || png[2] != 'N' || png[3] != 'G')
+            return 3;
+    }
+
+    // Embedded or not, resources load the same way
+    PixelMap map(PixelMap::loadFromPNG(marker));
+    if (map.width() != 1024 || map.height() != 1024)
+        return 4;
+    if (!code3c_default_htf(CODE3C_HUFFMAN_ASCII) || !code3c_default_htf(CODE3C_HUFFMAN_LATIN) ||
+        code3c_default_htf(CODE3C_HUFFMAN_NO))
+        return 5;
+
+    // Regular files are never taken for embedded resources
+    if (!resource_data("code3c-marker.png").empty() || !resource_data("").empty())
+        return 6;
+    return 0;
+}
+
+int test_resampler()
+{
+    // Opaque gradient, translucent band, transparent right part
+    PixelMap map(150, 90);
+    for (int y(0); y < map.height(); y++)
+        for (int x(0); x < 100; x++)
+            map.set(x, y, (unsigned long) (x * 0x10203 + y * 0x30201),
+                    y < 60 ? 0xff : (x * 5) & 0xff);
+
+    auto source(std::make_shared<const PixelMap>(map));
+    const PixelMap::Filter filters[] = {PixelMap::FILTER_NEAREST, PixelMap::FILTER_BOX,
+                                        PixelMap::FILTER_BILINEAR, PixelMap::FILTER_LANCZOS3};
+    const int sizes[][2] = {{150, 90}, {413, 260}, {61, 37}, {700, 45}};
+    size_t skipped(0);
+    for (PixelMap::Filter filter : filters)
+        for (auto size : sizes)
+        {
+            // Any window matches the resized image (the source itself at the
+            // same size), transparent outside
+            bool same(size[0] == map.width() && size[1] == map.height());
+            PixelMap full(same ? map : map.resize(size[0], size[1], filter));
+            Resampler resampler(source, size[0], size[1], filter);
+            PixelMap window(64, 48);
+            for (int y(-10); y < size[1]; y += 41)
+                for (int x(-7); x < size[0]; x += 57)
+                {
+                    resampler.sample(x, y, window);
+                    bool transparent(resampler.transparent(x, y, 64, 48));
+                    skipped += transparent;
+                    for (int wy(0); wy < 48; wy++)
+                        for (int wx(0); wx < 64; wx++)
+                        {
+                            int fx(x + wx), fy(y + wy);
+                            bool inside(fx >= 0 && fy >= 0 && fx < size[0] && fy < size[1]);
+                            uint32_t expected(inside ? full.row(fy)[fx] : 0);
+                            if (window.row(wy)[wx] != expected)
+                                return 1;
+                            if (transparent && rgba8_alpha(expected) != 0)
+                                return 2;
+                        }
+                }
+        }
+    if (skipped == 0)
+        return 3;
+
+    // Windows are post-processed at their position
+    Resampler marked(source, 300, 180, PixelMap::FILTER_BILINEAR,
+                     [](PixelMap& window, int x, int y) { window.set(0, 0, x * 1000 + y, 0xff); });
+    PixelMap window(16, 16);
+    marked.sample(32, 48, window);
+    if (window.color(0, 0) != 32048)
+        return 4;
+    return 0;
+}